@@ -2,7 +2,12 @@ TEMPLATE = app
 TARGET = munip
 
 SOURCES += main.cpp
-LIBS += -lcore
+LIBS += -lgui -lcore
 RESOURCES += munipresources.qrc
 
 include(../munip.pri)
+
+QT += xml webkit
+DEPENDPATH += $$PWD/../gui
+INCLUDEPATH += $$PWD/../gui
+PRE_TARGETDEPS += $$PWD/../libgui.a
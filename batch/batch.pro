@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = munip-batch
+CONFIG += console
+
+HEADERS += batchjob.h
+SOURCES += batchjob.cpp \
+    main.cpp
+LIBS += -lcore
+# skeleton.xml used by XmlConverter
+RESOURCES += ../app/munipresources.qrc
+
+include(../munip.pri)
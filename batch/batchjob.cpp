@@ -0,0 +1,185 @@
+#include "batchjob.h"
+
+#include "pagecontext.h"
+#include "pagesnapshot.h"
+#include "processstep.h"
+#include "symbol.h"
+
+#include <QFile>
+#include <QImage>
+#include <QStringList>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QTime>
+#include <QtConcurrentMap>
+
+namespace Munip
+{
+    BatchJob::BatchJob() :
+        tempo(120), beats(4), beatType(4),
+        succeeded(false), staffCount(0), totalTime(0)
+    {
+    }
+
+    BatchJob::BatchJob(const QString& input, const QString& output) :
+        inputFile(input), outputFile(output),
+        tempo(120), beats(4), beatType(4),
+        succeeded(false), staffCount(0), totalTime(0)
+    {
+    }
+
+    void BatchJob::run()
+    {
+        QTime total;
+        total.start();
+
+        succeeded = false;
+        errorMessage.clear();
+        stepTimes.clear();
+        cachedSteps.clear();
+        staffCount = 0;
+
+        const QImage image(inputFile);
+        if (image.isNull()) {
+            errorMessage = "Could not read image";
+            totalTime = total.elapsed();
+            return;
+        }
+
+        PageContext context;
+        ProcessQueue queue;
+        queue.setPageContext(&context);
+        queue.setCacheDirectory(cacheDirectory);
+        queue.setResult("page", image);
+        queue.addStage("binarize", "MonoChromeConversion", "page");
+        queue.addStage("deskew", "SkewCorrection", "binarize");
+        queue.addStage("staffParams", "StaffParamExtraction", "deskew");
+        queue.setParameter("staffParams", "drawGraph", false);
+        queue.addStage("staffDetection", "StaffLineDetect", "deskew",
+                QStringList() << "staffParams");
+        queue.addStage("staffRemoval", "StaffLineRemoval", "staffDetection");
+        queue.addStage("symbolExtraction", "SymbolAreaExtraction", "staffRemoval");
+
+        const bool ok = queue.execute();
+        stepTimes = queue.stageTimes();
+        cachedSteps = queue.cacheHits();
+        staffCount = context.staffList().size();
+
+        if (!ok) {
+            errorMessage = queue.errorMessage();
+        } else if (staffCount == 0) {
+            errorMessage = "No staves found";
+        } else {
+            QFile::remove(outputFile);
+
+            QTime timer;
+            timer.start();
+            const bool written = StaffData::generateMusicXML(tempo, beats, beatType,
+                    &context, outputFile);
+            stepTimes << qMakePair(QString("musicXml"), timer.elapsed());
+
+            if (written) {
+                succeeded = true;
+            } else {
+                errorMessage = "Could not write " + outputFile;
+            }
+
+            if (succeeded && !snapshotFile.isEmpty()) {
+                timer.start();
+                PageSnapshot snapshot = PageSnapshot::fromPageContext(&context);
+                succeeded = snapshot.save(snapshotFile);
+                errorMessage = snapshot.errorMessage();
+                stepTimes << qMakePair(QString("snapshot"), timer.elapsed());
+            }
+        }
+
+        totalTime = total.elapsed();
+    }
+
+    static void runJob(BatchJob &job)
+    {
+        job.run();
+    }
+
+    void runBatchJobs(QList<BatchJob>& jobs, int workerCount)
+    {
+        // The steps parallelise internally on the same pool, blockingMap
+        // lets a waiting worker take part in that work so nesting is safe.
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, workerCount));
+        QtConcurrent::blockingMap(jobs, runJob);
+    }
+
+    static QString jsonString(const QString& str)
+    {
+        QString retval("\"");
+        foreach (const QChar& c, str) {
+            switch (c.unicode()) {
+            case '"': retval += "\\\""; break;
+            case '\\': retval += "\\\\"; break;
+            case '\n': retval += "\\n"; break;
+            case '\r': retval += "\\r"; break;
+            case '\t': retval += "\\t"; break;
+            default:
+                if (c.unicode() < 0x20) {
+                    retval += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+                } else {
+                    retval += c;
+                }
+            }
+        }
+        retval += '"';
+        return retval;
+    }
+
+    bool writeBatchSummary(const QList<BatchJob>& jobs, int workerCount, int wallTime,
+            const QString& fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            return false;
+        }
+
+        int failedCount = 0;
+        foreach (const BatchJob& job, jobs) {
+            failedCount += job.succeeded ? 0 : 1;
+        }
+
+        QTextStream out(&file);
+        out.setCodec("UTF-8");
+        out << "{\n";
+        out << "  \"workers\": " << workerCount << ",\n";
+        out << "  \"wallTimeMs\": " << wallTime << ",\n";
+        out << "  \"pageCount\": " << jobs.size() << ",\n";
+        out << "  \"failedCount\": " << failedCount << ",\n";
+        out << "  \"pages\": [";
+        for (int i = 0; i < jobs.size(); ++i) {
+            const BatchJob& job = jobs[i];
+            out << (i ? ",\n" : "\n");
+            out << "    {\n";
+            out << "      \"input\": " << jsonString(job.inputFile) << ",\n";
+            out << "      \"output\": " << jsonString(job.succeeded ? job.outputFile : QString()) << ",\n";
+            out << "      \"status\": " << jsonString(job.succeeded ? "ok" : "failed") << ",\n";
+            if (!job.succeeded) {
+                out << "      \"error\": " << jsonString(job.errorMessage) << ",\n";
+            }
+            out << "      \"staves\": " << job.staffCount << ",\n";
+            out << "      \"totalMs\": " << job.totalTime << ",\n";
+            out << "      \"stepsMs\": {";
+            for (int s = 0; s < job.stepTimes.size(); ++s) {
+                out << (s ? ", " : " ") << jsonString(job.stepTimes[s].first) << ": "
+                    << job.stepTimes[s].second;
+            }
+            out << (job.stepTimes.isEmpty() ? "},\n" : " },\n");
+            out << "      \"cached\": [";
+            for (int s = 0; s < job.cachedSteps.size(); ++s) {
+                out << (s ? ", " : "") << jsonString(job.cachedSteps[s]);
+            }
+            out << "]\n";
+            out << "    }";
+        }
+        out << (jobs.isEmpty() ? "]\n" : "\n  ]\n");
+        out << "}\n";
+
+        return out.status() == QTextStream::Ok;
+    }
+}
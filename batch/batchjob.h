@@ -0,0 +1,57 @@
+#ifndef BATCHJOB_H
+#define BATCHJOB_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+namespace Munip
+{
+    /**
+     * One page of a batch run: the image to transcribe, where its MusicXML
+     * goes and, once run, the outcome along with the wall clock time spent
+     * in each step of the pipeline.
+     *
+     * Every job works on its own PageContext, so any number of them can
+     * run at the same time.
+     */
+    struct BatchJob
+    {
+        BatchJob();
+        BatchJob(const QString& input, const QString& output);
+
+        // binarize -> deskew -> staff params -> staff detection ->
+        // staff removal -> symbol extraction -> MusicXML
+        void run();
+
+        QString inputFile;
+        QString outputFile;
+        // Page snapshot written next to the MusicXML, unless empty.
+        QString snapshotFile;
+        int tempo;
+        int beats;
+        int beatType;
+        // Stage results are looked up and stored here, unless empty.
+        QString cacheDirectory;
+
+        bool succeeded;
+        QString errorMessage;
+        int staffCount;
+        // Step name and milliseconds, in pipeline order.
+        QList<QPair<QString, int> > stepTimes;
+        // Steps whose results came from the cache.
+        QStringList cachedSteps;
+        int totalTime;
+    };
+
+    // Runs all the jobs with at most workerCount pages in flight.
+    void runBatchJobs(QList<BatchJob>& jobs, int workerCount);
+
+    // Writes a JSON summary of the finished jobs, returns false if the file
+    // could not be written.
+    bool writeBatchSummary(const QList<BatchJob>& jobs, int workerCount, int wallTime,
+            const QString& fileName);
+}
+
+#endif // BATCHJOB_H
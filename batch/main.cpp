@@ -0,0 +1,183 @@
+#include "batchjob.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSet>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QTime>
+
+extern bool EnableMDebugOutput;
+
+static void printUsage(QTextStream &err)
+{
+    err << "Usage: munip-batch [options] <image|directory>...\n"
+        << "\n"
+        << "Transcribes every image to MusicXML, several pages at a time.\n"
+        << "\n"
+        << "Options:\n"
+        << "  -j <n>        number of pages processed concurrently (default: cores)\n"
+        << "  -o <dir>      output directory (default: current directory)\n"
+        << "  -s <file>     summary file (default: <output dir>/summary.json)\n"
+        << "  -t <tempo>    tempo written to the MusicXML (default: 120)\n"
+        << "  -m <n>/<d>    time signature (default: 4/4)\n"
+        << "  -c <dir>      cache of intermediate results, reused across runs\n"
+        << "  -p            also write a page snapshot (<name>.snapshot) per input\n"
+        << "  -z            write compressed MusicXML (.mxl) instead of .xml\n"
+        << "  -v            print debug output of the processing steps\n";
+}
+
+// Images of a directory, sorted by name, or the path itself for a file.
+static QStringList expandInput(const QString& path)
+{
+    QStringList retval;
+    const QFileInfo info(path);
+    if (!info.isDir()) {
+        retval << path;
+        return retval;
+    }
+
+    QStringList filters;
+    foreach (const QByteArray& format, QImageReader::supportedImageFormats()) {
+        filters << QString("*.") + QString::fromLatin1(format);
+    }
+
+    const QDir dir(path);
+    foreach (const QFileInfo& file, dir.entryInfoList(filters, QDir::Files, QDir::Name | QDir::IgnoreCase)) {
+        retval << file.filePath();
+    }
+    return retval;
+}
+
+int main(int argc, char *argv[])
+{
+    // No GUI needed, the pipeline only paints on QImages.
+    QApplication app(argc, argv, false);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    int workerCount = QThread::idealThreadCount();
+    int tempo = 120, beats = 4, beatType = 4;
+    QString outputDir(".");
+    QString summaryFile;
+    QString cacheDir;
+    QStringList inputs;
+    bool verbose = false;
+    bool writeSnapshots = false;
+    bool compressed = false;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString& arg = args[i];
+        const bool hasValue = (i + 1 < args.size());
+        bool ok = true;
+
+        if (arg == "-h" || arg == "--help") {
+            printUsage(out);
+            return 0;
+        } else if (arg == "-v") {
+            verbose = true;
+        } else if (arg == "-p") {
+            writeSnapshots = true;
+        } else if (arg == "-z") {
+            compressed = true;
+        } else if (arg == "-j" && hasValue) {
+            workerCount = args[++i].toInt(&ok);
+            ok = ok && workerCount > 0;
+        } else if (arg == "-o" && hasValue) {
+            outputDir = args[++i];
+        } else if (arg == "-s" && hasValue) {
+            summaryFile = args[++i];
+        } else if (arg == "-c" && hasValue) {
+            cacheDir = args[++i];
+        } else if (arg == "-t" && hasValue) {
+            tempo = args[++i].toInt(&ok);
+            ok = ok && tempo > 0;
+        } else if (arg == "-m" && hasValue) {
+            const QStringList parts = args[++i].split('/');
+            ok = (parts.size() == 2);
+            if (ok) {
+                bool numOk, denomOk;
+                beats = parts[0].toInt(&numOk);
+                beatType = parts[1].toInt(&denomOk);
+                ok = numOk && denomOk && beats > 0 && beatType > 0;
+            }
+        } else if (arg.startsWith('-')) {
+            ok = false;
+        } else {
+            inputs << expandInput(arg);
+        }
+
+        if (!ok) {
+            err << "munip-batch: bad argument " << arg << "\n\n";
+            printUsage(err);
+            return 2;
+        }
+    }
+
+    if (inputs.isEmpty()) {
+        printUsage(err);
+        return 2;
+    }
+
+    EnableMDebugOutput = verbose;
+
+    if (!QDir().mkpath(outputDir)) {
+        err << "munip-batch: cannot create " << outputDir << "\n";
+        return 2;
+    }
+    if (summaryFile.isEmpty()) {
+        summaryFile = QDir(outputDir).filePath("summary.json");
+    }
+
+    // One MusicXML per input, named after it. Inputs from different
+    // directories may share a base name, so those get a numeric suffix.
+    QList<Munip::BatchJob> jobs;
+    QSet<QString> usedNames;
+    foreach (const QString& input, inputs) {
+        const QString baseName = QFileInfo(input).completeBaseName();
+        QString name = baseName;
+        for (int n = 2; usedNames.contains(name); ++n) {
+            name = QString("%1_%2").arg(baseName).arg(n);
+        }
+        usedNames << name;
+
+        Munip::BatchJob job(input, QDir(outputDir).filePath(name + (compressed ? ".mxl" : ".xml")));
+        job.tempo = tempo;
+        job.beats = beats;
+        job.beatType = beatType;
+        job.cacheDirectory = cacheDir;
+        if (writeSnapshots) {
+            job.snapshotFile = QDir(outputDir).filePath(name + ".snapshot");
+        }
+        jobs << job;
+    }
+
+    QTime wallTime;
+    wallTime.start();
+    Munip::runBatchJobs(jobs, workerCount);
+    const int elapsed = wallTime.elapsed();
+
+    int failedCount = 0;
+    foreach (const Munip::BatchJob& job, jobs) {
+        if (job.succeeded) {
+            out << "ok      " << job.inputFile << " -> " << job.outputFile
+                << " (" << job.totalTime << " ms)\n";
+        } else {
+            out << "failed  " << job.inputFile << ": " << job.errorMessage << "\n";
+            ++failedCount;
+        }
+    }
+    out << jobs.size() - failedCount << "/" << jobs.size() << " pages transcribed in "
+        << elapsed << " ms with " << workerCount << " workers\n";
+
+    if (!Munip::writeBatchSummary(jobs, workerCount, elapsed, summaryFile)) {
+        err << "munip-batch: cannot write " << summaryFile << "\n";
+        return 1;
+    }
+
+    return failedCount ? 1 : 0;
+}
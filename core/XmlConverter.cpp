@@ -1,236 +1,209 @@
 #include "XmlConverter.h"
-#include <QtXml>
-#include <QRegExp>
+#include "notetables.h"
+#include "zipwriter.h"
+#include <QFileInfo>
 
-QHash<QString,int> XmlConverter::typeHash;
-bool XmlConverter::typesInitialized = false;
-
-void XmlConverter::initTypes()
+// Divisions of a note type, the type must have been validated.
+static int typeDivisions(const QString &type)
 {
-    typeHash.insert("whole",  64);
-    typeHash.insert("half",   32);
-    typeHash.insert("quarter",16);
-    typeHash.insert("eighth",  8);
-    typeHash.insert("16th",    4);
-    typeHash.insert("32th",    2);
-    typeHash.insert("64th",    1);
-
-    typesInitialized = true;
+    return Munip::NoteTypes[Munip::noteTypeIndex(type)].divisions;
 }
 
 
 XmlConverter::XmlConverter(QString outputFile, int t, int b, int bType):
-        currentMeasure(0), currentBarCount(0), startTieSet(false), endTieSet(false), slurSet(false), errorCode(0), outputFileName(outputFile)
+        zip(0), finished(false), currentMeasure(0), currentBarCount(0), startTieSet(false), endTieSet(false), slurSet(false), errorCode(0), outputFileName(outputFile)
 {
-    if (!typesInitialized) {
-        initTypes();
-    }
+    tempo = t;
+    beats = b;
+    beatType = bType;
+
+    maxBarCount = beats * 64 / beatType;
 
     QFile file(":/resources/skeleton.xml");
     if (!file.open(QIODevice::ReadOnly))
+    {
         errorCode = 1;                                      // Config File Not Present/No Open Permissions
+        return;
+    }
+    skeleton.addData(file.readAll());
 
-    QByteArray content = file.readAll();
-
-    QString errorMessage;
-
-
-    int line, col;
-    if (!doc.setContent(content, &errorMessage, &line, &col))
+    outfile.setFileName(outputFileName);
+    if (!outfile.open(QIODevice::WriteOnly))
     {
-        errorCode = 2;                                      // Config File Xml Parse Error
+        errorCode = 3;                                      //  Output file open failed
+        return;
     }
 
-    tempo = t;
-    beats = b;
-    beatType = bType;
-
-    setTempo();
-    setBeatBeatType();
+    if (outputFileName.endsWith(".mxl", Qt::CaseInsensitive))
+    {
+        // The score is the only deflated member, it is streamed like the
+        // plain file.
+        const QString rootFile = QFileInfo(outputFileName).completeBaseName() + ".xml";
+        zip = new Munip::ZipWriter(&outfile);
+        QIODevice *device = 0;
+        if (zip->addStoredFile("mimetype", "application/vnd.recordare.musicxml") &&
+            zip->addStoredFile("META-INF/container.xml", containerXml(rootFile)))
+            device = zip->openFile(rootFile);
+        if (!device)
+        {
+            errorCode = 3;                                  //  Output file write failed
+            return;
+        }
+        writer.setDevice(device);
+    }
+    else
+    {
+        writer.setDevice(&outfile);
+    }
+    writer.setAutoFormatting(true);
+    writer.setAutoFormattingIndent(4);
 
-    maxBarCount = beats * 64 / beatType;
+    writeSkeletonHead();
 }
 
-void XmlConverter::setTempo()
+XmlConverter::~XmlConverter()
 {
-    QDomElement soundElement  = doc.createElement("sound");
-    soundElement.setAttribute("tempo",tempo);
-
-    QDomDocumentFragment fragment = doc.createDocumentFragment();
-    fragment.appendChild(soundElement);
-
-    QDomNode node = doc.elementsByTagName("measure").at(0);
-    node.insertBefore(fragment, node.firstChild());
+    finish();
+    delete zip;
 }
 
-void XmlConverter::setBeatBeatType()
+QByteArray XmlConverter::containerXml(const QString &rootFile) const
 {
-    QDomElement timeElement = doc.createElement("time");
-    QDomElement beatsElement  = doc.createElement("beats");
-    QDomElement beatTypeElement= doc.createElement("beat-type");
-
-    QDomText beatsText = doc.createTextNode(QString::number(beats));
-    QDomText beatTypeText = doc.createTextNode(QString::number(beatType));
-
-    beatsElement.appendChild(beatsText);
-    beatTypeElement.appendChild(beatTypeText);
-
-    timeElement.appendChild(beatsElement);
-    timeElement.appendChild(beatTypeElement);
+    QByteArray data;
+    QXmlStreamWriter container(&data);
+    container.setAutoFormatting(true);
+    container.writeStartDocument();
+    container.writeStartElement("container");
+    container.writeStartElement("rootfiles");
+    container.writeEmptyElement("rootfile");
+    container.writeAttribute("full-path", rootFile);
+    container.writeEndDocument();
+    return data;
+}
 
-    QDomDocumentFragment fragment = doc.createDocumentFragment();
-    fragment.appendChild(timeElement);
+void XmlConverter::writeSkeletonHead()
+{
+    while (!skeleton.atEnd())
+    {
+        skeleton.readNext();
+        if (skeleton.isCharacters() && skeleton.isWhitespace())
+            continue;                                       // The writer does the indentation
+        if (skeleton.isEndElement() && skeleton.name() == QLatin1String("measure"))
+            return;
+
+        writer.writeCurrentToken(skeleton);
+
+        if (skeleton.isStartElement() && skeleton.name() == QLatin1String("measure"))
+            setTempo();
+        else if (skeleton.isStartElement() && skeleton.name() == QLatin1String("attributes"))
+            setBeatBeatType();
+    }
 
-    QDomNode node = doc.elementsByTagName("attributes").at(0);
-    node.insertBefore(fragment, node.firstChild());
+    errorCode = 2;                                          // Config File Xml Parse Error or no measure in it
 }
 
-
-void XmlConverter::addPlainNote(QString step, QString octave, QString type)
+void XmlConverter::writeSkeletonTail()
 {
-    validateParam(step, octave, type);
+    writer.writeEndElement();                               // The measure still open
 
-    if(getErrorCode())
-        return;
+    while (!skeleton.atEnd())
+    {
+        skeleton.readNext();
+        if (skeleton.isCharacters() && skeleton.isWhitespace())
+            continue;
+        writer.writeCurrentToken(skeleton);
+    }
 
-    if(currentBarCount >= maxBarCount)
-        addMeasure();
-    currentBarCount += typeHash[type];
+    if (skeleton.hasError())
+        errorCode = 2;
+}
 
-    QDomDocumentFragment fragment = doc.createDocumentFragment();
+void XmlConverter::setTempo()
+{
+    writer.writeEmptyElement("sound");
+    writer.writeAttribute("tempo", QString::number(tempo));
+}
 
-    QDomElement noteElement  = doc.createElement("note");
-    QDomElement pitchElement = doc.createElement("pitch");
-    QDomElement stepElement  = doc.createElement("step");
-    QDomElement octaveElement= doc.createElement("octave");
-    QDomElement durationElement=doc.createElement("duration");
-    QDomElement typeElement  = doc.createElement("type");
+void XmlConverter::setBeatBeatType()
+{
+    writer.writeStartElement("time");
+    writer.writeTextElement("beats", QString::number(beats));
+    writer.writeTextElement("beat-type", QString::number(beatType));
+    writer.writeEndElement();
+}
 
-    QDomText stepText = doc.createTextNode(step);
-    QDomText octaveText = doc.createTextNode(octave);
-    QDomText durationText = doc.createTextNode(QString::number(typeHash[type]));
-    QDomText typeText = doc.createTextNode(type);
+void XmlConverter::writeNote(QString step, QString octave, QString type, bool chord, bool lastOfChord)
+{
+    writer.writeStartElement("note");
 
-    stepElement.appendChild(stepText);
-    octaveElement.appendChild(octaveText);
-    durationElement.appendChild(durationText);
-    typeElement.appendChild(typeText);
+    if(chord)
+        writer.writeEmptyElement("chord");
 
-    pitchElement.appendChild(stepElement);
-    pitchElement.appendChild(octaveElement);
-    noteElement.appendChild(pitchElement);
+    writer.writeStartElement("pitch");
+    writer.writeTextElement("step", step);
+    writer.writeTextElement("octave", octave);
+    writer.writeEndElement();
 
     if(endTieSet)
     {
-        QDomElement tieStopElement = doc.createElement("tie");
-        tieStopElement.setAttribute("type","stop");
-        noteElement.appendChild(tieStopElement);
+        writer.writeEmptyElement("tie");
+        writer.writeAttribute("type","stop");
 
-        endTieSet=false;
+        if(lastOfChord)
+            endTieSet=false;
     }
     if(startTieSet)
     {
-        QDomElement tieStartElement = doc.createElement("tie");
-        tieStartElement.setAttribute("type","start");
-        noteElement.appendChild(tieStartElement);
+        writer.writeEmptyElement("tie");
+        writer.writeAttribute("type","start");
 
-        endTieSet=true;
+        if(lastOfChord)
+            endTieSet=true;
     }
     if(slurSet)
     {
-        QDomElement slurElement = doc.createElement("tie");
-        slurElement.setAttribute("type","stop");
-        noteElement.appendChild(slurElement);
+        writer.writeEmptyElement("tie");
+        writer.writeAttribute("type","stop");
 
-        slurSet=false;
+        if(lastOfChord)
+            slurSet=false;
     }
 
-    noteElement.appendChild(durationElement);
-    noteElement.appendChild(typeElement);
-
-    fragment.appendChild(noteElement);
+    writer.writeTextElement("duration", QString::number(typeDivisions(type)));
+    writer.writeTextElement("type", type);
 
-    QDomNode node = doc.elementsByTagName("measure").at(currentMeasure);
-    node.insertAfter(fragment, node.lastChild());
+    writer.writeEndElement();
 }
 
-void XmlConverter::addChord(QList<QString> step, QList<QString> octave, QString type)
+void XmlConverter::addPlainNote(QString step, QString octave, QString type)
 {
     validateParam(step, octave, type);
 
-    if(getErrorCode())
+    if(getErrorCode() || finished)
         return;
 
     if(currentBarCount >= maxBarCount)
         addMeasure();
-    currentBarCount += typeHash[type];
-
-    int length = step.length() < octave.length() ? step.length():octave.length();
+    currentBarCount += typeDivisions(type);
 
-    QDomDocumentFragment fragment = doc.createDocumentFragment();
-
-    for(int i=0; i<length; ++i)
-    {
-        QDomElement noteElement  = doc.createElement("note");
-        QDomElement chordElement = doc.createElement("chord");
-        QDomElement pitchElement = doc.createElement("pitch");
-        QDomElement stepElement  = doc.createElement("step");
-        QDomElement octaveElement= doc.createElement("octave");
-        QDomElement durationElement=doc.createElement("duration");
-        QDomElement typeElement  = doc.createElement("type");
-
-        QDomText stepText = doc.createTextNode(step[i]);
-        QDomText octaveText = doc.createTextNode(octave[i]);
-        QDomText durationText = doc.createTextNode(QString::number(typeHash[type]));
-        QDomText typeText = doc.createTextNode(type);
-
-        stepElement.appendChild(stepText);
-        octaveElement.appendChild(octaveText);
-        durationElement.appendChild(durationText);
-        typeElement.appendChild(typeText);
-
-        pitchElement.appendChild(stepElement);
-        pitchElement.appendChild(octaveElement);
-        if(i!=0)
-            noteElement.appendChild(chordElement);
-        noteElement.appendChild(pitchElement);
-
-        if(endTieSet)
-        {
-            QDomElement tieStopElement = doc.createElement("tie");
-            tieStopElement.setAttribute("type","stop");
-            noteElement.appendChild(tieStopElement);
-
-            if(i==length-1)
-                endTieSet=false;
-        }
-        if(startTieSet)
-        {
-            QDomElement tieStartElement = doc.createElement("tie");
-            tieStartElement.setAttribute("type","start");
-            noteElement.appendChild(tieStartElement);
+    writeNote(step, octave, type, false, true);
+}
 
-            if(i==length-1)
-                endTieSet=true;
-        }
-        if(slurSet)
-        {
-            QDomElement slurElement = doc.createElement("tie");
-            slurElement.setAttribute("type","stop");
-            noteElement.appendChild(slurElement);
+void XmlConverter::addChord(QList<QString> step, QList<QString> octave, QString type)
+{
+    validateParam(step, octave, type);
 
-            if(i==length-1)
-                slurSet=false;
-        }
+    if(getErrorCode() || finished)
+        return;
 
-        noteElement.appendChild(durationElement);
-        noteElement.appendChild(typeElement);
+    if(currentBarCount >= maxBarCount)
+        addMeasure();
+    currentBarCount += typeDivisions(type);
 
-        fragment.appendChild(noteElement);
-    }
+    int length = step.length() < octave.length() ? step.length():octave.length();
 
-    QDomNode node = doc.elementsByTagName("measure").at(currentMeasure);
-    node.insertAfter(fragment, node.lastChild());
+    for(int i=0; i<length; ++i)
+        writeNote(step[i], octave[i], type, i!=0, i==length-1);
 }
 
 void XmlConverter::addMeasure()
@@ -238,15 +211,9 @@ void XmlConverter::addMeasure()
     ++currentMeasure;
     currentBarCount = 0;
 
-    QDomDocumentFragment fragment = doc.createDocumentFragment();
-
-    QDomElement measureElement  = doc.createElement("measure");
-    measureElement.setAttribute("number",QString::number(currentMeasure+1));
-
-    fragment.appendChild(measureElement);
-
-    QDomNode node = doc.elementsByTagName("part").at(0);
-    node.insertAfter(fragment, node.lastChild());
+    writer.writeEndElement();
+    writer.writeStartElement("measure");
+    writer.writeAttribute("number",QString::number(currentMeasure+1));
 }
 
 void XmlConverter::enableTie()
@@ -266,46 +233,46 @@ void XmlConverter::endSlur()
     slurSet = true;
 }
 
-void XmlConverter::domTreeToXmlString(QString &string)
+bool XmlConverter::finish()
 {
-    string = doc.toString(4);
-}
+    if(finished)
+        return errorCode == 0;
+    finished = true;
 
-void XmlConverter::domTreeToXmlFile()
-{
-    if(errorCode)
-    {
-        return;
-    }
+    if(!outfile.isOpen())
+        return false;
 
-    QFile outfile(outputFileName);
-    if (!outfile.open(QIODevice::WriteOnly))
-    {
-        errorCode = 3;                                      //  Output file open failed
-        return;
-    }
+    if(!errorCode)
+        writeSkeletonTail();
+
+    if(zip && !errorCode && (!zip->closeFile() || !zip->close()))
+        errorCode = 3;                                      //  Output file write failed
 
-    QByteArray data = doc.toByteArray(4);
-    outfile.write(data);
     outfile.close();
+    if(!errorCode && outfile.error() != QFile::NoError)
+        errorCode = 3;                                      //  Output file write failed
+
+    if(errorCode)
+    {
+        outfile.remove();                                   // No partial scores
+        return false;
+    }
+    return true;
 }
 
 void XmlConverter::validateParam(QString step, QString octave, QString type)
 {
-    QRegExp stepValidator("^[A-G]$");
-    if(stepValidator.indexIn(step) == -1)
+    if(step.size() != 1 || step[0] < QChar('A') || step[0] > QChar('G'))
     {
         errorCode = 7;
         return;
     }
-    QRegExp octaveValidator("^[1-7]$");
-    if(octaveValidator.indexIn(octave) == -1)
+    if(octave.size() != 1 || octave[0] < QChar('1') || octave[0] > QChar('7'))
     {
         errorCode = 5;
         return;
     }
-    QRegExp typeValidator("^(whole|half|quarter|eighth|16th|32th|64th)$");
-    if(typeValidator.indexIn(type) == -1)
+    if(Munip::noteTypeIndex(type) < 0)
     {
         errorCode = 6;
         return;
@@ -10,13 +10,18 @@ FEATURES:
 -- Automatic measure(bar) addition
 -- Tempo, Beat, Beat-Style setting features
 -- Tie and Slur addition feature (Check user manual at the end)
--- Xml file/text output of notes added can be obtained
+-- Measures are streamed to the output file as they are completed, so memory
+   use does not grow with the length of the score
+-- An output file name ending in ".mxl" gives compressed MusicXML, a ZIP
+   archive with META-INF/container.xml, deflated while it is written
 
 
 INTERFACE USAGE SPECIFICS:
 
--- Call XmlConverter::initTypes() before any object of the class is instantiated
-   - Made it self initializing in constructor (gopala)
+-- Note types and their durations come from the constant Munip::NoteTypes
+   table, no initialization is needed
+-- Call XmlConverter::finish() after the last note to close the score. If an
+   error occurred the partial output file is removed instead
 -- Error Code can be obtained anytime using XmlConverter::getErrorCode()
       >> 0 - No Error
       >> 1 - Configuration File Not Present/No Read Permissions
@@ -25,6 +30,7 @@ INTERFACE USAGE SPECIFICS:
       >> 4 - Trying to end a tie when a slur is supposed to end
       >> 5 - Bad Octave Parameter
       >> 6 - Bad Type Parameter
+      >> 7 - Bad Step Parameter
 -- "step" takes values "C", "D", "E", "F", "G", "A", "B"
 -- "octave" takes values "1" to "7"
 -- "type" takes values "whole", "half", "quarter", "16th", "32th", "64th"
@@ -34,18 +40,22 @@ INTERFACE USAGE SPECIFICS:
 #ifndef XMLCONVERTER_H
 #define XMLCONVERTER_H
 
-#include <QtXml>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 
-class XmlConverter
+namespace Munip
 {
-public:
-    static void initTypes();
-private:
-    static QHash<QString,int> typeHash;
-    static bool typesInitialized;
+    class ZipWriter;
+}
 
+class XmlConverter
+{
 public:
     XmlConverter(QString outputFile, int tempo=120, int b=4, int bType=4);
+    ~XmlConverter();
 
     void addPlainNote(QString step, QString octave, QString type);
     void addChord(QList<QString> step, QList<QString> octave, QString type);
@@ -54,8 +64,9 @@ public:
     void disableTie();
     void endSlur();  // Auto Disables
 
-    void domTreeToXmlString(QString &string);
-    void domTreeToXmlFile();
+    // Writes the rest of the skeleton and closes the output file. Returns
+    // false, leaving no output file, if any error occurred.
+    bool finish();
 
     int getErrorCode() const;
 
@@ -64,10 +75,22 @@ private:
     void setTempo();
     void setBeatBeatType();
 
+    // Copies the skeleton up to the end of its first measure, which is
+    // left open for the notes.
+    void writeSkeletonHead();
+    void writeSkeletonTail();
+    QByteArray containerXml(const QString &rootFile) const;
+    void writeNote(QString step, QString octave, QString type, bool chord, bool lastOfChord);
+
     void validateParam(QString step, QString octave, QString type);
     void validateParam(QList<QString> step, QList<QString> octave, QString type);
 
-    QDomDocument doc;
+    QFile outfile;
+    Munip::ZipWriter *zip;                                  // Only for .mxl output
+    QXmlStreamWriter writer;
+    QXmlStreamReader skeleton;
+    bool finished;
+
     int tempo;
     int beats;
     int beatType;
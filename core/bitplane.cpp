@@ -0,0 +1,279 @@
+#include "bitplane.h"
+
+namespace Munip
+{
+    static const QRgb BlackRgb = 0xff000000;
+    static const QRgb WhiteRgb = 0xffffffff;
+
+    // Reverses the bit order of a byte, Format_Mono stores the leftmost
+    // pixel in the most significant bit.
+    static inline uchar reversedByte(uchar b)
+    {
+        return uchar(((b * Q_UINT64_C(0x0202020202)) & Q_UINT64_C(0x010884422010)) % 1023);
+    }
+
+    BitPlane::BitPlane() :
+        m_width(0), m_height(0), m_wordsPerLine(0)
+    {
+    }
+
+    BitPlane::BitPlane(int width, int height) :
+        m_width(qMax(0, width)),
+        m_height(qMax(0, height)),
+        m_wordsPerLine((m_width + WordBits - 1) / WordBits),
+        m_data(m_wordsPerLine * m_height, Word(0))
+    {
+    }
+
+    BitPlane::BitPlane(const QSize& size) :
+        m_width(qMax(0, size.width())),
+        m_height(qMax(0, size.height())),
+        m_wordsPerLine((m_width + WordBits - 1) / WordBits),
+        m_data(m_wordsPerLine * m_height, Word(0))
+    {
+    }
+
+    BitPlane BitPlane::fromImage(const QImage& image)
+    {
+        BitPlane plane(image.size());
+        if (plane.isNull()) {
+            return plane;
+        }
+
+        const int w = image.width();
+        const int h = image.height();
+
+        if (image.format() == QImage::Format_Mono || image.format() == QImage::Format_MonoLSB) {
+            const bool msbFirst = (image.format() == QImage::Format_Mono);
+            const int Black = image.color(0) == 0xffffffff ? 1 : 0;
+            const int bytesPerLine = (w + 7) / 8;
+
+            for (int y = 0; y < h; ++y) {
+                const uchar *src = image.scanLine(y);
+                Word *dst = plane.scanLine(y);
+                for (int i = 0; i < bytesPerLine; ++i) {
+                    uchar b = msbFirst ? reversedByte(src[i]) : src[i];
+                    if (Black == 0) {
+                        b = ~b;
+                    }
+                    dst[i >> 3] |= Word(b) << ((i & 7) * 8);
+                }
+            }
+            plane.clearPadding();
+            return plane;
+        }
+
+        const QImage img = (image.depth() == 32) ? image :
+            image.convertToFormat(QImage::Format_ARGB32);
+        for (int y = 0; y < h; ++y) {
+            const QRgb *src = reinterpret_cast<const QRgb*>(img.scanLine(y));
+            Word *dst = plane.scanLine(y);
+            for (int x = 0; x < w; ++x) {
+                if (src[x] == BlackRgb) {
+                    dst[x >> 6] |= Word(1) << (x & 63);
+                }
+            }
+        }
+
+        return plane;
+    }
+
+    QImage BitPlane::toImage() const
+    {
+        QImage img(m_width, m_height, QImage::Format_Mono);
+        if (img.isNull()) {
+            return img;
+        }
+
+        const int White = 0, Black = 1;
+        // Ensure above index values to color table
+        img.setColor(White, WhiteRgb);
+        img.setColor(Black, BlackRgb);
+
+        const int bytesPerLine = (m_width + 7) / 8;
+        for (int y = 0; y < m_height; ++y) {
+            const Word *src = scanLine(y);
+            uchar *dst = img.scanLine(y);
+            for (int i = 0; i < bytesPerLine; ++i) {
+                dst[i] = reversedByte(uchar(src[i >> 3] >> ((i & 7) * 8)));
+            }
+        }
+
+        return img;
+    }
+
+    QImage BitPlane::toArgbImage() const
+    {
+        QImage img(m_width, m_height, QImage::Format_ARGB32_Premultiplied);
+        if (img.isNull()) {
+            return img;
+        }
+
+        for (int y = 0; y < m_height; ++y) {
+            const Word *src = scanLine(y);
+            QRgb *dst = reinterpret_cast<QRgb*>(img.scanLine(y));
+            for (int x = 0; x < m_width; ++x) {
+                dst[x] = ((src[x >> 6] >> (x & 63)) & 1) ? BlackRgb : WhiteRgb;
+            }
+        }
+
+        return img;
+    }
+
+    void BitPlane::fill(bool on)
+    {
+        m_data.fill(on ? ~Word(0) : Word(0));
+        if (on) {
+            clearPadding();
+        }
+    }
+
+    void BitPlane::fillSpan(int y, int x1, int x2, bool on)
+    {
+        if (y < 0 || y >= m_height) return;
+        x1 = qMax(0, x1);
+        x2 = qMin(m_width - 1, x2);
+        if (x1 > x2) return;
+
+        Word *line = scanLine(y);
+        const int firstWord = x1 >> 6;
+        const int lastWord = x2 >> 6;
+
+        for (int i = firstWord; i <= lastWord; ++i) {
+            const int from = (i == firstWord) ? (x1 & 63) : 0;
+            const int to = (i == lastWord) ? (x2 & 63) : 63;
+            const Word mask = bitRangeMask(from, to);
+            line[i] = on ? (line[i] | mask) : (line[i] & ~mask);
+        }
+    }
+
+    void BitPlane::fillRect(const QRect& rect, bool on)
+    {
+        const QRect r = rect.intersected(this->rect());
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            fillSpan(y, r.left(), r.right(), on);
+        }
+    }
+
+    int BitPlane::count() const
+    {
+        int retval = 0;
+        const Word *data = m_data.constData();
+        for (int i = 0; i < m_data.size(); ++i) {
+            retval += popCount(data[i]);
+        }
+        return retval;
+    }
+
+    int BitPlane::count(const QRect& rect) const
+    {
+        const QRect r = rect.intersected(this->rect());
+        if (r.isEmpty()) return 0;
+
+        const int firstWord = r.left() >> 6;
+        const int lastWord = r.right() >> 6;
+
+        int retval = 0;
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            const Word *line = scanLine(y);
+            for (int i = firstWord; i <= lastWord; ++i) {
+                const int from = (i == firstWord) ? (r.left() & 63) : 0;
+                const int to = (i == lastWord) ? (r.right() & 63) : 63;
+                retval += popCount(line[i] & bitRangeMask(from, to));
+            }
+        }
+        return retval;
+    }
+
+    BitPlane BitPlane::copy(const QRect& rect) const
+    {
+        BitPlane retval(rect.size());
+        const QRect r = rect.intersected(this->rect());
+        if (r.isEmpty()) return retval;
+
+        // Bit offset of source pixel r.left() relative to destination
+        // pixel (r.left() - rect.left()).
+        const int dstX = r.left() - rect.left();
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            const Word *src = scanLine(y);
+            Word *dst = retval.scanLine(y - rect.top());
+            for (int x = r.left(); x <= r.right(); ) {
+                // Copy as many bits as possible from one source word.
+                const int srcBit = x & 63;
+                const int dx = dstX + (x - r.left());
+                const int dstBit = dx & 63;
+                const int n = qMin(qMin(64 - srcBit, 64 - dstBit), r.right() - x + 1);
+                const Word bits = (src[x >> 6] >> srcBit) & bitRangeMask(0, n - 1);
+                dst[dx >> 6] |= bits << dstBit;
+                x += n;
+            }
+        }
+
+        return retval;
+    }
+
+    BitPlane::Word BitPlane::lastWordMask() const
+    {
+        const int rem = m_width & 63;
+        return rem == 0 ? ~Word(0) : bitRangeMask(0, rem - 1);
+    }
+
+    void BitPlane::clearPadding()
+    {
+        if (m_wordsPerLine == 0) return;
+        const Word mask = lastWordMask();
+        for (int y = 0; y < m_height; ++y) {
+            scanLine(y)[m_wordsPerLine - 1] &= mask;
+        }
+    }
+
+    BitPlane& BitPlane::operator|=(const BitPlane& other)
+    {
+        Q_ASSERT(size() == other.size());
+        Word *dst = m_data.data();
+        const Word *src = other.m_data.constData();
+        for (int i = 0; i < m_data.size(); ++i) {
+            dst[i] |= src[i];
+        }
+        return *this;
+    }
+
+    BitPlane& BitPlane::operator&=(const BitPlane& other)
+    {
+        Q_ASSERT(size() == other.size());
+        Word *dst = m_data.data();
+        const Word *src = other.m_data.constData();
+        for (int i = 0; i < m_data.size(); ++i) {
+            dst[i] &= src[i];
+        }
+        return *this;
+    }
+
+    BitPlane& BitPlane::subtract(const BitPlane& other)
+    {
+        Q_ASSERT(size() == other.size());
+        Word *dst = m_data.data();
+        const Word *src = other.m_data.constData();
+        for (int i = 0; i < m_data.size(); ++i) {
+            dst[i] &= ~src[i];
+        }
+        return *this;
+    }
+
+    BitPlane BitPlane::inverted() const
+    {
+        BitPlane retval(*this);
+        Word *data = retval.m_data.data();
+        for (int i = 0; i < retval.m_data.size(); ++i) {
+            data[i] = ~data[i];
+        }
+        retval.clearPadding();
+        return retval;
+    }
+
+    bool BitPlane::operator==(const BitPlane& other) const
+    {
+        return m_width == other.m_width && m_height == other.m_height &&
+            m_data == other.m_data;
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+namespace Munip
+{
+    /**
+     * A binary image packed as one bit per pixel, 64 pixels per word.
+     * Set bits represent black (foreground) pixels.
+     *
+     * Pixel x of a line lives in bit (x % 64) of word (x / 64), so a
+     * shift towards the most significant bit moves pixels to the right.
+     * Padding bits beyond width() in the last word of each line are
+     * always kept cleared, which lets the word level operations work on
+     * whole lines without special casing the image border.
+     */
+    class BitPlane
+    {
+    public:
+        typedef quint64 Word;
+        enum { WordBits = 64 };
+
+        BitPlane();
+        BitPlane(int width, int height);
+        BitPlane(const QSize& size);
+
+        // Black pixels of image (QColor(Qt::black) for non indexed formats)
+        // become set bits.
+        static BitPlane fromImage(const QImage& image);
+        // Returns a Format_Mono image with black set bits on white.
+        QImage toImage() const;
+        // Returns a white ARGB32 premultiplied image with set bits in black.
+        QImage toArgbImage() const;
+
+        bool isNull() const { return m_width <= 0 || m_height <= 0; }
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        QSize size() const { return QSize(m_width, m_height); }
+        QRect rect() const { return QRect(0, 0, m_width, m_height); }
+        int wordsPerLine() const { return m_wordsPerLine; }
+
+        Word* scanLine(int y) { return m_data.data() + y * m_wordsPerLine; }
+        const Word* scanLine(int y) const { return m_data.constData() + y * m_wordsPerLine; }
+        const Word* constScanLine(int y) const { return scanLine(y); }
+
+        bool testPixel(int x, int y) const {
+            return (scanLine(y)[x >> 6] >> (x & 63)) & 1;
+        }
+        void setPixel(int x, int y, bool on) {
+            Word &w = scanLine(y)[x >> 6];
+            const Word mask = Word(1) << (x & 63);
+            w = on ? (w | mask) : (w & ~mask);
+        }
+
+        void fill(bool on);
+        void fillRect(const QRect& rect, bool on);
+        void fillSpan(int y, int x1, int x2, bool on);
+
+        // Number of set bits in the whole plane.
+        int count() const;
+        int count(const QRect& rect) const;
+
+        BitPlane copy(const QRect& rect) const;
+
+        // Mask with valid bits of the last word of each line.
+        Word lastWordMask() const;
+        void clearPadding();
+
+        BitPlane& operator|=(const BitPlane& other);
+        BitPlane& operator&=(const BitPlane& other);
+        // Clears bits which are set in other.
+        BitPlane& subtract(const BitPlane& other);
+        BitPlane inverted() const;
+
+        bool operator==(const BitPlane& other) const;
+        bool operator!=(const BitPlane& other) const { return !(*this == other); }
+
+    private:
+        int m_width;
+        int m_height;
+        int m_wordsPerLine;
+        QVector<Word> m_data;
+    };
+
+    inline int popCount(BitPlane::Word w)
+    {
+#if defined(Q_CC_GNU)
+        return __builtin_popcountll(w);
+#else
+        w = w - ((w >> 1) & Q_UINT64_C(0x5555555555555555));
+        w = (w & Q_UINT64_C(0x3333333333333333)) + ((w >> 2) & Q_UINT64_C(0x3333333333333333));
+        w = (w + (w >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+        return int((w * Q_UINT64_C(0x0101010101010101)) >> 56);
+#endif
+    }
+
+    // Index of the lowest set bit, w must not be 0.
+    inline int countTrailingZeros(BitPlane::Word w)
+    {
+#if defined(Q_CC_GNU)
+        return __builtin_ctzll(w);
+#else
+        return popCount((w & (~w + 1)) - 1);
+#endif
+    }
+
+    // Mask with bits [from, to] set, both in the range [0, 63].
+    inline BitPlane::Word bitRangeMask(int from, int to)
+    {
+        const BitPlane::Word high = (to >= 63) ? ~BitPlane::Word(0) :
+            ((BitPlane::Word(1) << (to + 1)) - 1);
+        return high & (~BitPlane::Word(0) << from);
+    }
+}
+
+#endif
@@ -1,7 +1,10 @@
 #include "cluster.h"
+#include "components.h"
+#include "distancetransform.h"
 #include <QDebug>
 #include <QPoint>
 #include <QPainter>
+#include <QtConcurrentMap>
 #include <cmath>
 
 using namespace Munip;
@@ -23,7 +26,7 @@ int ClusterSet::radius() const
 void ClusterSet::setRadius(int radius)
 {
     m_radius = radius;
-    m_neighborMatrix.clear();
+    clearNeighbors();
 }
 
 int ClusterSet::minPoints() const
@@ -34,36 +37,91 @@ int ClusterSet::minPoints() const
 void ClusterSet::setMinPoints(int minPts)
 {
     m_minPoints = minPts;
-    m_neighborMatrix.clear();
+    clearNeighbors();
 }
 
-void ClusterSet::computeNearestNeighbor(int x, int y)
+void ClusterSet::clearNeighbors()
 {
-    const int Black = m_image.color(0) == 0xffffffff ? 1 : 0;
-    int neighbors = 0;
+    m_neighborCounts.clear();
+    m_pixels = BitPlane();
+    m_core = BitPlane();
+    m_clusters.clear();
+    m_clusterLabels.clear();
+}
 
-    const int yInit = qMax(0, y - m_radius);
-    const int yLimit = qMin(m_image.height() - 1, y + m_radius);
+struct NeighborBand
+{
+    const BitPlane *plane;
+    // Half width of the disk for each dy in [-radius, radius]
+    const QVector<int> *halfWidths;
+    quint16 *counts;
+    BitPlane *core;
+    int radius;
+    int minPoints;
+    int top;
+    int bottom;
+};
 
-    const int xInit = qMax(0, x - m_radius);
-    const int xLimit = qMin(m_image.width() - 1, x + m_radius);
+/**
+ * Counts the disk neighbours of every black pixel of the lines
+ * [top, bottom]. Each disk row is a horizontal span, so with prefix
+ * sums over the image lines a count costs 2 * radius + 1 lookups
+ * regardless of the disk area.
+ */
+static void countNeighbors(NeighborBand &band)
+{
+    typedef BitPlane::Word Word;
 
-    for (int yy = yInit; yy < yLimit; ++yy) {
-        for (int xx = xInit; xx < xLimit; ++xx) {
-            if (xx == x && yy == y) {
-                continue;
-            }
-            if (m_image.pixelIndex(xx, yy) == Black) {
-                if (QLineF(xx, yy, x, y).length() <= qreal(m_radius)) {
-                    ++neighbors;
+    const BitPlane &plane = *band.plane;
+    const int w = plane.width();
+    const int h = plane.height();
+    const int r = band.radius;
+    const int *halfWidths = band.halfWidths->constData() + r;
+
+    // prefix[x] is the number of black pixels in [0, x) of a line.
+    const int first = qMax(0, band.top - r);
+    const int last = qMin(h - 1, band.bottom + r);
+    const int stride = w + 1;
+    QVector<int> prefixes((last - first + 1) * stride);
+    for (int y = first; y <= last; ++y) {
+        const Word *line = plane.scanLine(y);
+        int *prefix = prefixes.data() + (y - first) * stride;
+        prefix[0] = 0;
+        for (int x = 0; x < w; ++x) {
+            prefix[x + 1] = prefix[x] + int((line[x >> 6] >> (x & 63)) & 1);
+        }
+    }
+    const int *prefixData = prefixes.constData();
+
+    for (int y = band.top; y <= band.bottom; ++y) {
+        const Word *line = plane.scanLine(y);
+        quint16 *counts = band.counts + y * w;
+        Word *coreLine = band.core->scanLine(y);
+
+        const int dyFirst = qMax(-r, -y);
+        const int dyLast = qMin(r, h - 1 - y);
+
+        for (int i = 0; i < plane.wordsPerLine(); ++i) {
+            Word bits = line[i];
+            while (bits) {
+                const int bit = countTrailingZeros(bits);
+                bits &= bits - 1;
+                const int x = i * 64 + bit;
+
+                // Exclude the pixel itself.
+                int n = -1;
+                for (int dy = dyFirst; dy <= dyLast; ++dy) {
+                    const int hw = halfWidths[dy];
+                    const int *prefix = prefixData + (y + dy - first) * stride;
+                    n += prefix[qMin(w, x + hw + 1)] - prefix[qMax(0, x - hw)];
+                }
+
+                counts[x] = quint16(qMin(n, 65535));
+                if (n > band.minPoints) {
+                    coreLine[i] |= Word(1) << bit;
                 }
             }
         }
-
-    }
-    // Only add points having atleast a single neighbor
-    if (neighbors > 0) {
-        m_neighborMatrix[QPoint(x, y)] = neighbors;
     }
 }
 
@@ -74,37 +132,179 @@ void ClusterSet::computeNearestNeighbors()
         return;
     }
 
-    const int Black = m_image.color(0) == 0xffffffff ? 1 : 0;
-    for (int y = 0; y < m_image.height(); ++y) {
-        for (int x = 0; x < m_image.width(); ++x) {
-            if (m_image.pixelIndex(x, y) == Black) {
-                computeNearestNeighbor(x, y);
+    m_clusters.clear();
+    m_clusterLabels.clear();
+
+    m_pixels = BitPlane::fromImage(m_image);
+    const BitPlane &plane = m_pixels;
+    const int r = qMax(0, m_radius);
+
+    QVector<int> halfWidths(2 * r + 1);
+    for (int dy = -r; dy <= r; ++dy) {
+        halfWidths[dy + r] = int(std::floor(std::sqrt(qreal(r * r - dy * dy))));
+    }
+
+    m_neighborCounts = QVector<quint16>(plane.width() * plane.height(), 0);
+    m_core = BitPlane(plane.size());
+    // Detach before the bands write into them concurrently.
+    quint16 *counts = m_neighborCounts.data();
+    m_core.scanLine(0);
+
+    const int BandHeight = 64;
+    QList<NeighborBand> bands;
+    for (int top = 0; top < plane.height(); top += BandHeight) {
+        NeighborBand band;
+        band.plane = &plane;
+        band.halfWidths = &halfWidths;
+        band.counts = counts;
+        band.core = &m_core;
+        band.radius = r;
+        band.minPoints = m_minPoints;
+        band.top = top;
+        band.bottom = qMin(top + BandHeight, plane.height()) - 1;
+        bands << band;
+    }
+    QtConcurrent::blockingMap(bands, countNeighbors);
+}
+
+int ClusterSet::neighborCount(int x, int y) const
+{
+    if (m_neighborCounts.isEmpty()) {
+        return 0;
+    }
+    return m_neighborCounts.at(y * m_image.width() + x);
+}
+
+const BitPlane& ClusterSet::corePoints() const
+{
+    return m_core;
+}
+
+int ClusterSet::coreSize() const
+{
+    return m_core.count();
+}
+
+void ClusterSet::drawCore(QPainter &p)
+{
+    typedef BitPlane::Word Word;
+
+    QVector<QPoint> points;
+    for (int y = 0; y < m_core.height(); ++y) {
+        const Word *line = m_core.scanLine(y);
+        for (int i = 0; i < m_core.wordsPerLine(); ++i) {
+            Word bits = line[i];
+            while (bits) {
+                points << QPoint(i * 64 + countTrailingZeros(bits), y);
+                bits &= bits - 1;
             }
         }
     }
+    p.drawPoints(points.constData(), points.size());
 }
 
-int ClusterSet::coreSize() const
+void ClusterSet::computeClusters()
 {
-    int core = 0;
-    QHash<QPoint, int>::const_iterator it, end = m_neighborMatrix.end();
-    for (it = m_neighborMatrix.begin(); it != end; ++it) {
-        if (it.value() > m_minPoints) {
-            ++core;
+    typedef BitPlane::Word Word;
+
+    if (m_core.isNull()) {
+        computeNearestNeighbors();
+    }
+    if (m_core.isNull()) {
+        return;
+    }
+
+    const int w = m_pixels.width();
+    const int r = qMax(0, m_radius);
+
+    QVector<int> coreLabels;
+    const int count = labelComponents(m_core, &coreLabels);
+
+    QVector<int> nearestCore;
+    const DistanceMap coreDistance = featureTransform(m_core, &nearestCore);
+
+    m_clusters.clear();
+    for (int i = 0; i < count; ++i) {
+        m_clusters << Cluster();
+    }
+    m_clusterLabels = QVector<int>(w * m_pixels.height(), -1);
+    int *labels = m_clusterLabels.data();
+
+    for (int y = 0; y < m_pixels.height(); ++y) {
+        const Word *line = m_pixels.scanLine(y);
+        const Word *coreLine = m_core.scanLine(y);
+        const int *distances = coreDistance.scanLine(y);
+
+        for (int i = 0; i < m_pixels.wordsPerLine(); ++i) {
+            Word bits = line[i];
+            while (bits) {
+                const int bit = countTrailingZeros(bits);
+                bits &= bits - 1;
+                const int x = i * 64 + bit;
+                const int index = y * w + x;
+
+                const bool isCore = (coreLine[i] >> bit) & 1;
+                int label = -1;
+                if (isCore) {
+                    label = coreLabels[index];
+                } else if (distances[x] >= 0 && distances[x] <= r * r) {
+                    label = coreLabels[nearestCore[index]];
+                }
+                if (label < 0) continue;
+
+                labels[index] = label;
+                Cluster &cluster = m_clusters[label];
+                cluster.boundingRect |= QRect(x, y, 1, 1);
+                ++cluster.area;
+                if (isCore) {
+                    ++cluster.coreArea;
+                }
+            }
         }
     }
+}
 
-    return core;
+const QList<Cluster>& ClusterSet::clusters() const
+{
+    return m_clusters;
 }
 
-void ClusterSet::drawCore(QPainter &p)
+int ClusterSet::clusterAt(int x, int y) const
 {
-    QHash<QPoint, int>::const_iterator it, end = m_neighborMatrix.end();
-    for (it = m_neighborMatrix.begin(); it != end; ++it) {
-        if (it.value() > m_minPoints) {
-            p.drawPoint(it.key());
+    if (m_clusterLabels.isEmpty()) {
+        return -1;
+    }
+    return m_clusterLabels.at(y * m_image.width() + x);
+}
+
+void ClusterSet::drawClusters(QPainter &p)
+{
+    typedef BitPlane::Word Word;
+
+    // One point list per colour, clusters cycle through the hues.
+    const int HueCount = 12;
+    QVector<QVector<QPoint> > points(HueCount + 1);
+
+    for (int y = 0; y < m_pixels.height(); ++y) {
+        const Word *line = m_pixels.scanLine(y);
+        for (int i = 0; i < m_pixels.wordsPerLine(); ++i) {
+            Word bits = line[i];
+            while (bits) {
+                const int x = i * 64 + countTrailingZeros(bits);
+                bits &= bits - 1;
+
+                const int label = clusterAt(x, y);
+                points[label < 0 ? HueCount : label % HueCount] << QPoint(x, y);
+            }
         }
     }
+
+    p.save();
+    for (int i = 0; i <= HueCount; ++i) {
+        p.setPen(i == HueCount ? QColor(Qt::lightGray) : QColor::fromHsv(i * 360 / HueCount, 255, 200));
+        p.drawPoints(points[i].constData(), points[i].size());
+    }
+    p.restore();
 }
 
 QImage ClusterSet::image() const
@@ -115,9 +315,8 @@ QImage ClusterSet::image() const
 void ClusterSet::setImage(const QImage& img)
 {
     m_image = img;
-    m_neighborMatrix.clear();
+    clearNeighbors();
     if (m_image.isNull() || m_image.format() != QImage::Format_Mono) {
         qWarning() << Q_FUNC_INFO << "Initialized with invalid image";
     }
 }
-
@@ -1,15 +1,27 @@
 #ifndef CLUSTER_H
 #define CLUSTER_H
 
+#include "bitplane.h"
 #include "tools.h"
 
 #include <QPoint>
 #include <QList>
-#include <QHash>
+#include <QRect>
+#include <QVector>
 #include <QPainter>
 
 namespace Munip
 {
+    struct Cluster
+    {
+        Cluster() : area(0), coreArea(0) {}
+
+        QRect boundingRect;
+        // Number of black pixels, core and border.
+        int area;
+        int coreArea;
+    };
+
     class ClusterSet
     {
     public:
@@ -24,17 +36,42 @@ namespace Munip
 
         void computeNearestNeighbors();
 
+        // Number of black pixels within radius() of the black pixel (x, y),
+        // not counting itself. 0 for white pixels.
+        int neighborCount(int x, int y) const;
+
+        // Black pixels having more than minPoints() neighbors.
+        const BitPlane& corePoints() const;
+
         int coreSize() const;
         void drawCore(QPainter &p);
 
+        // DBSCAN clustering of the black pixels. Core points are grouped by
+        // 8-connected components of the core mask, every other black pixel
+        // within radius() of a core point joins the cluster of the nearest
+        // one and the rest is noise. Linear in the number of pixels.
+        void computeClusters();
+
+        const QList<Cluster>& clusters() const;
+        // Cluster index of the pixel (x, y), -1 for noise and white pixels.
+        int clusterAt(int x, int y) const;
+        // Paints every cluster in its own colour and noise in grey.
+        void drawClusters(QPainter &p);
+
         QImage image() const;
         void setImage(const QImage& image);
 
     private:
-        void computeNearestNeighbor(int x, int y);
+        void clearNeighbors();
 
         QImage m_image;
-        QHash<QPoint, int> m_neighborMatrix;
+        BitPlane m_pixels;
+        // Dense width * height counts, saturated at 65535.
+        QVector<quint16> m_neighborCounts;
+        BitPlane m_core;
+
+        QList<Cluster> m_clusters;
+        QVector<int> m_clusterLabels;
 
         int m_radius;
         int m_minPoints;
@@ -0,0 +1,130 @@
+#include "components.h"
+
+namespace Munip
+{
+    typedef BitPlane::Word Word;
+
+    // Position of the first pixel >= from whose bit equals set, or width.
+    static int nextPixel(const Word *line, int width, int from, bool set)
+    {
+        const int words = (width + 63) / 64;
+        int i = from >> 6;
+        if (i >= words) {
+            return width;
+        }
+
+        const Word flip = set ? Word(0) : ~Word(0);
+        Word bits = (line[i] ^ flip) & (~Word(0) << (from & 63));
+        while (bits == 0) {
+            if (++i >= words) {
+                return width;
+            }
+            bits = line[i] ^ flip;
+        }
+
+        return qMin(width, i * 64 + countTrailingZeros(bits));
+    }
+
+    QVector<PixelRun> extractRuns(const BitPlane& in)
+    {
+        QVector<PixelRun> runs;
+        for (int y = 0; y < in.height(); ++y) {
+            const Word *line = in.scanLine(y);
+            int x = nextPixel(line, in.width(), 0, true);
+            while (x < in.width()) {
+                const int end = nextPixel(line, in.width(), x, false);
+                runs << PixelRun(y, x, end - 1);
+                x = nextPixel(line, in.width(), end, true);
+            }
+        }
+        return runs;
+    }
+
+    static int findRoot(QVector<int>& parent, int i)
+    {
+        int root = i;
+        while (parent[root] != root) {
+            root = parent[root];
+        }
+        while (parent[i] != root) {
+            const int next = parent[i];
+            parent[i] = root;
+            i = next;
+        }
+        return root;
+    }
+
+    static void unite(QVector<int>& parent, int a, int b)
+    {
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        // Keep the earlier run as root so numbering follows first runs.
+        if (a < b) {
+            parent[b] = a;
+        } else if (b < a) {
+            parent[a] = b;
+        }
+    }
+
+    int labelComponents(const BitPlane& in, QVector<int> *labels, bool eightConnected)
+    {
+        const QVector<PixelRun> runs = extractRuns(in);
+        const int slack = eightConnected ? 1 : 0;
+
+        QVector<int> parent(runs.size());
+        for (int i = 0; i < runs.size(); ++i) {
+            parent[i] = i;
+        }
+
+        // Runs of the previous line are [prevBegin, prevEnd), those of the
+        // current one [begin, end).
+        int prevBegin = 0, prevEnd = 0;
+        int begin = 0;
+        while (begin < runs.size()) {
+            const int y = runs[begin].y;
+            int end = begin;
+            while (end < runs.size() && runs[end].y == y) {
+                ++end;
+            }
+
+            if (prevEnd > prevBegin && runs[prevBegin].y == y - 1) {
+                int p = prevBegin;
+                for (int c = begin; c < end; ++c) {
+                    const PixelRun& cur = runs[c];
+                    while (p < prevEnd && runs[p].x2 + slack < cur.x1) {
+                        ++p;
+                    }
+                    for (int q = p; q < prevEnd && runs[q].x1 <= cur.x2 + slack; ++q) {
+                        unite(parent, q, c);
+                    }
+                }
+            }
+
+            prevBegin = begin;
+            prevEnd = end;
+            begin = end;
+        }
+
+        // Roots precede their members, so one pass numbers the components.
+        QVector<int> componentOfRun(runs.size());
+        int count = 0;
+        for (int i = 0; i < runs.size(); ++i) {
+            const int root = findRoot(parent, i);
+            componentOfRun[i] = (root == i) ? count++ : componentOfRun[root];
+        }
+
+        if (labels) {
+            *labels = QVector<int>(in.width() * in.height(), -1);
+            int *data = labels->data();
+            for (int i = 0; i < runs.size(); ++i) {
+                const PixelRun& run = runs[i];
+                int *line = data + run.y * in.width();
+                for (int x = run.x1; x <= run.x2; ++x) {
+                    line[x] = componentOfRun[i];
+                }
+            }
+        }
+
+        return count;
+    }
+}
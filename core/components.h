@@ -0,0 +1,37 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include "bitplane.h"
+
+#include <QVector>
+
+namespace Munip
+{
+    // Horizontal run [x1, x2] of set pixels on line y.
+    struct PixelRun
+    {
+        PixelRun() : y(0), x1(0), x2(-1) {}
+        PixelRun(int y_, int x1_, int x2_) : y(y_), x1(x1_), x2(x2_) {}
+
+        int length() const { return x2 - x1 + 1; }
+
+        int y;
+        int x1;
+        int x2;
+    };
+
+    // All runs of set pixels of in, top to bottom and left to right.
+    QVector<PixelRun> extractRuns(const BitPlane& in);
+
+    /**
+     * Labels the connected components of the set pixels of in by merging
+     * overlapping runs of adjacent lines with union-find, so the cost is
+     * linear in the number of words and runs rather than pixels.
+     *
+     * labels receives width * height entries, -1 for clear pixels and
+     * 0 .. n-1 otherwise, numbered in order of their first run. Returns n.
+     */
+    int labelComponents(const BitPlane& in, QVector<int> *labels, bool eightConnected = true);
+}
+
+#endif // COMPONENTS_H
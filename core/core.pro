@@ -1,41 +1,65 @@
 TEMPLATE = lib
 TARGET = core
 CONFIG += static
-QT += xml webkit
+# Headless: no widgets or WebKit, QtGui is linked only for QImage and
+# QPainter. The GUI lives in ../gui. MusicXML is written with
+# QXmlStreamWriter from QtCore, so QtXml is not needed either.
 
 # Input
-HEADERS += datawarehouse.h \
-    imagewidget.h \
-    mainwindow.h \
+HEADERS += bitplane.h \
+    datawarehouse.h \
+    distancetransform.h \
+    eraselist.h \
+    midiwriter.h \
+    pagecontext.h \
+    pagesnapshot.h \
     processstep.h \
-    projection.h \
     segments.h \
-    sidebar.h \
+    stagecache.h \
     staff.h \
+    staffpitchmodel.h \
     tools.h \
     cluster.h \
+    components.h \
+    morphology.h \
+    notetables.h \
     symbol.h \
-    XmlConverter.h
-SOURCES += datawarehouse.cpp \
-    imagewidget.cpp \
-    mainwindow.cpp \
+    symbolarena.h \
+    symbolgraph.h \
+    templatematcher.h \
+    XmlConverter.h \
+    zipwriter.h
+SOURCES += bitplane.cpp \
+    datawarehouse.cpp \
+    distancetransform.cpp \
+    eraselist.cpp \
+    midiwriter.cpp \
+    pagecontext.cpp \
+    pagesnapshot.cpp \
     processstep.cpp \
-    projection.cpp \
     segments.cpp \
-    sidebar.cpp \
+    stagecache.cpp \
     staff.cpp \
+    staffpitchmodel.cpp \
     tools.cpp \
     cluster.cpp \
+    components.cpp \
+    morphology.cpp \
+    notetables.cpp \
     symbol.cpp \
+    symbolarena.cpp \
+    symbolgraph.cpp \
+    templatematcher.cpp \
     unused.cpp \
-    XmlConverter.cpp
+    XmlConverter.cpp \
+    zipwriter.cpp
 
 MOC_DIR = .tmp
 UI_DIR = .tmp
 RCC_DIR = .tmp
 OBJECTS_DIR = .tmp
 
-CONFIG += debug qtestlib
+CONFIG += debug
 win32 {
     CONFIG += console
 }
@@ -0,0 +1,379 @@
+#include "distancetransform.h"
+
+#include <QtConcurrentMap>
+
+namespace Munip
+{
+    DistanceMap::DistanceMap() :
+        m_width(0), m_height(0)
+    {
+    }
+
+    DistanceMap::DistanceMap(int width, int height) :
+        m_width(qMax(0, width)),
+        m_height(qMax(0, height)),
+        m_data(m_width * m_height, 0)
+    {
+    }
+
+    int DistanceMap::maxSquaredDistance() const
+    {
+        int retval = 0;
+        const int *data = m_data.constData();
+        for (int i = 0; i < m_data.size(); ++i) {
+            retval = qMax(retval, data[i]);
+        }
+        return retval;
+    }
+
+    QList<QPoint> DistanceMap::localMaxima(qreal minDistance) const
+    {
+        QList<QPoint> retval;
+        const int minValue = qMax(1, int(std::ceil(minDistance * minDistance)));
+
+        for (int y = 0; y < m_height; ++y) {
+            const int *line = scanLine(y);
+            for (int x = 0; x < m_width; ++x) {
+                const int value = line[x];
+                if (value < minValue) continue;
+
+                bool isMaximum = true;
+                for (int dy = -1; dy <= 1 && isMaximum; ++dy) {
+                    const int ny = y + dy;
+                    if (ny < 0 || ny >= m_height) continue;
+
+                    const int *neighbourLine = scanLine(ny);
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const int nx = x + dx;
+                        if ((dx == 0 && dy == 0) || nx < 0 || nx >= m_width) continue;
+
+                        const int neighbour = neighbourLine[nx];
+                        const bool isBefore = (dy < 0 || (dy == 0 && dx < 0));
+                        if (neighbour > value || (isBefore && neighbour == value)) {
+                            isMaximum = false;
+                            break;
+                        }
+                    }
+                }
+
+                if (isMaximum) {
+                    retval << QPoint(x, y);
+                }
+            }
+        }
+
+        return retval;
+    }
+
+    struct DistanceBand
+    {
+        const BitPlane *plane;
+        DistanceMap *map;
+        int first;
+        int last;
+    };
+
+    // Integer division rounding towards negative infinity.
+    static inline int floorDiv(int a, int b)
+    {
+        const int q = a / b;
+        return (q * b > a) ? q - 1 : q;
+    }
+
+    /**
+     * First phase for columns [first, last]: vertical distance to the
+     * nearest clear pixel of the same column, done line by line so that
+     * memory is walked in order.
+     */
+    static void distanceColumns(DistanceBand &band)
+    {
+        const BitPlane &plane = *band.plane;
+        DistanceMap &map = *band.map;
+        const int h = plane.height();
+
+        for (int y = 0; y < h; ++y) {
+            const BitPlane::Word *bits = plane.scanLine(y);
+            const int *above = (y > 0) ? map.scanLine(y - 1) : 0;
+            int *line = map.scanLine(y);
+            for (int x = band.first; x <= band.last; ++x) {
+                const BitPlane::Word word = bits[x >> 6];
+                if (word == 0 && (x & 63) == 0 && x + 63 <= band.last) {
+                    // Skip clear words as a whole.
+                    for (int i = 0; i < 64; ++i) {
+                        line[x + i] = 0;
+                    }
+                    x += 63;
+                    continue;
+                }
+                const bool set = (word >> (x & 63)) & 1;
+                line[x] = set ? ((above ? above[x] : 0) + 1) : 0;
+            }
+        }
+
+        for (int y = h - 1; y >= 0; --y) {
+            const int *below = (y + 1 < h) ? map.scanLine(y + 1) : 0;
+            int *line = map.scanLine(y);
+            for (int x = band.first; x <= band.last; ++x) {
+                const int fromBelow = (below ? below[x] : 0) + 1;
+                if (fromBelow < line[x]) {
+                    line[x] = fromBelow;
+                }
+            }
+        }
+    }
+
+    /**
+     * Second phase for lines [first, last]: lower envelope of the
+     * parabolas (x - u)^2 + g(u)^2 of each line. Two clear pixels just
+     * outside the line at u = -1 and u = width bound the envelope.
+     */
+    static void distanceRows(DistanceBand &band)
+    {
+        DistanceMap &map = *band.map;
+        const int n = map.width() + 2;
+
+        QVector<int> buffer(3 * n);
+        int *g = buffer.data();
+        int *s = g + n;
+        int *t = s + n;
+        for (int y = band.first; y <= band.last; ++y) {
+            int *line = map.scanLine(y);
+
+            bool isClear = true;
+            for (int x = 0; x < n - 2 && isClear; ++x) {
+                isClear = (line[x] == 0);
+            }
+            if (isClear) continue;
+
+            // g holds squared column distances, shifted by one for the
+            // clear pixels at both ends.
+            g[0] = 0;
+            g[n - 1] = 0;
+            for (int u = 1; u < n - 1; ++u) {
+                g[u] = line[u - 1] * line[u - 1];
+            }
+
+            int q = 0;
+            s[0] = 0;
+            t[0] = 0;
+            for (int u = 1; u < n; ++u) {
+                while (q >= 0 &&
+                        (t[q] - s[q]) * (t[q] - s[q]) + g[s[q]] >
+                        (t[q] - u) * (t[q] - u) + g[u]) {
+                    --q;
+                }
+
+                if (q < 0) {
+                    q = 0;
+                    s[0] = u;
+                } else {
+                    const int i = s[q];
+                    const int w = 1 + floorDiv(u * u - i * i + g[u] - g[i], 2 * (u - i));
+                    if (w < n) {
+                        ++q;
+                        s[q] = u;
+                        t[q] = w;
+                    }
+                }
+            }
+
+            for (int u = n - 1; u >= 0; --u) {
+                if (u >= 1 && u < n - 1) {
+                    line[u - 1] = (u - s[q]) * (u - s[q]) + g[s[q]];
+                }
+                if (u == t[q]) {
+                    --q;
+                }
+            }
+        }
+    }
+
+    DistanceMap distanceTransform(const BitPlane& in)
+    {
+        DistanceMap map(in.width(), in.height());
+        if (in.isNull()) {
+            return map;
+        }
+
+        // Detach before the bands write into it concurrently.
+        map.scanLine(0);
+
+        const int StripWidth = 256;
+        QList<DistanceBand> strips;
+        for (int x = 0; x < in.width(); x += StripWidth) {
+            DistanceBand band;
+            band.plane = &in;
+            band.map = &map;
+            band.first = x;
+            band.last = qMin(x + StripWidth, in.width()) - 1;
+            strips << band;
+        }
+        QtConcurrent::blockingMap(strips, distanceColumns);
+
+        const int BandHeight = 32;
+        QList<DistanceBand> bands;
+        for (int y = 0; y < in.height(); y += BandHeight) {
+            DistanceBand band;
+            band.plane = &in;
+            band.map = &map;
+            band.first = y;
+            band.last = qMin(y + BandHeight, in.height()) - 1;
+            bands << band;
+        }
+        QtConcurrent::blockingMap(bands, distanceRows);
+
+        return map;
+    }
+
+    struct FeatureBand
+    {
+        const BitPlane *plane;
+        DistanceMap *map;
+        int *nearest;
+        int first;
+        int last;
+    };
+
+    /**
+     * First phase of the feature transform for columns [first, last]:
+     * vertical distance to the nearest set pixel of the same column and
+     * that pixel's line, both -1 if the column has none.
+     */
+    static void featureColumns(FeatureBand &band)
+    {
+        const BitPlane &plane = *band.plane;
+        DistanceMap &map = *band.map;
+        const int w = plane.width();
+        const int h = plane.height();
+
+        for (int y = 0; y < h; ++y) {
+            const BitPlane::Word *bits = plane.scanLine(y);
+            int *line = map.scanLine(y);
+            int *nearest = band.nearest + y * w;
+            for (int x = band.first; x <= band.last; ++x) {
+                if ((bits[x >> 6] >> (x & 63)) & 1) {
+                    line[x] = 0;
+                    nearest[x] = y;
+                } else if (y > 0 && nearest[x - w] >= 0) {
+                    line[x] = line[x - w] + 1;
+                    nearest[x] = nearest[x - w];
+                } else {
+                    line[x] = -1;
+                    nearest[x] = -1;
+                }
+            }
+        }
+
+        for (int y = h - 2; y >= 0; --y) {
+            int *line = map.scanLine(y);
+            int *nearest = band.nearest + y * w;
+            for (int x = band.first; x <= band.last; ++x) {
+                const int below = line[x + w];
+                if (below >= 0 && (line[x] < 0 || below + 1 < line[x])) {
+                    line[x] = below + 1;
+                    nearest[x] = nearest[x + w];
+                }
+            }
+        }
+    }
+
+    /**
+     * Second phase of the feature transform for lines [first, last]. Same
+     * lower envelope as distanceRows(), with columns lacking a set pixel
+     * left out and the winning column remembered.
+     */
+    static void featureRows(FeatureBand &band)
+    {
+        DistanceMap &map = *band.map;
+        const int n = map.width();
+
+        QVector<int> buffer(4 * n);
+        int *g = buffer.data();
+        int *column = g + n;
+        int *s = column + n;
+        int *t = s + n;
+        for (int y = band.first; y <= band.last; ++y) {
+            int *line = map.scanLine(y);
+            int *nearest = band.nearest + y * n;
+
+            int q = -1;
+            for (int u = 0; u < n; ++u) {
+                column[u] = nearest[u];
+                if (line[u] < 0) continue;
+                g[u] = line[u] * line[u];
+
+                while (q >= 0 &&
+                        (t[q] - s[q]) * (t[q] - s[q]) + g[s[q]] >
+                        (t[q] - u) * (t[q] - u) + g[u]) {
+                    --q;
+                }
+
+                if (q < 0) {
+                    q = 0;
+                    s[0] = u;
+                    t[0] = 0;
+                } else {
+                    const int i = s[q];
+                    const int w = 1 + floorDiv(u * u - i * i + g[u] - g[i], 2 * (u - i));
+                    if (w < n) {
+                        ++q;
+                        s[q] = u;
+                        t[q] = w;
+                    }
+                }
+            }
+
+            if (q < 0) continue;
+
+            for (int u = n - 1; u >= 0; --u) {
+                const int site = s[q];
+                line[u] = (u - site) * (u - site) + g[site];
+                nearest[u] = column[site] * n + site;
+                if (u == t[q]) {
+                    --q;
+                }
+            }
+        }
+    }
+
+    DistanceMap featureTransform(const BitPlane& in, QVector<int> *nearest)
+    {
+        DistanceMap map(in.width(), in.height());
+        *nearest = QVector<int>(in.width() * in.height(), -1);
+        if (in.isNull()) {
+            return map;
+        }
+
+        // Detach before the bands write into them concurrently.
+        map.scanLine(0);
+        int *nearestData = nearest->data();
+
+        const int StripWidth = 256;
+        QList<FeatureBand> strips;
+        for (int x = 0; x < in.width(); x += StripWidth) {
+            FeatureBand band;
+            band.plane = &in;
+            band.map = &map;
+            band.nearest = nearestData;
+            band.first = x;
+            band.last = qMin(x + StripWidth, in.width()) - 1;
+            strips << band;
+        }
+        QtConcurrent::blockingMap(strips, featureColumns);
+
+        const int BandHeight = 32;
+        QList<FeatureBand> bands;
+        for (int y = 0; y < in.height(); y += BandHeight) {
+            FeatureBand band;
+            band.plane = &in;
+            band.map = &map;
+            band.nearest = nearestData;
+            band.first = y;
+            band.last = qMin(y + BandHeight, in.height()) - 1;
+            bands << band;
+        }
+        QtConcurrent::blockingMap(bands, featureRows);
+
+        return map;
+    }
+}
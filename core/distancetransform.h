@@ -0,0 +1,60 @@
+#ifndef DISTANCETRANSFORM_H
+#define DISTANCETRANSFORM_H
+
+#include "bitplane.h"
+
+#include <QList>
+#include <QPoint>
+#include <QVector>
+
+#include <cmath>
+
+namespace Munip
+{
+    /**
+     * Squared euclidean distance of every pixel of a bitplane to the
+     * nearest clear pixel. Clear pixels have distance 0 and pixels outside
+     * the plane count as clear, so for a black stroke the value at its
+     * medial axis is the square of half the stroke thickness.
+     */
+    class DistanceMap
+    {
+    public:
+        DistanceMap();
+        DistanceMap(int width, int height);
+
+        bool isNull() const { return m_width <= 0 || m_height <= 0; }
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+
+        int* scanLine(int y) { return m_data.data() + y * m_width; }
+        const int* scanLine(int y) const { return m_data.constData() + y * m_width; }
+
+        int squaredDistance(int x, int y) const { return scanLine(y)[x]; }
+        qreal distance(int x, int y) const { return std::sqrt(qreal(squaredDistance(x, y))); }
+
+        int maxSquaredDistance() const;
+
+        // Pixels whose distance is at least minDistance and not smaller
+        // than any of their 8 neighbours. Of a plateau only the pixels
+        // without an equal north or west neighbour are reported.
+        QList<QPoint> localMaxima(qreal minDistance) const;
+
+    private:
+        int m_width;
+        int m_height;
+        QVector<int> m_data;
+    };
+
+    // Exact euclidean distance transform after Meijster et al., linear in
+    // the number of pixels. The column pass runs in parallel over vertical
+    // strips and the row pass in parallel over horizontal bands.
+    DistanceMap distanceTransform(const BitPlane& in);
+
+    // Squared distance of every pixel to the nearest set pixel of in, and
+    // in nearest the index y * width + x of that pixel. Both are -1 when
+    // in has no set pixel at all.
+    DistanceMap featureTransform(const BitPlane& in, QVector<int> *nearest);
+}
+
+#endif // DISTANCETRANSFORM_H
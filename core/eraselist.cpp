@@ -0,0 +1,91 @@
+#include "eraselist.h"
+
+#include <QPainter>
+
+namespace Munip
+{
+    void EraseList::addRect(const QRect& rect)
+    {
+        const QRect r = rect.normalized();
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            Span span = { y, r.left(), r.right() };
+            m_spans << span;
+        }
+    }
+
+    void EraseList::addVerticalRun(const RunCoord& runCoord)
+    {
+        for (int y = runCoord.run.pos; y <= runCoord.run.endPos(); ++y) {
+            Span span = { y, runCoord.pos, runCoord.pos };
+            m_spans << span;
+        }
+    }
+
+    QVector<EraseList::Span> EraseList::mergedSpans(const QRect& bounds) const
+    {
+        QVector<Span> sorted;
+        sorted.reserve(m_spans.size());
+        foreach (Span span, m_spans) {
+            if (span.y < bounds.top() || span.y > bounds.bottom()) continue;
+            span.x1 = qMax(span.x1, bounds.left());
+            span.x2 = qMin(span.x2, bounds.right());
+            if (span.x1 <= span.x2) {
+                sorted << span;
+            }
+        }
+        qSort(sorted.begin(), sorted.end());
+
+        // Spans touching on the same line become one.
+        QVector<Span> retval;
+        retval.reserve(sorted.size());
+        foreach (const Span& span, sorted) {
+            if (!retval.isEmpty() && retval.last().y == span.y &&
+                    span.x1 <= retval.last().x2 + 1) {
+                retval.last().x2 = qMax(retval.last().x2, span.x2);
+            } else {
+                retval << span;
+            }
+        }
+        return retval;
+    }
+
+    void EraseList::apply(BitPlane& plane) const
+    {
+        const QVector<Span> spans = mergedSpans(plane.rect());
+        foreach (const Span& span, spans) {
+            BitPlane::Word *line = plane.scanLine(span.y);
+            const int firstWord = span.x1 >> 6;
+            const int lastWord = span.x2 >> 6;
+            if (firstWord == lastWord) {
+                line[firstWord] &= ~bitRangeMask(span.x1 & 63, span.x2 & 63);
+                continue;
+            }
+
+            line[firstWord] &= ~bitRangeMask(span.x1 & 63, 63);
+            for (int i = firstWord + 1; i < lastWord; ++i) {
+                line[i] = 0;
+            }
+            line[lastWord] &= ~bitRangeMask(0, span.x2 & 63);
+        }
+    }
+
+    void EraseList::apply(QImage& image) const
+    {
+        const QVector<Span> spans = mergedSpans(image.rect());
+
+        if (image.depth() != 32) {
+            QPainter p(&image);
+            foreach (const Span& span, spans) {
+                p.fillRect(span.x1, span.y, span.x2 - span.x1 + 1, 1, Qt::white);
+            }
+            return;
+        }
+
+        // Opaque white is the same premultiplied or not.
+        const QRgb White = 0xffffffff;
+        foreach (const Span& span, spans) {
+            QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(span.y));
+            qFill(line + span.x1, line + span.x2 + 1, White);
+        }
+    }
+}
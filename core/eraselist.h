@@ -0,0 +1,52 @@
+#ifndef ERASELIST_H
+#define ERASELIST_H
+
+#include "bitplane.h"
+#include "tools.h"
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+namespace Munip
+{
+    /**
+     * Pixels to be erased, collected as horizontal spans and applied in
+     * one sweep. apply() sorts the spans by line, merges overlapping
+     * ones, and clears each merged span with word masks on a BitPlane or
+     * as one fill on a 32 bit image. This replaces painting one line or
+     * rectangle at a time.
+     */
+    class EraseList
+    {
+    public:
+        bool isEmpty() const { return m_spans.isEmpty(); }
+        void clear() { m_spans.clear(); }
+
+        void addRect(const QRect& rect);
+        // The pixels of a vertical run from run.pos to run.endPos(), both
+        // included, as drawLine() paints them.
+        void addVerticalRun(const RunCoord& runCoord);
+
+        void apply(BitPlane& plane) const;
+        // Erased pixels become white.
+        void apply(QImage& image) const;
+
+    private:
+        struct Span
+        {
+            int y, x1, x2;
+
+            bool operator<(const Span& other) const {
+                return y < other.y || (y == other.y && x1 < other.x1);
+            }
+        };
+
+        // Sorted, merged and clipped to bounds.
+        QVector<Span> mergedSpans(const QRect& bounds) const;
+
+        QVector<Span> m_spans;
+    };
+}
+
+#endif // ERASELIST_H
@@ -0,0 +1,154 @@
+#include "midiwriter.h"
+#include "notetables.h"
+
+#include <QFile>
+
+namespace Munip
+{
+    const int MidiWriter::Division = 480;
+
+    // General MIDI program 41, as in the MusicXML skeleton.
+    static const char ViolinProgram = 40;
+    static const char Velocity = 80;
+
+    static void appendBigEndian(QByteArray& data, quint32 value, int bytes)
+    {
+        for (int i = bytes - 1; i >= 0; --i) {
+            data.append(char((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    // Delta times are variable length, seven bits per byte with the most
+    // significant group first.
+    static void appendVariableLength(QByteArray& data, quint32 value)
+    {
+        char bytes[5];
+        int count = 0;
+        bytes[count++] = char(value & 0x7f);
+        while (value >>= 7) {
+            bytes[count++] = char(0x80 | (value & 0x7f));
+        }
+        while (count > 0) {
+            data.append(bytes[--count]);
+        }
+    }
+
+    // Ticks of a note type, 0 if unknown.
+    static quint32 durationOf(const QString& type)
+    {
+        const int index = noteTypeIndex(type);
+        return index < 0 ? 0 : MidiWriter::Division * 4 / NoteTypes[index].denominator;
+    }
+
+    // MIDI key of step and octave, -1 if invalid. Middle C, C4, is 60.
+    static int keyOf(const QString& step, const QString& octave)
+    {
+        static const int Semitones[7] = { 9, 11, 0, 2, 4, 5, 7 }; // A to G
+
+        bool ok;
+        const int oct = octave.toInt(&ok);
+        if (!ok || oct < 1 || oct > 7 || step.size() != 1 ||
+                step[0] < QChar('A') || step[0] > QChar('G')) {
+            return -1;
+        }
+        return (oct + 1) * 12 + Semitones[step[0].unicode() - 'A'];
+    }
+
+    MidiWriter::MidiWriter(int tempo, int beats, int beatType)
+    {
+        QByteArray event;
+
+        // Microseconds per quarter note.
+        event.append(char(0xff)).append(char(0x51)).append(char(3));
+        appendBigEndian(event, 60000000 / qMax(1, tempo), 3);
+        appendEvent(0, event);
+
+        // The denominator is given as a power of two, and a metronome
+        // click every quarter.
+        int power = 0;
+        while ((2 << power) <= beatType) ++power;
+        event.clear();
+        event.append(char(0xff)).append(char(0x58)).append(char(4));
+        event.append(char(beats)).append(char(power)).append(char(24)).append(char(8));
+        appendEvent(0, event);
+
+        event.clear();
+        event.append(char(0xc0)).append(ViolinProgram);
+        appendEvent(0, event);
+    }
+
+    void MidiWriter::appendEvent(quint32 delta, const QByteArray& event)
+    {
+        appendVariableLength(m_track, delta);
+        m_track.append(event);
+    }
+
+    bool MidiWriter::addNote(const QString& step, const QString& octave, const QString& type)
+    {
+        return addChord(QList<QString>() << step, QList<QString>() << octave, type);
+    }
+
+    bool MidiWriter::addChord(const QList<QString>& steps, const QList<QString>& octaves,
+            const QString& type)
+    {
+        const quint32 duration = durationOf(type);
+        if (duration == 0) {
+            return false;
+        }
+
+        QList<int> keys;
+        bool ok = true;
+        const int length = qMin(steps.size(), octaves.size());
+        for (int i = 0; i < length; ++i) {
+            const int key = keyOf(steps[i], octaves[i]);
+            if (key < 0) {
+                ok = false;
+            } else {
+                keys << key;
+            }
+        }
+        if (keys.isEmpty()) {
+            return false;
+        }
+
+        QByteArray event;
+        foreach (int key, keys) {
+            event.clear();
+            event.append(char(0x90)).append(char(key)).append(Velocity);
+            appendEvent(0, event);
+        }
+        for (int i = 0; i < keys.size(); ++i) {
+            event.clear();
+            event.append(char(0x80)).append(char(keys[i])).append(char(64));
+            appendEvent(i == 0 ? duration : 0, event);
+        }
+        return ok;
+    }
+
+    QByteArray MidiWriter::data() const
+    {
+        QByteArray track = m_track;
+        track.append(char(0)).append(char(0xff)).append(char(0x2f)).append(char(0));
+
+        QByteArray retval("MThd");
+        appendBigEndian(retval, 6, 4);
+        appendBigEndian(retval, 0, 2); // format 0, one track
+        appendBigEndian(retval, 1, 2);
+        appendBigEndian(retval, Division, 2);
+
+        retval.append("MTrk");
+        appendBigEndian(retval, track.size(), 4);
+        retval.append(track);
+        return retval;
+    }
+
+    bool MidiWriter::write(const QString& fileName) const
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        const QByteArray bytes = data();
+        return file.write(bytes) == bytes.size();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef MIDIWRITER_H
+#define MIDIWRITER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+namespace Munip
+{
+    /**
+     * Writes notes as a format 0 Standard MIDI File, for playing back a
+     * transcription without converting the MusicXML first.
+     *
+     * Steps, octaves and types take the same values as in XmlConverter,
+     * octave 4 being the one of middle C. Notes are played one after the
+     * other on channel 1 with the violin sound the MusicXML skeleton uses.
+     */
+    class MidiWriter
+    {
+    public:
+        // Ticks per quarter note.
+        static const int Division;
+
+        MidiWriter(int tempo = 120, int beats = 4, int beatType = 4);
+
+        // Invalid notes are skipped and make these return false.
+        bool addNote(const QString& step, const QString& octave, const QString& type);
+        bool addChord(const QList<QString>& steps, const QList<QString>& octaves,
+                const QString& type);
+
+        QByteArray data() const;
+        bool write(const QString& fileName) const;
+
+    private:
+        void appendEvent(quint32 delta, const QByteArray& event);
+
+        // Events of the only track, without the end of track.
+        QByteArray m_track;
+    };
+}
+
+#endif // MIDIWRITER_H
@@ -0,0 +1,417 @@
+#include "morphology.h"
+
+#include <QtConcurrentMap>
+
+namespace Munip
+{
+    typedef BitPlane::Word Word;
+
+    StructuringElement::StructuringElement()
+    {
+    }
+
+    StructuringElement::StructuringElement(const QList<QPoint>& points)
+    {
+        foreach (const QPoint& p, points) {
+            add(p);
+        }
+    }
+
+    StructuringElement StructuringElement::box(int width, int height)
+    {
+        StructuringElement se;
+        const int left = -((width - 1) / 2);
+        const int top = -((height - 1) / 2);
+        for (int dy = 0; dy < height; ++dy) {
+            for (int dx = 0; dx < width; ++dx) {
+                se.add(left + dx, top + dy);
+            }
+        }
+        return se;
+    }
+
+    StructuringElement StructuringElement::cross(int radius)
+    {
+        StructuringElement se;
+        se.add(0, 0);
+        for (int i = 1; i <= radius; ++i) {
+            se.add(-i, 0);
+            se.add(+i, 0);
+            se.add(0, -i);
+            se.add(0, +i);
+        }
+        return se;
+    }
+
+    StructuringElement StructuringElement::disk(int radius)
+    {
+        StructuringElement se;
+        for (int dy = -radius; dy <= radius; ++dy) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+                if (dx * dx + dy * dy <= radius * radius) {
+                    se.add(dx, dy);
+                }
+            }
+        }
+        return se;
+    }
+
+    StructuringElement StructuringElement::fromPattern(const char * const rows[], int rowCount,
+            const QPoint& origin)
+    {
+        StructuringElement se;
+        for (int y = 0; y < rowCount; ++y) {
+            for (int x = 0; rows[y][x] != '\0'; ++x) {
+                if (rows[y][x] == '1' || rows[y][x] == 'x') {
+                    se.add(x - origin.x(), y - origin.y());
+                }
+            }
+        }
+        return se;
+    }
+
+    void StructuringElement::add(int dx, int dy)
+    {
+        const QPoint p(dx, dy);
+        if (!m_points.contains(p)) {
+            m_points << p;
+        }
+    }
+
+    QRect StructuringElement::boundingRect() const
+    {
+        QRect r;
+        foreach (const QPoint& p, m_points) {
+            r |= QRect(p, p);
+        }
+        return r;
+    }
+
+    StructuringElement StructuringElement::reflected() const
+    {
+        StructuringElement se;
+        foreach (const QPoint& p, m_points) {
+            se.m_points << -p;
+        }
+        return se;
+    }
+
+    /**
+     * Copy of a plane where every line has guard words on both sides and
+     * the padding bits beyond width hold the value of pixels outside the
+     * plane. Shifted reads can then run over whole lines without any
+     * bounds checks.
+     */
+    class PaddedLines
+    {
+    public:
+        PaddedLines(const BitPlane& plane, int guardWords, bool outside) :
+            m_guard(guardWords),
+            m_stride(plane.wordsPerLine() + 2 * guardWords),
+            m_outsideWord(outside ? ~Word(0) : Word(0)),
+            m_data(m_stride * plane.height(), m_outsideWord)
+        {
+            const int words = plane.wordsPerLine();
+            const Word padding = ~plane.lastWordMask();
+            for (int y = 0; y < plane.height(); ++y) {
+                const Word *src = plane.scanLine(y);
+                Word *dst = m_data.data() + y * m_stride + m_guard;
+                for (int i = 0; i < words; ++i) {
+                    dst[i] = src[i];
+                }
+                if (outside && words > 0) {
+                    dst[words - 1] |= padding;
+                }
+            }
+        }
+
+        const Word* line(int y) const {
+            return m_data.constData() + y * m_stride + m_guard;
+        }
+
+    private:
+        int m_guard;
+        int m_stride;
+        Word m_outsideWord;
+        QVector<Word> m_data;
+    };
+
+    struct OrOp
+    {
+        inline void operator()(Word &dst, Word src) const { dst |= src; }
+    };
+
+    struct AndOp
+    {
+        inline void operator()(Word &dst, Word src) const { dst &= src; }
+    };
+
+    /**
+     * dst(x) = op(dst(x), src(x + shift)) for every x of the line, where
+     * src has enough guard words on both sides for the given shift.
+     */
+    template<typename Op>
+    static inline void combineShifted(Word *dst, const Word *src, int words, int shift, Op op)
+    {
+        const int wordOffset = (shift >= 0) ? (shift / 64) : -((-shift + 63) / 64);
+        const int bitOffset = shift - wordOffset * 64;
+        src += wordOffset;
+
+        if (bitOffset == 0) {
+            for (int i = 0; i < words; ++i) {
+                op(dst[i], src[i]);
+            }
+        } else {
+            const int backOffset = 64 - bitOffset;
+            for (int i = 0; i < words; ++i) {
+                op(dst[i], (src[i] >> bitOffset) | (src[i + 1] << backOffset));
+            }
+        }
+    }
+
+    static int guardWordsFor(const StructuringElement& se)
+    {
+        int maxShift = 0;
+        foreach (const QPoint& p, se.points()) {
+            maxShift = qMax(maxShift, qAbs(p.x()));
+        }
+        return maxShift / 64 + 2;
+    }
+
+    static BitPlane dilateImpl(const BitPlane& in, const StructuringElement& se)
+    {
+        BitPlane out(in.size());
+        if (in.isNull() || se.isEmpty()) {
+            return out;
+        }
+
+        const PaddedLines src(in, guardWordsFor(se), false);
+        const int words = in.wordsPerLine();
+        const QList<QPoint>& points = se.points();
+
+        for (int y = 0; y < in.height(); ++y) {
+            Word *dst = out.scanLine(y);
+            foreach (const QPoint& b, points) {
+                const int sy = y - b.y();
+                if (sy < 0 || sy >= in.height()) continue;
+                combineShifted(dst, src.line(sy), words, -b.x(), OrOp());
+            }
+        }
+
+        out.clearPadding();
+        return out;
+    }
+
+    static BitPlane erodeImpl(const BitPlane& in, const StructuringElement& se, bool outside)
+    {
+        BitPlane out(in.size());
+        out.fill(true);
+        if (in.isNull() || se.isEmpty()) {
+            return out;
+        }
+
+        const PaddedLines src(in, guardWordsFor(se), outside);
+        const int words = in.wordsPerLine();
+        const QList<QPoint>& points = se.points();
+
+        for (int y = 0; y < in.height(); ++y) {
+            Word *dst = out.scanLine(y);
+            foreach (const QPoint& b, points) {
+                const int sy = y + b.y();
+                if (sy < 0 || sy >= in.height()) {
+                    if (outside) continue;
+                    for (int i = 0; i < words; ++i) {
+                        dst[i] = 0;
+                    }
+                    break;
+                }
+                combineShifted(dst, src.line(sy), words, b.x(), AndOp());
+            }
+        }
+
+        out.clearPadding();
+        return out;
+    }
+
+    BitPlane translated(const BitPlane& in, int dx, int dy)
+    {
+        StructuringElement se;
+        se.add(dx, dy);
+        return dilateImpl(in, se);
+    }
+
+    BitPlane dilate(const BitPlane& in, const StructuringElement& se)
+    {
+        return dilateImpl(in, se);
+    }
+
+    BitPlane erode(const BitPlane& in, const StructuringElement& se)
+    {
+        return erodeImpl(in, se, false);
+    }
+
+    BitPlane opening(const BitPlane& in, const StructuringElement& se)
+    {
+        return dilateImpl(erodeImpl(in, se, false), se);
+    }
+
+    BitPlane closing(const BitPlane& in, const StructuringElement& se)
+    {
+        return erodeImpl(dilateImpl(in, se), se, false);
+    }
+
+    BitPlane hitOrMiss(const BitPlane& in, const StructuringElement& hits,
+            const StructuringElement& misses)
+    {
+        BitPlane retval = erodeImpl(in, hits, false);
+        if (!misses.isEmpty()) {
+            retval &= erodeImpl(in.inverted(), misses, true);
+        }
+        return retval;
+    }
+
+    struct ThinningBand
+    {
+        const BitPlane *src;
+        BitPlane *dst;
+        int top;
+        int bottom;
+        bool firstPass;
+        bool changed;
+    };
+
+    // Pixel x of the result is pixel x + 1 (east) or x - 1 (west) of line.
+    static inline Word eastOf(const Word *line, int i, int words)
+    {
+        return (line[i] >> 1) | ((i + 1 < words) ? (line[i + 1] << 63) : Word(0));
+    }
+
+    static inline Word westOf(const Word *line, int i)
+    {
+        return (line[i] << 1) | ((i > 0) ? (line[i - 1] >> 63) : Word(0));
+    }
+
+    static inline void fullAdd(Word a, Word b, Word c, Word &sum, Word &carry)
+    {
+        const Word ab = a ^ b;
+        sum = ab ^ c;
+        carry = (a & b) | (c & ab);
+    }
+
+    /**
+     * One Zhang-Suen sub-iteration over the lines [top, bottom] of a band.
+     * Neighbours are numbered as usual,
+     *
+     *   P9 P2 P3
+     *   P8 P1 P4
+     *   P7 P6 P5
+     *
+     * and the neighbour count B(P1) is kept bit sliced in b0..b3 so that
+     * all 64 pixels of a word are decided at once.
+     */
+    static void thinBand(ThinningBand &band)
+    {
+        const BitPlane &src = *band.src;
+        const int words = src.wordsPerLine();
+        const QVector<Word> zeroLine(words, Word(0));
+
+        band.changed = false;
+        for (int y = band.top; y <= band.bottom; ++y) {
+            const Word *n = (y > 0) ? src.scanLine(y - 1) : zeroLine.constData();
+            const Word *c = src.scanLine(y);
+            const Word *s = (y + 1 < src.height()) ? src.scanLine(y + 1) : zeroLine.constData();
+            Word *out = band.dst->scanLine(y);
+
+            for (int i = 0; i < words; ++i) {
+                const Word p1 = c[i];
+                if (p1 == 0) {
+                    out[i] = 0;
+                    continue;
+                }
+
+                const Word p2 = n[i];
+                const Word p3 = eastOf(n, i, words);
+                const Word p4 = eastOf(c, i, words);
+                const Word p5 = eastOf(s, i, words);
+                const Word p6 = s[i];
+                const Word p7 = westOf(s, i);
+                const Word p8 = westOf(c, i);
+                const Word p9 = westOf(n, i);
+
+                // 2 <= B(P1) <= 6
+                Word s1, c1, s2, c2, b0, k1, t0, t1;
+                fullAdd(p2, p3, p4, s1, c1);
+                fullAdd(p5, p6, p7, s2, c2);
+                fullAdd(s1, s2, p8 ^ p9, b0, k1);
+                fullAdd(c1, c2, p8 & p9, t0, t1);
+                const Word b1 = t0 ^ k1;
+                const Word u = t0 & k1;
+                const Word b2 = t1 ^ u;
+                const Word b3 = t1 & u;
+                const Word countOk = (b1 | b2 | b3) & ~b3 & ~(b2 & b1 & b0);
+
+                // A(P1) == 1, exactly one 0 -> 1 transition in P2, P3, ..., P9, P2
+                const Word seq[9] = { p2, p3, p4, p5, p6, p7, p8, p9, p2 };
+                Word one = 0, two = 0;
+                for (int k = 0; k < 8; ++k) {
+                    const Word t = ~seq[k] & seq[k + 1];
+                    two |= one & t;
+                    one |= t;
+                }
+                const Word transitionsOk = one & ~two;
+
+                const Word sideOk = band.firstPass ?
+                    (~(p2 & p4 & p6) & ~(p4 & p6 & p8)) :
+                    (~(p2 & p4 & p8) & ~(p2 & p6 & p8));
+
+                const Word erase = p1 & countOk & transitionsOk & sideOk;
+                out[i] = p1 & ~erase;
+                if (erase) {
+                    band.changed = true;
+                }
+            }
+        }
+    }
+
+    BitPlane thinned(const BitPlane& in)
+    {
+        BitPlane current(in);
+        if (in.isNull()) {
+            return current;
+        }
+        BitPlane next(in.size());
+
+        const int BandHeight = 64;
+        QList<ThinningBand> bands;
+        for (int top = 0; top < in.height(); top += BandHeight) {
+            ThinningBand band;
+            band.top = top;
+            band.bottom = qMin(top + BandHeight, in.height()) - 1;
+            band.changed = false;
+            bands << band;
+        }
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int pass = 0; pass < 2; ++pass) {
+                // Detach before the bands write into it concurrently.
+                next.scanLine(0);
+                for (int i = 0; i < bands.size(); ++i) {
+                    bands[i].src = &current;
+                    bands[i].dst = &next;
+                    bands[i].firstPass = (pass == 0);
+                }
+
+                QtConcurrent::blockingMap(bands, thinBand);
+
+                foreach (const ThinningBand& band, bands) {
+                    changed = changed || band.changed;
+                }
+                qSwap(current, next);
+            }
+        }
+
+        return current;
+    }
+}
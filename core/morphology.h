@@ -0,0 +1,72 @@
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include "bitplane.h"
+
+#include <QList>
+#include <QPoint>
+#include <QRect>
+
+namespace Munip
+{
+    /**
+     * A small structuring element given as a set of offsets relative to
+     * its origin. Offsets are not restricted to a 3x3 neighbourhood, but
+     * the operations below are only efficient for small elements since
+     * they cost one shifted word operation per offset per word.
+     */
+    class StructuringElement
+    {
+    public:
+        StructuringElement();
+        explicit StructuringElement(const QList<QPoint>& points);
+
+        // Rectangle of width x height centred at the origin (rounded to
+        // top left for even sizes).
+        static StructuringElement box(int width, int height);
+        static StructuringElement cross(int radius);
+        static StructuringElement disk(int radius);
+
+        // Builds an element from rows of characters, where '1' or 'x'
+        // marks a member and anything else is ignored. origin is the
+        // position of the element origin within the pattern.
+        static StructuringElement fromPattern(const char * const rows[], int rowCount,
+                const QPoint& origin);
+
+        void add(int dx, int dy);
+        void add(const QPoint& p) { add(p.x(), p.y()); }
+
+        bool isEmpty() const { return m_points.isEmpty(); }
+        int size() const { return m_points.size(); }
+        const QList<QPoint>& points() const { return m_points; }
+        QRect boundingRect() const;
+
+        StructuringElement reflected() const;
+
+    private:
+        QList<QPoint> m_points;
+    };
+
+    // out(x, y) = in(x - dx, y - dy), pixels shifted in from outside are clear.
+    BitPlane translated(const BitPlane& in, int dx, int dy);
+
+    // out(p) = OR over b in se of in(p - b)
+    BitPlane dilate(const BitPlane& in, const StructuringElement& se);
+    // out(p) = AND over b in se of in(p + b), pixels outside the plane are clear.
+    BitPlane erode(const BitPlane& in, const StructuringElement& se);
+
+    BitPlane opening(const BitPlane& in, const StructuringElement& se);
+    BitPlane closing(const BitPlane& in, const StructuringElement& se);
+
+    // Set where every p + h (h in hits) is set and every p + m (m in
+    // misses) is clear. Pixels outside the plane count as clear.
+    BitPlane hitOrMiss(const BitPlane& in, const StructuringElement& hits,
+            const StructuringElement& misses);
+
+    // One pixel wide 8-connected skeleton using Zhang-Suen thinning. Each
+    // sub-iteration evaluates 64 pixels per word with boolean logic and
+    // runs over horizontal bands of the plane in parallel.
+    BitPlane thinned(const BitPlane& in);
+}
+
+#endif // MORPHOLOGY_H
@@ -0,0 +1,57 @@
+#include "notetables.h"
+
+namespace Munip
+{
+    const Pitch StaffPositions[ClefCount][StaffPositionCount] = {
+        // Treble clef, C7 to A2.
+        {
+            { 'C', 7 }, { 'B', 6 }, { 'A', 6 }, { 'G', 6 }, { 'F', 6 }, { 'E', 6 },
+            { 'D', 6 }, { 'C', 6 }, { 'B', 5 }, { 'A', 5 }, { 'G', 5 },
+            // Staff lines from F5 to E4
+            { 'F', 5 }, { 'E', 5 }, { 'D', 5 }, { 'C', 5 }, { 'B', 4 },
+            { 'A', 4 }, { 'G', 4 }, { 'F', 4 }, { 'E', 4 },
+            { 'D', 4 }, { 'C', 4 }, { 'B', 3 }, { 'A', 3 }, { 'G', 3 }, { 'F', 3 },
+            { 'E', 3 }, { 'D', 3 }, { 'C', 3 }, { 'B', 2 }, { 'A', 2 }
+        },
+        // Bass clef, E5 to C1.
+        {
+            { 'E', 5 }, { 'D', 5 }, { 'C', 5 }, { 'B', 4 }, { 'A', 4 }, { 'G', 4 },
+            { 'F', 4 }, { 'E', 4 }, { 'D', 4 }, { 'C', 4 }, { 'B', 3 },
+            // Staff lines from A3 to G2
+            { 'A', 3 }, { 'G', 3 }, { 'F', 3 }, { 'E', 3 }, { 'D', 3 },
+            { 'C', 3 }, { 'B', 2 }, { 'A', 2 }, { 'G', 2 },
+            { 'F', 2 }, { 'E', 2 }, { 'D', 2 }, { 'C', 2 }, { 'B', 1 }, { 'A', 1 },
+            { 'G', 1 }, { 'F', 1 }, { 'E', 1 }, { 'D', 1 }, { 'C', 1 }
+        }
+    };
+
+    const NoteType NoteTypes[NoteTypeCount] = {
+        { "whole",   1, 64 },
+        { "half",    2, 32 },
+        { "quarter", 4, 16 },
+        { "eighth",  8,  8 },
+        { "16th",   16,  4 },
+        { "32th",   32,  2 },
+        { "64th",   64,  1 }
+    };
+
+    int noteTypeIndex(const QString& name)
+    {
+        for (int i = 0; i < NoteTypeCount; ++i) {
+            if (name == QLatin1String(NoteTypes[i].name)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int noteTypeIndex(int denominator)
+    {
+        for (int i = 0; i < NoteTypeCount; ++i) {
+            if (denominator == (1 << i)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
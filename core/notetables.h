@@ -0,0 +1,51 @@
+#ifndef NOTETABLES_H
+#define NOTETABLES_H
+
+#include <QString>
+
+namespace Munip
+{
+    /**
+     * Constant pitch and duration tables shared by the transcription and
+     * the MusicXML and MIDI writers. They are plain aggregates, so they
+     * are laid out by the compiler and nothing is built at run time.
+     */
+
+    enum Clef {
+        TrebleClef,
+        BassClef,
+        ClefCount
+    };
+
+    struct Pitch
+    {
+        char step;
+        int octave;
+    };
+
+    // Lines and spaces of a staff from the top, three ledger lines above
+    // and below included. The top staff line is always the same position.
+    const int StaffPositionCount = 31;
+    const int TopLinePosition = 11;
+
+    // Indexed by clef and position, e.g. the top line of the treble clef
+    // is StaffPositions[TrebleClef][TopLinePosition], F5.
+    extern const Pitch StaffPositions[ClefCount][StaffPositionCount];
+
+    struct NoteType
+    {
+        const char *name;   // MusicXML <type>
+        int denominator;    // 1 for a whole note, 4 for a quarter...
+        int divisions;      // Duration with 16 divisions per quarter.
+    };
+
+    // From whole to 64th, entry i has the denominator 1 << i.
+    const int NoteTypeCount = 7;
+    extern const NoteType NoteTypes[NoteTypeCount];
+
+    // Index in NoteTypes of a type name or denominator, -1 if unknown.
+    int noteTypeIndex(const QString& name);
+    int noteTypeIndex(int denominator);
+}
+
+#endif // NOTETABLES_H
@@ -0,0 +1,107 @@
+#include "pagecontext.h"
+#include "symbol.h"
+
+using namespace Munip;
+
+PageContext::PageContext() :
+    m_pageSkew(0.0f),
+    m_pageSkewPrecision(0.3f),
+    m_staffSpaceHeight(4, 6),
+    m_staffLineHeight(1, 2)
+{
+}
+
+PageContext::~PageContext()
+{
+    qDeleteAll(m_staffDatas);
+}
+
+void PageContext::setPageSkew(float skew)
+{
+    m_pageSkew = skew;
+}
+
+float PageContext::pageSkew() const
+{
+    return m_pageSkew;
+}
+
+void PageContext::setPageSkewPrecision(float precision)
+{
+    m_pageSkewPrecision = precision;
+}
+
+float PageContext::pageSkewPrecison() const
+{
+    return m_pageSkewPrecision;
+}
+
+void PageContext::clearStaff()
+{
+    m_staffList.clear();
+}
+
+QList<Staff> PageContext::staffList() const
+{
+    return m_staffList;
+}
+
+void PageContext::appendStaff(Staff staff)
+{
+    m_staffList.append(staff);
+}
+
+QImage PageContext::workImage() const
+{
+    return m_workImage;
+}
+
+void PageContext::setWorkImage(const QImage &image)
+{
+    m_workImage = image;
+}
+
+Range PageContext::staffSpaceHeight() const
+{
+    return m_staffSpaceHeight;
+}
+
+void PageContext::setStaffSpaceHeight(const Range& value)
+{
+    m_staffSpaceHeight = value;
+}
+
+Range PageContext::staffLineHeight() const
+{
+    return m_staffLineHeight;
+}
+
+void PageContext::setStaffLineHeight(const Range& value)
+{
+    m_staffLineHeight = value;
+}
+
+QList<StaffData*> PageContext::staffDatas() const
+{
+    return m_staffDatas;
+}
+
+void PageContext::setStaffDatas(const QList<StaffData*> &sd)
+{
+    foreach (StaffData *old, m_staffDatas) {
+        if (!sd.contains(old)) {
+            delete old;
+        }
+    }
+    m_staffDatas = sd;
+}
+
+QImage PageContext::imageWithRemovedStaffLinesOnly() const
+{
+    return m_imageWithRemovedStaffLinesOnly;
+}
+
+QImage& PageContext::imageRefWithRemovedStaffLinesOnly()
+{
+    return m_imageWithRemovedStaffLinesOnly;
+}
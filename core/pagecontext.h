@@ -0,0 +1,73 @@
+#ifndef PAGECONTEXT_H
+#define PAGECONTEXT_H
+
+#include "staff.h"
+#include "tools.h"
+
+#include <QList>
+#include <QImage>
+
+namespace Munip
+{
+    class StaffData;
+
+    /**
+     * State shared by the process steps working on one page: skew, the
+     * detected staves and their metrics, the staff line removed image and
+     * the per staff symbol data.
+     *
+     * Each page being processed gets its own context, which lets several
+     * pages go through the pipeline at the same time. DataWarehouse is
+     * the context used by the GUI and by steps not given one explicitly.
+     */
+    class PageContext
+    {
+    public:
+        PageContext();
+        virtual ~PageContext();
+
+        float pageSkew() const;
+        void setPageSkew(float skew);
+
+        float pageSkewPrecison() const;
+        void setPageSkewPrecision(float precision);
+
+        void clearStaff();
+        void appendStaff(Staff staff);
+        QList<Staff> staffList() const;
+
+        QImage workImage() const;
+        void setWorkImage(const QImage& image);
+
+        Range staffSpaceHeight() const;
+        void setStaffSpaceHeight(const Range& value);
+
+        Range staffLineHeight() const;
+        void setStaffLineHeight(const Range& value);
+
+        // The context owns its StaffData objects, setting a new list
+        // deletes the previous ones.
+        QList<StaffData*> staffDatas() const;
+        void setStaffDatas(const QList<StaffData*> &sd);
+
+        QImage imageWithRemovedStaffLinesOnly() const;
+        QImage& imageRefWithRemovedStaffLinesOnly();
+
+    private:
+        Q_DISABLE_COPY(PageContext)
+
+        float m_pageSkew;
+        float m_pageSkewPrecision;
+
+        Range m_staffSpaceHeight;
+        Range m_staffLineHeight;
+
+        QImage m_workImage;
+        QImage m_imageWithRemovedStaffLinesOnly;
+
+        QList<Staff> m_staffList;
+        QList<StaffData*> m_staffDatas;
+    };
+}
+
+#endif // PAGECONTEXT_H
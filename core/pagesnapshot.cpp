@@ -0,0 +1,440 @@
+#include "pagesnapshot.h"
+
+#include "datawarehouse.h"
+#include "pagecontext.h"
+#include "symbol.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QtEndian>
+
+#include <climits>
+#include <cstring>
+
+namespace Munip
+{
+    const quint32 PageSnapshot::FormatVersion = 1;
+
+    static const char Magic[8] = { 'M', 'U', 'N', 'I', 'P', 'S', 'N', 'P' };
+    // Magic, version and section count.
+    static const int HeaderSize = 16;
+    // Id, record size, offset and record count.
+    static const int SectionEntrySize = 24;
+
+    enum SectionId {
+        PageSection = 1,
+        StaffSymbolsSection,
+        SymbolRectSection,
+        NoteSection,
+        NoteRectSection,
+        StemSection,
+        BeamSection,
+        RunSection
+    };
+    static const int SectionCount = RunSection;
+
+    struct SectionEntry
+    {
+        quint32 id;
+        quint32 recordSize;
+        quint64 offset;
+        quint64 count;
+    };
+
+    static void appendLittleEndian32(QByteArray& data, quint32 value)
+    {
+        uchar bytes[4];
+        qToLittleEndian(value, bytes);
+        data.append(reinterpret_cast<const char*>(bytes), 4);
+    }
+
+    static void appendLittleEndian64(QByteArray& data, quint64 value)
+    {
+        uchar bytes[8];
+        qToLittleEndian(value, bytes);
+        data.append(reinterpret_cast<const char*>(bytes), 8);
+    }
+
+    static void alignTo8(QByteArray& data)
+    {
+        while (data.size() % 8) {
+            data.append('\0');
+        }
+    }
+
+    // Records are plain qint32 fields, written word by word so the file is
+    // little endian on every host.
+    template <typename Record>
+    static SectionEntry appendSection(QByteArray& body, int bodyOffset, quint32 id,
+            const QVector<Record>& records)
+    {
+        alignTo8(body);
+        SectionEntry entry;
+        entry.id = id;
+        entry.recordSize = sizeof(Record);
+        entry.offset = bodyOffset + body.size();
+        entry.count = records.size();
+
+        const int wordCount = records.size() * int(sizeof(Record) / sizeof(qint32));
+        const qint32 *words = reinterpret_cast<const qint32*>(records.constData());
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        body.append(reinterpret_cast<const char*>(words), wordCount * sizeof(qint32));
+#else
+        for (int i = 0; i < wordCount; ++i) {
+            appendLittleEndian32(body, quint32(words[i]));
+        }
+#endif
+        return entry;
+    }
+
+    template <typename Record>
+    static bool readSection(const uchar *data, qint64 size, const SectionEntry& entry,
+            QVector<Record>& records)
+    {
+        if (entry.recordSize < sizeof(Record) || entry.offset > quint64(size) ||
+                entry.count > (quint64(size) - entry.offset) / entry.recordSize ||
+                entry.count > quint64(INT_MAX / sizeof(Record))) {
+            return false;
+        }
+
+        records.resize(int(entry.count));
+        const uchar *src = data + entry.offset;
+        qint32 *words = reinterpret_cast<qint32*>(records.data());
+        const int recordWords = sizeof(Record) / sizeof(qint32);
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        if (entry.recordSize == sizeof(Record)) {
+            memcpy(words, src, records.size() * sizeof(Record));
+            return true;
+        }
+#endif
+        // Records written by a newer version may have grown, only the
+        // known leading fields are read.
+        for (int r = 0; r < records.size(); ++r) {
+            const uchar *record = src + quint64(r) * entry.recordSize;
+            for (int w = 0; w < recordWords; ++w) {
+                words[r * recordWords + w] = qFromLittleEndian<qint32>(record + w * 4);
+            }
+        }
+        return true;
+    }
+
+    PageSnapshot::PageSnapshot() :
+        pageSkew(0),
+        pageSkewPrecision(0)
+    {
+    }
+
+    QRect PageSnapshot::toRect(const RectRecord& record)
+    {
+        return QRect(record.x, record.y, record.width, record.height);
+    }
+
+    PageSnapshot::RectRecord PageSnapshot::fromRect(const QRect& rect)
+    {
+        RectRecord retval;
+        retval.x = rect.x();
+        retval.y = rect.y();
+        retval.width = rect.width();
+        retval.height = rect.height();
+        return retval;
+    }
+
+    RunCoord PageSnapshot::toRunCoord(const RunRecord& record)
+    {
+        return RunCoord(record.pos, Run(record.runPos, record.runLength));
+    }
+
+    static void appendRuns(QVector<PageSnapshot::RunRecord>& runs,
+            const QVector<RunCoord>& runCoords, int first, int count)
+    {
+        for (int i = first; i < first + count; ++i) {
+            PageSnapshot::RunRecord record;
+            record.pos = runCoords[i].pos;
+            record.runPos = runCoords[i].run.pos;
+            record.runLength = runCoords[i].run.length;
+            runs << record;
+        }
+    }
+
+    PageSnapshot PageSnapshot::fromPageContext(const PageContext *context)
+    {
+        if (!context) {
+            context = DataWarehouse::instance();
+        }
+
+        PageSnapshot retval;
+        retval.pageSkew = context->pageSkew();
+        retval.pageSkewPrecision = context->pageSkewPrecison();
+        retval.staffSpaceHeight = context->staffSpaceHeight();
+        retval.staffLineHeight = context->staffLineHeight();
+        retval.staves = context->staffList();
+
+        // The symbol graph of each staff is already index linked, its
+        // tables are appended with their indices shifted.
+        foreach (const StaffData *sd, context->staffDatas()) {
+            const SymbolGraph& graph = sd->graph;
+            const int noteOffset = retval.notes.size();
+            const int stemOffset = retval.stems.size();
+
+            StaffSymbolsRecord symbols;
+
+            symbols.firstSymbolRect = retval.symbolRects.size();
+            symbols.symbolRectCount = sd->symbolRects.size();
+            foreach (const QRect& rect, sd->symbolRects) {
+                retval.symbolRects << fromRect(rect);
+            }
+
+            symbols.firstNote = noteOffset;
+            symbols.noteCount = graph.filledNoteCount;
+            symbols.firstHollowNote = noteOffset + graph.filledNoteCount;
+            symbols.hollowNoteCount = graph.notes.size() - graph.filledNoteCount;
+            foreach (const SymbolGraph::Note& n, graph.notes) {
+                NoteRecord note;
+                note.boundingRect = fromRect(n.boundingRect);
+                note.firstNoteRect = retval.noteRects.size();
+                note.noteRectCount = n.headCount;
+                for (int h = n.firstHead; h < n.firstHead + n.headCount; ++h) {
+                    retval.noteRects << fromRect(graph.heads[h]);
+                }
+                note.stem = n.stem < 0 ? -1 : stemOffset + n.stem;
+                note.isNoteHeadFilled = n.isNoteHeadFilled ? 1 : 0;
+                retval.notes << note;
+            }
+
+            foreach (const SymbolGraph::Stem& s, graph.stems) {
+                StemRecord stem;
+                stem.boundingRect = fromRect(s.boundingRect);
+                stem.note = s.note < 0 ? -1 : noteOffset + s.note;
+                stem.leftFlagCount = s.leftFlagCount;
+                stem.rightFlagCount = s.rightFlagCount;
+                stem.firstFlagRun = retval.runs.size();
+                stem.flagRunCount = s.flagRunCount;
+                appendRuns(retval.runs, graph.flagRuns, s.firstFlagRun, s.flagRunCount);
+                stem.firstPartialBeamRun = retval.runs.size();
+                stem.partialBeamRunCount = s.partialBeamRunCount;
+                appendRuns(retval.runs, graph.flagRuns, s.firstPartialBeamRun,
+                        s.partialBeamRunCount);
+                retval.stems << stem;
+            }
+
+            symbols.firstBeam = retval.beams.size();
+            symbols.beamCount = graph.beams.size();
+            foreach (const SymbolGraph::Beam& b, graph.beams) {
+                BeamRecord beam;
+                beam.firstRun = retval.runs.size();
+                beam.runCount = b.runCount;
+                appendRuns(retval.runs, graph.beamRuns, b.firstRun, b.runCount);
+                retval.beams << beam;
+            }
+
+            retval.staffSymbols << symbols;
+        }
+
+        return retval;
+    }
+
+    void PageSnapshot::restore(PageContext *context) const
+    {
+        context->setPageSkew(pageSkew);
+        context->setPageSkewPrecision(pageSkewPrecision);
+        context->setStaffSpaceHeight(staffSpaceHeight);
+        context->setStaffLineHeight(staffLineHeight);
+        context->clearStaff();
+        foreach (const Staff& staff, staves) {
+            context->appendStaff(staff);
+        }
+    }
+
+    bool PageSnapshot::save(const QString& fileName)
+    {
+        m_errorMessage.clear();
+
+        QByteArray page;
+        {
+            QDataStream stream(&page, QIODevice::WriteOnly);
+            stream.setVersion(QDataStream::Qt_4_6);
+            stream << pageSkew << pageSkewPrecision
+                << qint32(staffSpaceHeight.min) << qint32(staffSpaceHeight.max)
+                << qint32(staffLineHeight.min) << qint32(staffLineHeight.max)
+                << quint32(staves.size());
+            foreach (const Staff& staff, staves) {
+                stream << staff;
+            }
+        }
+
+        QByteArray body;
+        int bodyOffset = HeaderSize + SectionCount * SectionEntrySize;
+        bodyOffset += (8 - bodyOffset % 8) % 8;
+
+        QList<SectionEntry> table;
+        SectionEntry pageEntry;
+        pageEntry.id = PageSection;
+        pageEntry.recordSize = 1;
+        pageEntry.offset = bodyOffset;
+        pageEntry.count = page.size();
+        body.append(page);
+        table << pageEntry;
+
+        table << appendSection(body, bodyOffset, StaffSymbolsSection, staffSymbols);
+        table << appendSection(body, bodyOffset, SymbolRectSection, symbolRects);
+        table << appendSection(body, bodyOffset, NoteSection, notes);
+        table << appendSection(body, bodyOffset, NoteRectSection, noteRects);
+        table << appendSection(body, bodyOffset, StemSection, stems);
+        table << appendSection(body, bodyOffset, BeamSection, beams);
+        table << appendSection(body, bodyOffset, RunSection, runs);
+        Q_ASSERT(table.size() == SectionCount);
+
+        QByteArray header(Magic, sizeof(Magic));
+        appendLittleEndian32(header, FormatVersion);
+        appendLittleEndian32(header, table.size());
+        foreach (const SectionEntry& entry, table) {
+            appendLittleEndian32(header, entry.id);
+            appendLittleEndian32(header, entry.recordSize);
+            appendLittleEndian64(header, entry.offset);
+            appendLittleEndian64(header, entry.count);
+        }
+        alignTo8(header);
+        Q_ASSERT(header.size() == bodyOffset);
+
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly) ||
+                file.write(header) != header.size() || file.write(body) != body.size()) {
+            m_errorMessage = QString("Cannot write %1: %2").arg(fileName).arg(file.errorString());
+            return false;
+        }
+        return true;
+    }
+
+    bool PageSnapshot::load(const QString& fileName)
+    {
+        m_errorMessage.clear();
+
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            m_errorMessage = QString("Cannot read %1: %2").arg(fileName).arg(file.errorString());
+            return false;
+        }
+
+        // Mapped if possible, the bulk sections are then copied straight
+        // out of the page cache.
+        const qint64 size = file.size();
+        QByteArray contents;
+        const uchar *data = size > 0 ? file.map(0, size) : 0;
+        if (!data) {
+            contents = file.readAll();
+            data = reinterpret_cast<const uchar*>(contents.constData());
+        }
+
+        if (size < HeaderSize || memcmp(data, Magic, sizeof(Magic)) != 0) {
+            m_errorMessage = fileName + " is not a page snapshot";
+            return false;
+        }
+        const quint32 version = qFromLittleEndian<quint32>(data + 8);
+        const quint32 sectionCount = qFromLittleEndian<quint32>(data + 12);
+        if (version != FormatVersion) {
+            m_errorMessage = QString("%1 has unsupported format version %2").arg(fileName).arg(version);
+            return false;
+        }
+        if (sectionCount > quint32((size - HeaderSize) / SectionEntrySize)) {
+            m_errorMessage = fileName + " is truncated";
+            return false;
+        }
+
+        *this = PageSnapshot();
+        bool ok = true;
+        bool hasPage = false;
+        for (quint32 i = 0; ok && i < sectionCount; ++i) {
+            const uchar *raw = data + HeaderSize + i * SectionEntrySize;
+            SectionEntry entry;
+            entry.id = qFromLittleEndian<quint32>(raw);
+            entry.recordSize = qFromLittleEndian<quint32>(raw + 4);
+            entry.offset = qFromLittleEndian<quint64>(raw + 8);
+            entry.count = qFromLittleEndian<quint64>(raw + 16);
+
+            switch (entry.id) {
+            case PageSection: {
+                if (entry.recordSize != 1 || entry.offset > quint64(size) ||
+                        entry.count > quint64(size) - entry.offset) {
+                    ok = false;
+                    break;
+                }
+                const QByteArray page = QByteArray::fromRawData(
+                        reinterpret_cast<const char*>(data + entry.offset), int(entry.count));
+                QDataStream stream(page);
+                stream.setVersion(QDataStream::Qt_4_6);
+                qint32 spaceMin, spaceMax, lineMin, lineMax;
+                quint32 staffCount;
+                stream >> pageSkew >> pageSkewPrecision >> spaceMin >> spaceMax
+                    >> lineMin >> lineMax >> staffCount;
+                staffSpaceHeight = Range(spaceMin, spaceMax);
+                staffLineHeight = Range(lineMin, lineMax);
+                for (quint32 s = 0; s < staffCount && stream.status() == QDataStream::Ok; ++s) {
+                    Staff staff;
+                    stream >> staff;
+                    staves << staff;
+                }
+                ok = (stream.status() == QDataStream::Ok);
+                hasPage = true;
+                break;
+            }
+            case StaffSymbolsSection: ok = readSection(data, size, entry, staffSymbols); break;
+            case SymbolRectSection: ok = readSection(data, size, entry, symbolRects); break;
+            case NoteSection: ok = readSection(data, size, entry, notes); break;
+            case NoteRectSection: ok = readSection(data, size, entry, noteRects); break;
+            case StemSection: ok = readSection(data, size, entry, stems); break;
+            case BeamSection: ok = readSection(data, size, entry, beams); break;
+            case RunSection: ok = readSection(data, size, entry, runs); break;
+            default:
+                // Added by a later version, nothing refers to it here.
+                break;
+            }
+        }
+
+        if (!ok || !hasPage || !isConsistent()) {
+            *this = PageSnapshot();
+            m_errorMessage = fileName + " is corrupt";
+            return false;
+        }
+        return true;
+    }
+
+    static bool isRange(qint32 first, qint32 count, int size)
+    {
+        return first >= 0 && count >= 0 && first <= size && count <= size - first;
+    }
+
+    bool PageSnapshot::isConsistent() const
+    {
+        if (staffSymbols.size() > staves.size()) {
+            return false;
+        }
+        foreach (const StaffSymbolsRecord& s, staffSymbols) {
+            if (!isRange(s.firstSymbolRect, s.symbolRectCount, symbolRects.size()) ||
+                    !isRange(s.firstNote, s.noteCount, notes.size()) ||
+                    !isRange(s.firstHollowNote, s.hollowNoteCount, notes.size()) ||
+                    !isRange(s.firstBeam, s.beamCount, beams.size())) {
+                return false;
+            }
+        }
+        foreach (const NoteRecord& note, notes) {
+            if (!isRange(note.firstNoteRect, note.noteRectCount, noteRects.size()) ||
+                    note.stem < -1 || note.stem >= stems.size()) {
+                return false;
+            }
+        }
+        foreach (const StemRecord& stem, stems) {
+            if (stem.note < -1 || stem.note >= notes.size() ||
+                    !isRange(stem.firstFlagRun, stem.flagRunCount, runs.size()) ||
+                    !isRange(stem.firstPartialBeamRun, stem.partialBeamRunCount, runs.size())) {
+                return false;
+            }
+        }
+        foreach (const BeamRecord& beam, beams) {
+            if (!isRange(beam.firstRun, beam.runCount, runs.size())) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
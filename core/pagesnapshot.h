@@ -0,0 +1,116 @@
+#ifndef PAGESNAPSHOT_H
+#define PAGESNAPSHOT_H
+
+#include "staff.h"
+#include "tools.h"
+
+#include <QList>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+namespace Munip
+{
+    class PageContext;
+
+    /**
+     * The page model of a processed page: skew, staff metrics, the
+     * detected staves down to their segments, and per staff the symbol
+     * rectangles along with the note, stem and beam detections.
+     *
+     * Symbols are kept as flat arrays of fixed size records which refer to
+     * each other by index, which is also how they are laid out on disk:
+     *
+     *   header      "MUNIPSNP", format version, section count
+     *   sections    id, record size, offset and record count per section
+     *   data        every section 8 byte aligned
+     *
+     * All records consist of little endian qint32 fields only, so a
+     * section can be used in place from a memory mapped file. Staff
+     * geometry is small and kept as one QDataStream section. Readers skip
+     * sections they do not know and accept records grown at the end.
+     */
+    struct PageSnapshot
+    {
+        static const quint32 FormatVersion;
+
+        struct RectRecord
+        {
+            qint32 x, y, width, height;
+        };
+
+        // Ranges into the other arrays for StaffData i, which belongs to
+        // staves[i].
+        struct StaffSymbolsRecord
+        {
+            qint32 firstSymbolRect, symbolRectCount;
+            qint32 firstNote, noteCount;
+            qint32 firstHollowNote, hollowNoteCount;
+            qint32 firstBeam, beamCount;
+        };
+
+        struct NoteRecord
+        {
+            RectRecord boundingRect;
+            qint32 firstNoteRect, noteRectCount;
+            qint32 stem; // -1 if there is none
+            qint32 isNoteHeadFilled;
+        };
+
+        struct StemRecord
+        {
+            RectRecord boundingRect;
+            qint32 note; // -1 if there is none
+            qint32 leftFlagCount, rightFlagCount;
+            qint32 firstFlagRun, flagRunCount;
+            qint32 firstPartialBeamRun, partialBeamRunCount;
+        };
+
+        struct BeamRecord
+        {
+            qint32 firstRun, runCount;
+        };
+
+        struct RunRecord
+        {
+            qint32 pos, runPos, runLength;
+        };
+
+        PageSnapshot();
+
+        // Copies the page model of context, or of DataWarehouse if 0.
+        static PageSnapshot fromPageContext(const PageContext *context = 0);
+        // Sets skew, staff metrics and staves of context.
+        void restore(PageContext *context) const;
+
+        // Both return false on failure, with errorMessage() telling why.
+        bool save(const QString& fileName);
+        bool load(const QString& fileName);
+        QString errorMessage() const { return m_errorMessage; }
+
+        static QRect toRect(const RectRecord& record);
+        static RectRecord fromRect(const QRect& rect);
+        static RunCoord toRunCoord(const RunRecord& record);
+
+        float pageSkew;
+        float pageSkewPrecision;
+        Range staffSpaceHeight;
+        Range staffLineHeight;
+        QList<Staff> staves;
+
+        QVector<StaffSymbolsRecord> staffSymbols;
+        QVector<RectRecord> symbolRects;
+        QVector<NoteRecord> notes;
+        QVector<RectRecord> noteRects;
+        QVector<StemRecord> stems;
+        QVector<BeamRecord> beams;
+        QVector<RunRecord> runs;
+
+    private:
+        bool isConsistent() const;
+
+        QString m_errorMessage;
+    };
+}
+
+#endif // PAGESNAPSHOT_H
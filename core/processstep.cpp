@@ -3,27 +3,22 @@
 
 #include "cluster.h"
 #include "datawarehouse.h"
-#include "imagewidget.h"
-#include "mainwindow.h"
-#include "projection.h"
+#include "stagecache.h"
 #include "tools.h"
-#include <QAction>
-#include <QDesktopServices>
+
 #include <QDir>
 #include <QFile>
-#include <QInputDialog>
-#include <QLabel>
-#include <QMessageBox>
 #include <QPainter>
 #include <QPen>
 #include <QProcess>
 #include <QRgb>
+#include <QScopedPointer>
 #include <QSet>
+#include <QtConcurrentMap>
 #include <QStack>
 #include <QTextStream>
 #include <QTime>
 #include <QList>
-#include <QUrl>
 
 #include <iostream>
 #include <cmath>
@@ -48,6 +43,7 @@ namespace Munip
         m_originalImage(originalImage),
         m_processedImage(originalImage),
         m_processQueue(processQueue),
+        m_pageContext(0),
         m_processCompleted(false),
         m_processFailed(false)
     {
@@ -101,6 +97,19 @@ namespace Munip
         return m_processQueue;
     }
 
+    PageContext* ProcessStep::pageContext() const
+    {
+        if (!m_pageContext) {
+            return DataWarehouse::instance();
+        }
+        return m_pageContext;
+    }
+
+    void ProcessStep::setPageContext(PageContext *context)
+    {
+        m_pageContext = context;
+    }
+
     void ProcessStep::slotStarted()
     {
         m_processCompleted = false;
@@ -122,51 +131,375 @@ namespace Munip
         m_failMessage = message;
     }
 
+    bool ProcessStep::isCacheable() const
+    {
+        return true;
+    }
+
     void ProcessStep::slotEnded()
     {
         m_processCompleted = true;
     }
 
-    ProcessStepAction::ProcessStepAction(const QByteArray& className, const QIcon& icon, const QString& caption, QObject *parent) :
-        QAction(icon, caption, parent),
-        m_className(className)
+    ProcessQueue::ProcessQueue(QObject *parent) :
+        QObject(parent),
+        m_pageContext(0),
+        m_cache(0)
+    {
+    }
+
+    ProcessQueue::~ProcessQueue()
+    {
+        delete m_cache;
+    }
+
+    PageContext* ProcessQueue::pageContext() const
+    {
+        return m_pageContext;
+    }
+
+    void ProcessQueue::setPageContext(PageContext *context)
     {
-        if (caption.isEmpty()) {
-            setText(QString(className));
+        m_pageContext = context;
+    }
+
+    void ProcessQueue::addStage(const QString& output, const QByteArray& className,
+            const QString& input, const QStringList& dependencies)
+    {
+        Stage stage;
+        stage.output = output;
+        stage.className = className;
+        stage.cacheId = className;
+        stage.creator = 0;
+        stage.input = input;
+        stage.dependencies = dependencies;
+        stage.done = false;
+
+        const int existing = producerOf(output);
+        if (existing >= 0) {
+            m_stages[existing] = stage;
+            m_results.remove(output);
+            m_keys.remove(output);
+            invalidateDependents(output);
+        } else {
+            m_stages << stage;
         }
-        connect(this, SIGNAL(triggered()), this, SLOT(execute()));
     }
 
-    void ProcessStepAction::execute()
+    void ProcessQueue::addStage(const QString& output, StepCreator creator,
+            const QString& input, const QStringList& dependencies,
+            const QByteArray& cacheId)
     {
-        MainWindow *main = MainWindow::instance();
-        if (!main)
-            return;
-        ImageWidget *imgWidget = main->activeImageWidget();
-        if (!imgWidget)
-            return;
-        QScopedPointer<ProcessStep> step(
-                ProcessStepFactory::create(m_className, imgWidget->image()));
-        if (step.isNull()) {
-            return;
+        addStage(output, QByteArray(), input, dependencies);
+        Stage &stage = m_stages[producerOf(output)];
+        stage.creator = creator;
+        stage.cacheId = cacheId;
+    }
+
+    bool ProcessQueue::setParameter(const QString& stage, const QString& name,
+            const QVariant& value)
+    {
+        const int index = producerOf(stage);
+        if (index < 0) {
+            return false;
         }
 
-        if (step->failed()) {
-            MainWindow::instance()->slotStatusErrorMessage(step->failMessage());
-            return;
+        Stage &s = m_stages[index];
+        if (s.parameters.contains(name) && s.parameters.value(name) == value) {
+            return true;
+        }
+        s.parameters.insert(name, value);
+        m_keys.remove(s.output);
+        if (s.done) {
+            s.done = false;
+            m_results.remove(s.output);
+            invalidateDependents(s.output);
+        }
+        return true;
+    }
+
+    QVariant ProcessQueue::parameter(const QString& stage, const QString& name) const
+    {
+        const int index = producerOf(stage);
+        return index < 0 ? QVariant() : m_stages[index].parameters.value(name);
+    }
+
+    void ProcessQueue::setResult(const QString& name, const QImage& image)
+    {
+        m_results.insert(name, image);
+        m_keys.remove(name);
+        const int producer = producerOf(name);
+        if (producer >= 0) {
+            m_stages[producer].done = true;
+        }
+        invalidateDependents(name);
+    }
+
+    bool ProcessQueue::hasResult(const QString& name) const
+    {
+        return m_results.contains(name);
+    }
+
+    QImage ProcessQueue::result(const QString& name) const
+    {
+        return m_results.value(name);
+    }
+
+    void ProcessQueue::keepResult(const QString& name)
+    {
+        m_keptResults.insert(name);
+    }
+
+    void ProcessQueue::clearResults()
+    {
+        m_results.clear();
+        m_keys.clear();
+        for (int i = 0; i < m_stages.size(); ++i) {
+            m_stages[i].done = false;
+        }
+    }
+
+    void ProcessQueue::setCacheDirectory(const QString& directory)
+    {
+        delete m_cache;
+        m_cache = directory.isEmpty() ? 0 : new StageCache(directory);
+    }
+
+    QStringList ProcessQueue::cacheHits() const
+    {
+        return m_cacheHits;
+    }
+
+    QString ProcessQueue::errorMessage() const
+    {
+        return m_errorMessage;
+    }
+
+    QList<QPair<QString, int> > ProcessQueue::stageTimes() const
+    {
+        return m_stageTimes;
+    }
+
+    int ProcessQueue::producerOf(const QString& name) const
+    {
+        for (int i = 0; i < m_stages.size(); ++i) {
+            if (m_stages[i].output == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool ProcessQueue::isKept(const QString& name) const
+    {
+        if (m_keptResults.contains(name)) {
+            return true;
+        }
+        foreach (const Stage& stage, m_stages) {
+            if (stage.input == name && !stage.parameters.isEmpty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    QByteArray ProcessQueue::resultKey(const QString& name)
+    {
+        if (!m_keys.contains(name)) {
+            if (!m_results.contains(name)) {
+                return QByteArray();
+            }
+            m_keys.insert(name, StageCache::imageKey(m_results.value(name)));
+        }
+        return m_keys.value(name);
+    }
+
+    // Empty if the stage has no cache id or the key of anything it reads
+    // is not known.
+    QByteArray ProcessQueue::stageKey(const Stage& stage)
+    {
+        if (stage.cacheId.isEmpty()) {
+            return QByteArray();
+        }
+
+        QList<QByteArray> inputKeys;
+        const QStringList names = QStringList(stage.input) + stage.dependencies;
+        foreach (const QString& name, names) {
+            const QByteArray key = resultKey(name);
+            if (key.isEmpty()) {
+                return QByteArray();
+            }
+            inputKeys << key;
+        }
+        return StageCache::stageKey(stage.cacheId, stage.parameters, inputKeys);
+    }
+
+    void ProcessQueue::invalidateDependents(const QString& name)
+    {
+        for (int i = 0; i < m_stages.size(); ++i) {
+            Stage &stage = m_stages[i];
+            if (!stage.done) continue;
+            if (stage.input == name || stage.dependencies.contains(name)) {
+                stage.done = false;
+                m_results.remove(stage.output);
+                m_keys.remove(stage.output);
+                invalidateDependents(stage.output);
+            }
+        }
+    }
+
+    bool ProcessQueue::fail(const QString& message)
+    {
+        m_errorMessage = message;
+        return false;
+    }
+
+    bool ProcessQueue::execute()
+    {
+        m_errorMessage.clear();
+        m_stageTimes.clear();
+        m_cacheHits.clear();
+
+        const int n = m_stages.size();
+
+        // Stages which already ran only run again when a pending stage
+        // reads their result and it has been released meanwhile.
+        QVector<bool> pending(n);
+        for (int i = 0; i < n; ++i) {
+            pending[i] = !m_stages[i].done;
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = 0; i < n; ++i) {
+                if (!pending[i]) continue;
+                const Stage &stage = m_stages[i];
+                const QStringList names = QStringList(stage.input) + stage.dependencies;
+                foreach (const QString& name, names) {
+                    const int producer = producerOf(name);
+                    if (producer < 0) {
+                        if (!m_results.contains(name)) {
+                            return fail(QString("%1: missing input %2").arg(stage.output).arg(name));
+                        }
+                    } else if (name == stage.input && !pending[producer] &&
+                            !m_results.contains(name)) {
+                        pending[producer] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // Topological order, stages which are ready run in the order they
+        // were added.
+        QVector<bool> scheduled(n, false);
+        QList<int> order;
+        int pendingCount = 0;
+        for (int i = 0; i < n; ++i) {
+            pendingCount += pending[i] ? 1 : 0;
+        }
+        while (order.size() < pendingCount) {
+            bool progress = false;
+            for (int i = 0; i < n; ++i) {
+                if (!pending[i] || scheduled[i]) continue;
+
+                const Stage &stage = m_stages[i];
+                const QStringList names = QStringList(stage.input) + stage.dependencies;
+                bool ready = true;
+                foreach (const QString& name, names) {
+                    const int producer = producerOf(name);
+                    if (producer >= 0 && pending[producer] && !scheduled[producer]) {
+                        ready = false;
+                        break;
+                    }
+                }
+                if (ready) {
+                    order << i;
+                    scheduled[i] = true;
+                    progress = true;
+                }
+            }
+            if (!progress) {
+                return fail("Cycle in the stage graph");
+            }
+        }
+
+        // Number of stages still to read each result.
+        QHash<QString, int> readers;
+        foreach (int i, order) {
+            ++readers[m_stages[i].input];
         }
 
-        DataWarehouse::instance()->setWorkImage(imgWidget->image());
-        QTime timer;
-        timer.start();
-        step->process();
-        mDebug() << m_className << " : Took " << timer.elapsed() << " msecs";
+        foreach (int i, order) {
+            Stage &stage = m_stages[i];
+            {
+                QScopedPointer<ProcessStep> step(stage.creator ?
+                        stage.creator(m_results.value(stage.input)) :
+                        ProcessStepFactory::create(stage.className, m_results.value(stage.input)));
+                if (step.isNull()) {
+                    return fail(QString("%1: unknown step %2").arg(stage.output)
+                            .arg(QString(stage.className)));
+                }
+                if (m_pageContext) {
+                    step->setPageContext(m_pageContext);
+                }
+                QVariantMap::const_iterator it;
+                for (it = stage.parameters.constBegin(); it != stage.parameters.constEnd(); ++it) {
+                    if (!step->setProperty(it.key().toLatin1().constData(), it.value())) {
+                        return fail(QString("%1: cannot set parameter %2").arg(stage.output)
+                                .arg(it.key()));
+                    }
+                }
+                if (step->failed()) {
+                    return fail(stage.output + ": " + step->failMessage());
+                }
+
+                const QByteArray key = (m_cache && step->isCacheable()) ?
+                    stageKey(stage) : QByteArray();
+
+                QTime timer;
+                timer.start();
+                QImage cached;
+                if (!key.isEmpty() && m_cache->load(key, &cached, step->pageContext())) {
+                    m_stageTimes << qMakePair(stage.output, timer.elapsed());
+                    m_cacheHits << stage.output;
+                    m_results.insert(stage.output, cached);
+                } else {
+                    QList<QByteArray> before;
+                    if (!key.isEmpty()) {
+                        before = StageCache::contextState(step->pageContext());
+                    }
+
+                    step->process();
+                    m_stageTimes << qMakePair(stage.output, timer.elapsed());
+
+                    if (step->failed()) {
+                        return fail(stage.output + ": " + step->failMessage());
+                    }
+                    m_results.insert(stage.output, step->processedImage());
+                    if (!key.isEmpty()) {
+                        m_cache->store(key, step->processedImage(), before,
+                                StageCache::contextState(step->pageContext()));
+                    }
+                }
+                if (!key.isEmpty()) {
+                    m_keys.insert(stage.output, key);
+                }
+                stage.done = true;
+            }
 
-        ImageWidget *processed = new ImageWidget(step->processedImage());
-        processed->setWidgetID(IDGenerator::gen());
-        processed->setProcessorWidget(imgWidget);
+            // Release what no later stage reads. Results given by the
+            // caller are left alone.
+            if (--readers[stage.input] == 0 && !isKept(stage.input) &&
+                    producerOf(stage.input) >= 0) {
+                m_results.remove(stage.input);
+            }
+            if (readers.value(stage.output) == 0 && !isKept(stage.output)) {
+                m_results.remove(stage.output);
+            }
+        }
 
-        main->addSubWindow(processed);
+        return true;
     }
 
     ProcessStep* ProcessStepFactory::create(const QByteArray& className, const QImage& originalImage, ProcessQueue *queue)
@@ -196,29 +529,6 @@ namespace Munip
         return step;
     }
 
-    QList<ProcessStepAction*> ProcessStepFactory::actions(QObject *parent)
-    {
-        static QList<ProcessStepAction*> actions;
-        static QByteArray classes[] =
-        {
-            "MonoChromeConversion", "SkewCorrection", "StaffLineDetect",
-            "StaffLineRemoval", "SymbolAreaExtraction",
-            "StaffParamExtraction", "ImageCluster", "ImageRotation",
-            "GrayScaleConversion", "NewSkewCorrection"
-        };
-
-        if (actions.isEmpty()) {
-            int size = (int)((sizeof(classes))/(sizeof(QByteArray)));
-            for (int i = 0; i < size; ++i) {
-                ProcessStepAction *newAction = new ProcessStepAction(classes[i]);
-                newAction->setParent(parent);
-                actions << newAction;
-            }
-        }
-
-        return actions;
-    }
-
     GrayScaleConversion::GrayScaleConversion(const QImage& originalImage, ProcessQueue *queue) : ProcessStep(originalImage, queue)
     {
     }
@@ -273,6 +583,16 @@ namespace Munip
         emit ended();
     }
 
+    int MonoChromeConversion::threshold() const
+    {
+        return m_threshold;
+    }
+
+    void MonoChromeConversion::setThreshold(int threshold)
+    {
+        m_threshold = threshold;
+    }
+
     SkewCorrection::SkewCorrection(const QImage& originalImage, ProcessQueue *queue) :
         ProcessStep(originalImage, queue),
         m_workImage(originalImage),
@@ -454,10 +774,12 @@ namespace Munip
     {
         emit started();
 
-        m_lineRemovedTracker = QPixmap(m_processedImage.size());
-        m_rectTracker = QPixmap(m_processedImage.size());
-        m_lineRemovedTracker.fill(QColor(Qt::white));
-        m_rectTracker.fill(QColor(Qt::white));
+        // QImage rather than QPixmap so that pages can be processed
+        // outside the GUI thread.
+        m_lineRemovedTracker = QImage(m_processedImage.size(), QImage::Format_ARGB32_Premultiplied);
+        m_rectTracker = QImage(m_processedImage.size(), QImage::Format_ARGB32_Premultiplied);
+        m_lineRemovedTracker.fill(0xffffffff);
+        m_rectTracker.fill(0xffffffff);
         m_symbolMap = m_processedImage;
         detectLines();
 
@@ -480,7 +802,7 @@ namespace Munip
         QPainter p(&m_processedImage);
         QColor color(Qt::darkGreen);
         p.setPen(color);
-        DataWarehouse *dw = DataWarehouse::instance();
+        PageContext *dw = pageContext();
         const QList<Staff> staffList = dw->staffList();
         foreach (const Staff& staff, staffList) {
             bool thickenSegments = false;
@@ -534,7 +856,7 @@ namespace Munip
         }
 
 
-        // m_processedImage = m_lineRemovedTracker.toImage();
+        // m_processedImage = m_lineRemovedTracker;
 #if 0
         const int White = m_processedImage.color(0) == 0xffffffff ? 0 : 1;
         const int Black = 1 - White;
@@ -546,7 +868,7 @@ namespace Munip
                     p.drawPoint(x,y);
         p.end();
 
-        MainWindow::instance()->addSubWindow(new ImageWidget(m_rectTracker.toImage()));
+        MainWindow::instance()->addSubWindow(new ImageWidget(m_rectTracker));
         MainWindow::instance()->addSubWindow(new ImageWidget(m_symbolMap));
 #endif
 
@@ -814,7 +1136,7 @@ void StaffLineDetect::constructStaff()
 {
 
     int i = 0;
-    DataWarehouse::instance()->clearStaff();
+    pageContext()->clearStaff();
     while (i < m_lineList.size())
     {
         Staff s;
@@ -829,7 +1151,7 @@ void StaffLineDetect::constructStaff()
         s.setEndPos(s.staffLines()[s.staffLines().size()-1].endPos());
         s.setBoundingRect(findStaffBoundingRect(s));
 
-        DataWarehouse ::instance()->appendStaff(s);
+        pageContext()->appendStaff(s);
 #if 0
         identifySymbolRegions(s);
 #endif
@@ -839,7 +1161,7 @@ void StaffLineDetect::constructStaff()
 
 void StaffLineDetect::estimateStaffParametersFromYellowAreas()
 {
-    DataWarehouse *dw = DataWarehouse::instance();
+    PageContext *dw = pageContext();
     const QList<Staff> staffList = dw->staffList();
     const QRgb yellowColor = QColor(Qt::darkYellow).rgb();
     const QRgb whiteColor = QColor(Qt::white).rgb();
@@ -1057,7 +1379,7 @@ void StaffLineDetect::drawDetectedLines()
         i++;
     }
 
-    m_lineMap = m_lineRemovedTracker.toImage();
+    m_lineMap = m_lineRemovedTracker;
     ProcessStep *step = ProcessStepFactory::create("MonoChromeConversion",m_lineMap,0);
     step->process();
     m_lineMap = step->processedImage();
@@ -1481,7 +1803,7 @@ void StaffLineRemoval::process()
 {
     emit started();
 
-    QImage &imageRef = DataWarehouse::instance()->imageRefWithRemovedStaffLinesOnly();
+    QImage &imageRef = pageContext()->imageRefWithRemovedStaffLinesOnly();
     imageRef = QImage(m_originalImage.size(), QImage::Format_Mono);
     imageRef.fill(0xffffffff);
     crudeRemove();
@@ -1502,7 +1824,7 @@ void StaffLineRemoval::crudeRemove()
     const QRgb YellowColor = QColor(Qt::darkYellow).rgb();
     const QRgb WhiteColor = QColor(Qt::white).rgb();
 
-    QImage &imageRef = DataWarehouse::instance()->imageRefWithRemovedStaffLinesOnly();
+    QImage &imageRef = pageContext()->imageRefWithRemovedStaffLinesOnly();
     QPainter imageRefPainter(&imageRef);
     imageRefPainter.setPen(QColor(Qt::black));
 
@@ -1510,8 +1832,8 @@ void StaffLineRemoval::crudeRemove()
     p.begin(&m_processedImage);
 
 
-    const int staffLineHeight = DataWarehouse::instance()->staffLineHeight().dominantValue();
-    const QList<Staff> staffList = DataWarehouse::instance()->staffList();
+    const int staffLineHeight = pageContext()->staffLineHeight().dominantValue();
+    const QList<Staff> staffList = pageContext()->staffList();
 
     foreach (const Staff& staff, staffList) {
         const QList<StaffLine> staffLines = staff.staffLines();
@@ -1531,7 +1853,7 @@ void StaffLineRemoval::crudeRemove()
                 y = runEnd + 1;
                 int aboveBlackPixels = 0, belowBlackPixels = 0;
 
-                static const int margin = staffLineHeight > 1 ? 1 : 0;
+                const int margin = staffLineHeight > 1 ? 1 : 0;
 
                 for (int yy = runStart - 1; yy >= 0; --yy) {
                     if (m_processedImage.pixel(x, yy) == WhiteColor) break;
@@ -1564,7 +1886,7 @@ void StaffLineRemoval::cleanupNoise()
 {
     // Note these aren't indices but color instead.
     const QRgb BlackColor = QColor(Qt::black).rgb();
-    QImage &imageRef = DataWarehouse::instance()->imageRefWithRemovedStaffLinesOnly();
+    QImage &imageRef = pageContext()->imageRefWithRemovedStaffLinesOnly();
     QPainter imageRefPainter(&imageRef);
     imageRefPainter.setPen(QColor(Qt::black));
 
@@ -1572,7 +1894,7 @@ void StaffLineRemoval::cleanupNoise()
     QPainter p;
     p.begin(&yetAnotherImage);
 
-    DataWarehouse *dw = DataWarehouse::instance();
+    PageContext *dw = pageContext();
     if (dw->staffLineHeight().dominantValue() == 1) {
         return;
     }
@@ -1626,11 +1948,11 @@ void StaffLineRemoval::yellowToBlack()
 
 void StaffLineRemoval::staffCleanUp()
 {
-    QImage &imageRef = DataWarehouse::instance()->imageRefWithRemovedStaffLinesOnly();
+    QImage &imageRef = pageContext()->imageRefWithRemovedStaffLinesOnly();
     QPainter imageRefPainter(&imageRef);
     imageRefPainter.setPen(QColor(Qt::black));
 
-    DataWarehouse *dw = DataWarehouse::instance();
+    PageContext *dw = pageContext();
     const QList<Staff> staffList = dw->staffList();
     foreach (const Staff& staff, staffList) {
         const QRgb White = QColor(Qt::white).rgb();
@@ -1806,7 +2128,7 @@ void StaffParamExtraction::process()
         }
     }
 
-    DataWarehouse *dw = DataWarehouse::instance();
+    PageContext *dw = pageContext();
     dw->setStaffSpaceHeight(maxRunLengthsRanges[White]);
     dw->setStaffLineHeight(maxRunLengthsRanges[Black]);
 
@@ -1901,6 +2223,7 @@ void StaffParamExtraction::setDrawGraph(bool b)
 }
 
 const qreal ImageRotation::InvalidAngle = -753;
+const qreal ImageRotation::DefaultAngle = 5;
 
 ImageRotation::ImageRotation(const QImage& image, ProcessQueue *queue) :
     ProcessStep(image, queue), m_angle(ImageRotation::InvalidAngle)
@@ -1917,15 +2240,9 @@ void ImageRotation::process()
     emit started();
     QImage::Format destFormat = m_originalImage.format();
 
+    // The GUI asks for the angle before creating the step.
     if (qFuzzyCompare(m_angle, ImageRotation::InvalidAngle)) {
-        bool ok;
-        qreal angle = QInputDialog::getDouble(0, tr("Angle"), tr("Enter rotation angle in degrees for image rotation"),
-                5, -45, 45, 1, &ok);
-        if (!ok) {
-            angle = 5;
-        }
-
-        m_angle = angle;
+        m_angle = ImageRotation::DefaultAngle;
     }
 
     QTransform transform;
@@ -1986,16 +2303,9 @@ void ImageCluster::process()
 {
     emit started();
 
+    // Without an explicit staff space height use the one of the page.
     if (m_clusterSet.radius() < 0) {
-        bool ok;
-        int staffSpaceHeight =
-            QInputDialog::getInt(0, tr("Staff space height"),
-                    tr("Enter staff space height in pixels"),
-                    5, 0, 100, 1, &ok);
-        if (!ok) {
-            staffSpaceHeight = 5;
-        }
-
+        const int staffSpaceHeight = pageContext()->staffSpaceHeight().min;
         QPair<int, int> p = ImageCluster::clusterParams(staffSpaceHeight);
         m_clusterSet.setRadius(p.first);
         m_clusterSet.setMinPoints(p.second);
@@ -2003,14 +2313,15 @@ void ImageCluster::process()
 
     m_clusterSet.setImage(m_originalImage);
     m_clusterSet.computeNearestNeighbors();
+    m_clusterSet.computeClusters();
 
     mDebug() << Q_FUNC_INFO << "No of core points : " << m_clusterSet.coreSize() << endl;
+    mDebug() << Q_FUNC_INFO << "No of clusters : " << m_clusterSet.clusters().size() << endl;
 
     m_processedImage = QImage(m_originalImage.size(), QImage::Format_ARGB32_Premultiplied);
     QPainter p(&m_processedImage);
     p.fillRect(QRect(QPoint(0, 0), m_processedImage.size()), Qt::white);
-    p.setPen(QColor(Qt::red));
-    m_clusterSet.drawCore(p);
+    m_clusterSet.drawClusters(p);
     p.end();
 
     emit ended();
@@ -2042,23 +2353,30 @@ SymbolAreaExtraction::SymbolAreaExtraction(const QImage& originalImage,
     Q_UNUSED(staffSpaceHeight);
 }
 
+static void processStaffData(StaffData *sd)
+{
+    sd->process();
+}
+
 void SymbolAreaExtraction::process()
 {
     emit started();
 
-    DataWarehouse *dw = DataWarehouse::instance();
+    PageContext *dw = pageContext();
     const QList<Staff> staffList = dw->staffList();
 
+    // StaffData copies everything it needs from the page context up front,
+    // so the staves are independent and can be processed concurrently.
+    const StaffParams params = StaffParams::fromPageContext(dw);
     QList<StaffData*> staffDatas;
     QSize sz;
     foreach (const Staff& staff, staffList) {
-        StaffData *sd = new StaffData(m_originalImage, staff);
-        sd->process();
-        staffDatas << sd;
+        staffDatas << new StaffData(m_originalImage, staff, params);
 
         sz.rwidth() = qMax(sz.width(), staff.staffBoundingRect().width());
         sz.rheight() += staff.boundingRect().height() * 2 + 100;
     }
+    QtConcurrent::blockingMap(staffDatas, processStaffData);
 
     m_processedImage = QImage(sz, QImage::Format_ARGB32_Premultiplied);
     m_processedImage.fill(0xffffffff);
@@ -7,16 +7,16 @@
 #include "symbol.h"
 #include "tools.h"
 
-#include <QAction>
 #include <QDataStream>
 #include <QDebug>
 #include <QHash>
 #include <QPoint>
 #include <QPointer>
 #include <QQueue>
+#include <QSet>
+#include <QStringList>
 #include <QVariant>
 
-class QIcon;
 class HorizontalRunlengthImage;
 
 inline uint qHash(const QRect &rect)
@@ -27,7 +27,9 @@ inline uint qHash(const QRect &rect)
 namespace Munip {
     // Forwared declarations
     class Page;
+    class PageContext;
     class ProcessQueue;
+    class StageCache;
 
     // Assumes line's start pos is <= 4k and >= 0.
     inline uint qHash( const Munip ::Segment &line )
@@ -64,11 +66,21 @@ namespace Munip {
 
         ProcessQueue* processQueue() const;
 
+        // Page state this step reads and writes. Defaults to the GUI wide
+        // DataWarehouse unless set explicitly.
+        PageContext* pageContext() const;
+        void setPageContext(PageContext *context);
+
         bool failed() const;
         QString failMessage() const;
 
         void setFailed(const QString& message);
 
+        // Whether ProcessQueue may take the results of this step from a
+        // StageCache. Steps leaving state behind in the page context which
+        // the cache cannot restore return false.
+        virtual bool isCacheable() const;
+
     Q_SIGNALS:
         void started();
         void ended();
@@ -84,37 +96,128 @@ namespace Munip {
         QImage m_processedImage;
 
         QPointer<ProcessQueue> m_processQueue;
+        PageContext *m_pageContext;
         bool m_processCompleted;
 
         bool m_processFailed;
         QString m_failMessage;
     };
 
+    /**
+     * Executes a pipeline given as a graph of stages.
+     *
+     * Every stage names the result it produces, the result whose image it
+     * processes and optionally further results it depends on, which only
+     * have to be computed first (e.g. for page context state written by
+     * another stage). Adding a stage for an existing result replaces the
+     * stage producing it. Results which
+     * are not produced by any stage have to be given with setResult().
+     *
+     * execute() runs the stages in dependency order. A result consumed by
+     * several stages is computed once and shared between the branches.
+     * Steps are deleted as soon as they have run, and intermediate images
+     * are released once the last stage reading them has run, unless they
+     * were marked with keepResult(). Stages which already ran are skipped
+     * by later execute() calls as long as their result is available, so
+     * stages added afterwards reuse everything computed before, and a
+     * parameter change only recomputes the stages after it.
+     *
+     * The QQueue part is still there for steps constructed with a queue,
+     * which enqueue themselves so previousStep() and nextStep() work.
+     */
     class ProcessQueue : public QObject, public QQueue<ProcessStep*>
-    {
-        Q_OBJECT;
-    };
-
-    class ProcessStepAction : public QAction
     {
         Q_OBJECT;
     public:
-        ProcessStepAction(const QByteArray& className,
-                          const QIcon& icon = QIcon(),
-                          const QString& caption = QString(),
-                          QObject *parent = 0);
-
-    public Q_SLOTS:
-        void execute();
+        typedef ProcessStep* (*StepCreator)(const QImage& input);
+
+        ProcessQueue(QObject *parent = 0);
+        virtual ~ProcessQueue();
+
+        // Context handed to every step, DataWarehouse if 0.
+        PageContext* pageContext() const;
+        void setPageContext(PageContext *context);
+
+        // Adds a stage creating its step by class name through
+        // ProcessStepFactory, or with creator for steps which need
+        // constructor arguments. The class name identifies the step in the
+        // disk cache; a creator stage is only cached under an explicit
+        // cacheId, which must be unique to what creator builds.
+        void addStage(const QString& output, const QByteArray& className,
+                const QString& input, const QStringList& dependencies = QStringList());
+        void addStage(const QString& output, StepCreator creator,
+                const QString& input, const QStringList& dependencies = QStringList(),
+                const QByteArray& cacheId = QByteArray());
+
+        // Sets a Qt property of the step of stage before it runs. A new
+        // value makes the stage and everything depending on it run again
+        // while results upstream stay cached, the input of a stage with
+        // parameters is kept for that reason. Returns false if there is
+        // no such stage.
+        bool setParameter(const QString& stage, const QString& name, const QVariant& value);
+        QVariant parameter(const QString& stage, const QString& name) const;
+
+        // Sets a result, stages which depend on it directly or indirectly
+        // will run again.
+        void setResult(const QString& name, const QImage& image);
+        bool hasResult(const QString& name) const;
+        QImage result(const QString& name) const;
+        void keepResult(const QString& name);
+        // Drops all results, the next execute() runs every stage.
+        void clearResults();
+
+        // Looks up stage results in an on-disk StageCache in directory,
+        // and stores them there, before running a step. An empty
+        // directory disables the cache.
+        void setCacheDirectory(const QString& directory);
+        // Stages of the last execute() whose results came from the cache.
+        QStringList cacheHits() const;
+
+        // Runs the stages which have not run yet, returns false if a step
+        // failed or the graph has a cycle or a missing input.
+        bool execute();
+        QString errorMessage() const;
+
+        // Stage names and milliseconds of the last execute(), in the order
+        // the stages ran.
+        QList<QPair<QString, int> > stageTimes() const;
 
     private:
-        QByteArray m_className;
+        struct Stage
+        {
+            QString output;
+            QByteArray className;
+            QByteArray cacheId;
+            StepCreator creator;
+            QString input;
+            QStringList dependencies;
+            QVariantMap parameters;
+            bool done;
+        };
+
+        int producerOf(const QString& name) const;
+        bool isKept(const QString& name) const;
+        QByteArray resultKey(const QString& name);
+        QByteArray stageKey(const Stage& stage);
+        void invalidateDependents(const QString& name);
+        bool fail(const QString& message);
+
+        PageContext *m_pageContext;
+        QList<Stage> m_stages;
+        QHash<QString, QImage> m_results;
+        QSet<QString> m_keptResults;
+        QString m_errorMessage;
+        QList<QPair<QString, int> > m_stageTimes;
+
+        StageCache *m_cache;
+        // Cache keys of results, kept after the images are released.
+        QHash<QString, QByteArray> m_keys;
+        QStringList m_cacheHits;
     };
 
     struct ProcessStepFactory
     {
         static ProcessStep* create(const QByteArray& className, const QImage& originalImage, ProcessQueue *processQueue = 0);
-        static QList<ProcessStepAction*> actions(QObject *parent = 0);
     };
 
     class GrayScaleConversion : public ProcessStep
@@ -128,6 +231,7 @@ namespace Munip {
     class MonoChromeConversion : public ProcessStep
     {
         Q_OBJECT;
+        Q_PROPERTY(int threshold READ threshold WRITE setThreshold)
     public:
         MonoChromeConversion(const QImage& originalImage, ProcessQueue *procecssQueue = 0);
         virtual void process();
@@ -142,10 +246,14 @@ namespace Munip {
     class SkewCorrection : public ProcessStep
     {
         Q_OBJECT;
+        Q_PROPERTY(int lineSliceSize READ lineSliceSize WRITE setLineSliceSize)
     public:
         SkewCorrection(const QImage& originalImage, ProcessQueue *processqueue = 0);
         virtual void process();
 
+        int lineSliceSize() const { return m_lineSliceSize; }
+        void setLineSliceSize(int size) { m_lineSliceSize = size; }
+
         double detectSkew();
         void dfs(int x, int y, QList<QPoint> points);
         double findSkew(QList<QPoint> &points);
@@ -157,7 +265,7 @@ namespace Munip {
 
     private:
         QImage m_workImage;
-        const int m_lineSliceSize;
+        int m_lineSliceSize;
         //const float m_skewPrecision;
         QList<double> m_skewList;
     };
@@ -186,8 +294,8 @@ namespace Munip {
     private:
         QList<StaffLine> m_lineList;
         QList<Segment> m_maxPaths;
-        QPixmap m_lineRemovedTracker;
-        QPixmap m_rectTracker;
+        QImage m_lineRemovedTracker;
+        QImage m_rectTracker;
         QImage m_symbolMap;
         QImage m_lineMap;
         QList<Segment> m_segments[5000];
@@ -236,6 +344,7 @@ namespace Munip {
     class StaffParamExtraction : public ProcessStep
     {
     Q_OBJECT
+    Q_PROPERTY(bool drawGraph READ drawGraph WRITE setDrawGraph)
     public:
         StaffParamExtraction(const QImage& originalImage, bool drawGraph,
                 ProcessQueue *queue);
@@ -243,6 +352,7 @@ namespace Munip {
 
         virtual void process();
 
+        bool drawGraph() const { return m_drawGraph; }
         void setDrawGraph(bool status);
 
     private:
@@ -259,6 +369,7 @@ namespace Munip {
 
     private:
         static const qreal InvalidAngle;
+        static const qreal DefaultAngle;
         qreal m_angle;
     };
 
@@ -274,6 +385,8 @@ namespace Munip {
 
         static QPair<int, int> clusterParams(int staffSpaceHeight);
 
+        const ClusterSet& clusterSet() const { return m_clusterSet; }
+
     private:
         static int InvalidStaffSpaceHeight;
         ClusterSet m_clusterSet;
@@ -289,6 +402,9 @@ namespace Munip {
                 ProcessQueue *queue = 0);
         void extraStuff();
         virtual void process();
+        // The StaffData objects it leaves in the page context are not
+        // cached.
+        virtual bool isCacheable() const { return false; }
 
     private:
         static int InvalidStaffSpaceHeight;
@@ -300,10 +416,14 @@ namespace Munip
     class NewSkewCorrection : public ProcessStep
     {
         Q_OBJECT;
+        Q_PROPERTY(int lineSliceSize READ lineSliceSize WRITE setLineSliceSize)
     public:
         NewSkewCorrection(const QImage& originalImage, ProcessQueue *processqueue = 0);
         virtual void process();
 
+        int lineSliceSize() const { return m_lineSliceSize; }
+        void setLineSliceSize(int size) { m_lineSliceSize = size; }
+
         double detectSkew();
         void dfs(int x, int y, QList<QPoint> &points, int index);
         void upDfs(int x, int y, QList<QPoint> &points, int index);
@@ -317,7 +437,7 @@ namespace Munip
 
     private:
         QImage m_workImage;
-        const int m_lineSliceSize;
+        int m_lineSliceSize;
         //const float m_skewPrecision;
         QList<double> m_skewList;
         QList<double> m_upSkewList;
@@ -153,4 +153,25 @@ namespace Munip
             m_endPos.x() >=0 && m_endPos.y() >= 0;
     }
 
+    QDataStream& operator<<(QDataStream& stream, const Segment& segment)
+    {
+        stream << segment.startPos() << segment.endPos()
+            << qint32(segment.connectedComponentID())
+            << segment.sourcePos() << segment.destinationPos();
+        return stream;
+    }
+
+    QDataStream& operator>>(QDataStream& stream, Segment& segment)
+    {
+        QPoint start, end, source, destination;
+        qint32 id;
+        stream >> start >> end >> id >> source >> destination;
+        segment.setStartPos(start);
+        segment.setEndPos(end);
+        segment.setConnectedComponentID(id);
+        segment.setSourcePos(source);
+        segment.setDestinationPos(destination);
+        return stream;
+    }
+
 }
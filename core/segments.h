@@ -2,6 +2,7 @@
 #define SEGMENTS_H
 
 
+#include<QDataStream>
 #include<QPoint>
 #include<QList>
 
@@ -53,6 +54,9 @@ namespace Munip
         QPoint m_destinationPos;
         QPoint m_sourcePos;
     };
+
+    QDataStream& operator<<(QDataStream& stream, const Segment& segment);
+    QDataStream& operator>>(QDataStream& stream, Segment& segment);
 }
 
 
@@ -4,7 +4,6 @@
 #include "tools.h"
 
 #include <QDebug>
-#include <QLabel>
 #include <QPainter>
 #include <QPen>
 #include <QRgb>
@@ -278,4 +277,48 @@ namespace Munip
         m_boundingRect = boundingRect;
     }
 
+    QDataStream& operator<<(QDataStream& stream, const StaffLine& line)
+    {
+        stream << line.m_startPos << line.m_endPos << qint32(line.m_staffLineID)
+            << line.m_boundingRect << line.m_segmentList;
+        return stream;
+    }
+
+    QDataStream& operator>>(QDataStream& stream, StaffLine& line)
+    {
+        qint32 id;
+        stream >> line.m_startPos >> line.m_endPos >> id
+            >> line.m_boundingRect >> line.m_segmentList;
+        line.m_staffLineID = id;
+        return stream;
+    }
+
+    QDataStream& operator<<(QDataStream& stream, const Staff& staff)
+    {
+        stream << staff.m_startPos << staff.m_endPos
+            << staff.m_boundingRect << staff.m_staffBoundingRect
+            << quint32(staff.m_staffLines.size());
+        foreach (const StaffLine& line, staff.m_staffLines) {
+            stream << line;
+        }
+        return stream;
+    }
+
+    QDataStream& operator>>(QDataStream& stream, Staff& staff)
+    {
+        quint32 lineCount;
+        stream >> staff.m_startPos >> staff.m_endPos
+            >> staff.m_boundingRect >> staff.m_staffBoundingRect
+            >> lineCount;
+
+        staff.m_staffLines.clear();
+        for (quint32 i = 0; i < lineCount && stream.status() == QDataStream::Ok; ++i) {
+            // StaffLine has no default constructor for QList's operator>>.
+            StaffLine line(QPoint(-1, -1), QPoint(-1, -1));
+            stream >> line;
+            staff.m_staffLines << line;
+        }
+        return stream;
+    }
+
 }
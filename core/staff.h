@@ -5,6 +5,7 @@
 #include <QRect>
 #include <QList>
 #include <QHash>
+#include <QDataStream>
 
 #include "segments.h"
 
@@ -51,6 +52,9 @@ namespace Munip {
         int m_staffLineID; // The Staff Number To Which The Line Belongs
         QList<Segment> m_segmentList;
         QRect m_boundingRect;
+
+        friend QDataStream& operator<<(QDataStream& stream, const StaffLine& line);
+        friend QDataStream& operator>>(QDataStream& stream, StaffLine& line);
     };
 
     class Staff
@@ -88,6 +92,16 @@ namespace Munip {
         QPoint m_endPos;
         QRect m_boundingRect;
         QRect m_staffBoundingRect;
+
+        friend QDataStream& operator<<(QDataStream& stream, const Staff& staff);
+        friend QDataStream& operator>>(QDataStream& stream, Staff& staff);
     };
+
+    // Exact copies including the derived rectangles, for caching and
+    // snapshots of detected staves.
+    QDataStream& operator<<(QDataStream& stream, const StaffLine& line);
+    QDataStream& operator>>(QDataStream& stream, StaffLine& line);
+    QDataStream& operator<<(QDataStream& stream, const Staff& staff);
+    QDataStream& operator>>(QDataStream& stream, Staff& staff);
 }
 #endif
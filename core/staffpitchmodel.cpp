@@ -0,0 +1,119 @@
+#include "staffpitchmodel.h"
+
+namespace Munip
+{
+    // At most this many lines fit between the top line and the last
+    // position.
+    static const int MaxLineCount = (StaffPositionCount - TopLinePosition) / 2;
+
+    StaffPitchModel::StaffPitchModel(const Staff& staff, const Range& staffSpaceHeight,
+            const Range& staffLineHeight, Clef clef) :
+        m_clef(clef)
+    {
+        const QRect rect = staff.boundingRect();
+        const QPoint origin = rect.topLeft();
+        const QList<StaffLine> staffLines = staff.staffLines();
+
+        m_width = qMax(1, rect.width());
+        m_lineCount = qMin(staffLines.size(), MaxLineCount);
+        m_shift = qMax(1, (staffSpaceHeight.dominantValue() >> 1) +
+                (staffLineHeight.dominantValue() >> 1));
+        m_lineY.resize(m_width * m_lineCount);
+
+        QVector<int> y(m_width);
+        QVector<bool> known(m_width);
+        for (int line = 0; line < m_lineCount; ++line) {
+            const StaffLine& staffLine = staffLines[line];
+            QList<Segment> segments = staffLine.segments();
+            if (segments.isEmpty()) {
+                segments << Segment(staffLine.startPos(), staffLine.endPos());
+            }
+
+            known.fill(false);
+            foreach (const Segment& seg, segments) {
+                QPoint a = seg.startPos() - origin;
+                QPoint b = seg.endPos() - origin;
+                if (a.x() > b.x()) {
+                    qSwap(a, b);
+                }
+                const int dx = b.x() - a.x();
+                for (int x = qMax(0, a.x()); x <= qMin(m_width - 1, b.x()); ++x) {
+                    y[x] = dx ? a.y() + (b.y() - a.y()) * (x - a.x()) / dx : a.y();
+                    known[x] = true;
+                }
+            }
+
+            // Gaps between segments are bridged linearly, beyond the ends
+            // the line keeps its height.
+            int previous = -1;
+            for (int x = 0; x <= m_width; ++x) {
+                if (x < m_width && !known[x]) continue;
+
+                for (int gap = previous + 1; gap < x; ++gap) {
+                    if (previous < 0 && x == m_width) {
+                        y[gap] = staffLine.startPos().y() - origin.y();
+                    } else if (previous < 0) {
+                        y[gap] = y[x];
+                    } else if (x == m_width) {
+                        y[gap] = y[previous];
+                    } else {
+                        y[gap] = y[previous] + (y[x] - y[previous]) * (gap - previous) / (x - previous);
+                    }
+                }
+                previous = x;
+            }
+
+            for (int x = 0; x < m_width; ++x) {
+                m_lineY[x * m_lineCount + line] = y[x];
+            }
+        }
+    }
+
+    QPair<char, int> StaffPitchModel::noteOctaveAt(int x, int y) const
+    {
+        const Pitch p = pitch(positionAt(x, y));
+        return qMakePair(p.step, p.octave);
+    }
+
+    int StaffPitchModel::positionAt(int x, int y) const
+    {
+        if (m_lineCount == 0) {
+            return TopLinePosition + 4; // the middle line
+        }
+        x = qBound(0, x, m_width - 1);
+
+        // Outside the staff the positions are m_shift apart, counted from
+        // the outermost line. On a tie the lower position wins.
+        const int lastLinePosition = TopLinePosition + 2 * (m_lineCount - 1);
+        const int top = lineY(0, x);
+        const int bottom = lineY(m_lineCount - 1, x);
+        if (y <= top) {
+            const int steps = (2 * (top - y) + m_shift - 1) / (2 * m_shift);
+            return TopLinePosition - qMin(steps, TopLinePosition);
+        }
+        if (y >= bottom) {
+            const int steps = (2 * (y - bottom) + m_shift) / (2 * m_shift);
+            return lastLinePosition + qMin(steps, StaffPositionCount - 1 - lastLinePosition);
+        }
+
+        // Inside, guess the line above y from the staff height and correct
+        // the guess against the neighbouring lines.
+        int line = qBound(0, (y - top) * (m_lineCount - 1) / (bottom - top), m_lineCount - 2);
+        while (line > 0 && lineY(line, x) > y) {
+            --line;
+        }
+        while (line < m_lineCount - 2 && lineY(line + 1, x) <= y) {
+            ++line;
+        }
+
+        const int position = TopLinePosition + 2 * line;
+        const int candidateY[3] = { lineY(line, x), lineY(line, x) + m_shift, lineY(line + 1, x) };
+        int nearest = 0;
+        for (int i = 1; i < 3; ++i) {
+            if (qAbs(candidateY[i] - y) <= qAbs(candidateY[nearest] - y)) {
+                nearest = i;
+            }
+        }
+        return position + nearest;
+    }
+}
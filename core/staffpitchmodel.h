@@ -0,0 +1,53 @@
+#ifndef STAFFPITCHMODEL_H
+#define STAFFPITCHMODEL_H
+
+#include "notetables.h"
+#include "staff.h"
+#include "tools.h"
+
+#include <QPair>
+#include <QVector>
+
+namespace Munip
+{
+    /**
+     * Pitch of any point of a staff, worked out from the detected staff
+     * lines instead of a rendered image.
+     *
+     * For every column of the staff the y of each staff line is kept,
+     * following its segments. Lines, the spaces below them and the ledger
+     * positions above and below the staff are then computed from those,
+     * half a staff space plus half a line apart, as in
+     * StaffData::imageWithStaffLines(). The pitches come from the ladder
+     * of the clef, the top line of a treble staff being F5.
+     *
+     * Coordinates are relative to the top left of staff.boundingRect(),
+     * like those of the StaffData images.
+     */
+    class StaffPitchModel
+    {
+    public:
+        StaffPitchModel(const Staff& staff, const Range& staffSpaceHeight,
+                const Range& staffLineHeight, Clef clef = TrebleClef);
+
+        // Step and octave of the line or space nearest to (x, y). Columns
+        // outside the staff use the nearest one.
+        QPair<char, int> noteOctaveAt(int x, int y) const;
+
+        // The same as an index into StaffPositions, and its pitch.
+        int positionAt(int x, int y) const;
+        Pitch pitch(int position) const { return StaffPositions[m_clef][position]; }
+
+    private:
+        // y of line at column x.
+        int lineY(int line, int x) const { return m_lineY[x * m_lineCount + line]; }
+
+        Clef m_clef;
+        int m_width;
+        int m_lineCount;
+        int m_shift;
+        QVector<int> m_lineY;
+    };
+}
+
+#endif // STAFFPITCHMODEL_H
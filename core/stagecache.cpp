@@ -0,0 +1,305 @@
+#include "stagecache.h"
+
+#include "bitplane.h"
+#include "pagecontext.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QPair>
+#include <QThread>
+
+namespace Munip
+{
+    const int StageCache::CodeVersion = 1;
+
+    static const quint32 Magic = 0x4d534331; // "MSC1"
+    static const QDataStream::Version StreamVersion = QDataStream::Qt_4_6;
+
+    enum ImageKind { NullImage, MonoImage, OtherImage };
+
+    enum ContextField {
+        SkewField,
+        StaffSpaceHeightField,
+        StaffLineHeightField,
+        StaffListField,
+        RemovedStaffLinesImageField,
+        ContextFieldCount
+    };
+
+    static void writeImage(QDataStream& stream, const QImage& image)
+    {
+        if (image.isNull()) {
+            stream << quint8(NullImage);
+        } else if (image.format() == QImage::Format_Mono ||
+                image.format() == QImage::Format_MonoLSB) {
+            const BitPlane plane = BitPlane::fromImage(image);
+            stream << quint8(MonoImage) << qint32(plane.width()) << qint32(plane.height());
+            for (int y = 0; y < plane.height(); ++y) {
+                const BitPlane::Word *line = plane.scanLine(y);
+                for (int i = 0; i < plane.wordsPerLine(); ++i) {
+                    stream << quint64(line[i]);
+                }
+            }
+        } else {
+            stream << quint8(OtherImage) << image;
+        }
+    }
+
+    static QImage readImage(QDataStream& stream)
+    {
+        quint8 kind;
+        stream >> kind;
+        if (kind == MonoImage) {
+            qint32 width, height;
+            stream >> width >> height;
+            if (stream.status() != QDataStream::Ok || width < 0 || height < 0) {
+                return QImage();
+            }
+            BitPlane plane(width, height);
+            for (int y = 0; y < plane.height(); ++y) {
+                BitPlane::Word *line = plane.scanLine(y);
+                for (int i = 0; i < plane.wordsPerLine(); ++i) {
+                    quint64 word;
+                    stream >> word;
+                    line[i] = word;
+                }
+            }
+            plane.clearPadding();
+            return plane.toImage();
+        } else if (kind == OtherImage) {
+            QImage image;
+            stream >> image;
+            return image;
+        }
+        return QImage();
+    }
+
+    static QDataStream& operator<<(QDataStream& stream, const Range& range)
+    {
+        return stream << qint32(range.min) << qint32(range.max);
+    }
+
+    static QDataStream& operator>>(QDataStream& stream, Range& range)
+    {
+        qint32 min, max;
+        stream >> min >> max;
+        range = Range(min, max);
+        return stream;
+    }
+
+    StageCache::StageCache(const QString& directory) :
+        m_directory(directory)
+    {
+        QDir().mkpath(m_directory);
+    }
+
+    QByteArray StageCache::imageKey(const QImage& image)
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        QByteArray header;
+        {
+            QDataStream stream(&header, QIODevice::WriteOnly);
+            stream.setVersion(StreamVersion);
+            stream << QByteArray("image") << qint32(image.width()) << qint32(image.height())
+                << qint32(image.format()) << image.colorTable();
+        }
+        hash.addData(header);
+
+        // Only the bytes holding pixels, the rest of a line is padding.
+        const int bytes = (image.width() * image.depth() + 7) / 8;
+        for (int y = 0; y < image.height(); ++y) {
+            hash.addData(reinterpret_cast<const char*>(image.scanLine(y)), bytes);
+        }
+        return hash.result().toHex();
+    }
+
+    QByteArray StageCache::stageKey(const QByteArray& step, const QVariantMap& parameters,
+            const QList<QByteArray>& inputKeys)
+    {
+        QByteArray data;
+        {
+            QDataStream stream(&data, QIODevice::WriteOnly);
+            stream.setVersion(StreamVersion);
+            stream << QByteArray("stage") << qint32(CodeVersion) << step << parameters
+                << inputKeys;
+        }
+        return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+    }
+
+    QList<QByteArray> StageCache::contextState(const PageContext *context)
+    {
+        QList<QByteArray> retval;
+        for (int field = 0; field < ContextFieldCount; ++field) {
+            QByteArray data;
+            QDataStream stream(&data, QIODevice::WriteOnly);
+            stream.setVersion(StreamVersion);
+
+            switch (field) {
+            case SkewField:
+                stream << context->pageSkew() << context->pageSkewPrecison();
+                break;
+            case StaffSpaceHeightField:
+                stream << context->staffSpaceHeight();
+                break;
+            case StaffLineHeightField:
+                stream << context->staffLineHeight();
+                break;
+            case StaffListField: {
+                const QList<Staff> staffList = context->staffList();
+                stream << quint32(staffList.size());
+                foreach (const Staff& staff, staffList) {
+                    stream << staff;
+                }
+                break;
+            }
+            case RemovedStaffLinesImageField:
+                writeImage(stream, context->imageWithRemovedStaffLinesOnly());
+                break;
+            }
+            retval << data;
+        }
+        return retval;
+    }
+
+    static bool restoreContextField(PageContext *context, int field, const QByteArray& data)
+    {
+        QDataStream stream(data);
+        stream.setVersion(StreamVersion);
+
+        switch (field) {
+        case SkewField: {
+            float skew, precision;
+            stream >> skew >> precision;
+            context->setPageSkew(skew);
+            context->setPageSkewPrecision(precision);
+            break;
+        }
+        case StaffSpaceHeightField: {
+            Range range;
+            stream >> range;
+            context->setStaffSpaceHeight(range);
+            break;
+        }
+        case StaffLineHeightField: {
+            Range range;
+            stream >> range;
+            context->setStaffLineHeight(range);
+            break;
+        }
+        case StaffListField: {
+            quint32 count;
+            stream >> count;
+            context->clearStaff();
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+                Staff staff;
+                stream >> staff;
+                context->appendStaff(staff);
+            }
+            break;
+        }
+        case RemovedStaffLinesImageField:
+            context->imageRefWithRemovedStaffLinesOnly() = readImage(stream);
+            break;
+        default:
+            return false;
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    QString StageCache::fileName(const QByteArray& key) const
+    {
+        return QDir(m_directory).filePath(QString::fromLatin1(key) + ".stage");
+    }
+
+    bool StageCache::load(const QByteArray& key, QImage *image, PageContext *context) const
+    {
+        QFile file(fileName(key));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(StreamVersion);
+
+        quint32 magic, fieldMask;
+        qint32 version;
+        stream >> magic >> version;
+        if (magic != Magic || version != CodeVersion) {
+            return false;
+        }
+
+        const QImage cached = readImage(stream);
+        stream >> fieldMask;
+
+        QList<QPair<int, QByteArray> > fields;
+        for (int field = 0; field < ContextFieldCount; ++field) {
+            if (fieldMask & (1u << field)) {
+                QByteArray data;
+                stream >> data;
+                fields << qMakePair(field, data);
+            }
+        }
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+
+        // Only touch the context once the whole entry has been read.
+        for (int i = 0; i < fields.size(); ++i) {
+            if (!restoreContextField(context, fields[i].first, fields[i].second)) {
+                return false;
+            }
+        }
+        *image = cached;
+        return true;
+    }
+
+    bool StageCache::store(const QByteArray& key, const QImage& image,
+            const QList<QByteArray>& before, const QList<QByteArray>& after) const
+    {
+        // Written under a unique name and renamed, several pages may be
+        // storing the same entry at once.
+        const QString target = fileName(key);
+        const QString temporary = QString("%1.%2.%3.tmp").arg(target)
+            .arg(QCoreApplication::applicationPid())
+            .arg(quintptr(QThread::currentThreadId()));
+
+        QFile file(temporary);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(StreamVersion);
+        stream << Magic << qint32(CodeVersion);
+        writeImage(stream, image);
+
+        quint32 fieldMask = 0;
+        for (int field = 0; field < after.size(); ++field) {
+            if (field >= before.size() || before[field] != after[field]) {
+                fieldMask |= 1u << field;
+            }
+        }
+        stream << fieldMask;
+        for (int field = 0; field < after.size(); ++field) {
+            if (fieldMask & (1u << field)) {
+                stream << after[field];
+            }
+        }
+        file.close();
+
+        if (stream.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+            QFile::remove(temporary);
+            return false;
+        }
+
+        QFile::remove(target);
+        if (!QFile::rename(temporary, target)) {
+            QFile::remove(temporary);
+            return false;
+        }
+        return true;
+    }
+}
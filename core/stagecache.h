@@ -0,0 +1,60 @@
+#ifndef STAGECACHE_H
+#define STAGECACHE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <QVariant>
+
+namespace Munip
+{
+    class PageContext;
+
+    /**
+     * Content addressed on-disk cache of ProcessQueue stage results.
+     *
+     * The key of an image given to the queue hashes its pixels, the key
+     * of a stage hashes the step, its parameters, CodeVersion and the keys
+     * of everything the stage reads. A stage found in the cache does not
+     * run; its output image and the page context state it changed (skew,
+     * staff metrics, staff geometry, staff line removed image) are read
+     * back instead.
+     *
+     * Every entry is one file named after the hex key. Monochrome images
+     * are stored as packed bitplanes, other images in QDataStream format.
+     */
+    class StageCache
+    {
+    public:
+        // Bump whenever a change to a step alters its results for the
+        // same input, so older entries are no longer used.
+        static const int CodeVersion;
+
+        explicit StageCache(const QString& directory);
+
+        QString directory() const { return m_directory; }
+
+        static QByteArray imageKey(const QImage& image);
+        static QByteArray stageKey(const QByteArray& step, const QVariantMap& parameters,
+                const QList<QByteArray>& inputKeys);
+
+        // The cacheable page context state, one blob per field so that
+        // changes of a stage can be found by comparing before and after.
+        static QList<QByteArray> contextState(const PageContext *context);
+
+        // Returns false if there is no valid entry for key.
+        bool load(const QByteArray& key, QImage *image, PageContext *context) const;
+        // Stores image along with the fields of after that differ from
+        // before.
+        bool store(const QByteArray& key, const QImage& image,
+                const QList<QByteArray>& before, const QList<QByteArray>& after) const;
+
+    private:
+        QString fileName(const QByteArray& key) const;
+
+        QString m_directory;
+    };
+}
+
+#endif // STAGECACHE_H
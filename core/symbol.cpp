@@ -1,6 +1,11 @@
 #include "symbol.h"
 #include "datawarehouse.h"
+#include "eraselist.h"
+#include "midiwriter.h"
 #include "XmlConverter.h"
+#include "morphology.h"
+#include "notetables.h"
+#include "staffpitchmodel.h"
 
 #include <QColor>
 #include <QDebug>
@@ -18,6 +23,45 @@ namespace Munip
         return l->boundingRect.left() < r->boundingRect.left();
     }
 
+    /**
+     * State of the depth first searches which follow beams, flags and
+     * partial beams from a stem, run by run through a vertical runlength
+     * image. Runs are addressed by their dense id, and the column next to
+     * the stem where a search starts, which is not a run of the image, by
+     * StartId. The arrays are allocated once per image and reused for all
+     * stems.
+     */
+    struct RunSearch
+    {
+        enum { StartId = -1 };
+
+        explicit RunSearch(const RunlengthImage& image) :
+            runs(image),
+            previous(image.runCount(), int(StartId)),
+            visited(image.runCount(), false)
+        {
+            stack.reserve(image.runCount() + 1);
+        }
+
+        RunCoord coord(int id) const {
+            return id == StartId ? start : runs.runCoord(id);
+        }
+
+        // Runs from id back to, but not including, the start.
+        template <typename Container>
+        void appendPath(int id, Container& path) const {
+            for (; id != StartId; id = previous[id]) {
+                path << runs.runCoord(id);
+            }
+        }
+
+        const RunlengthImage& runs;
+        RunCoord start;
+        QVector<int> previous;
+        QVector<bool> visited;
+        QVector<int> stack;
+    };
+
     QDebug operator<<(QDebug dbg, const NoteSegment* seg)
     {
         dbg.nospace() << "NoteSegment: [" << (void*)seg << "] " << seg->boundingRect;
@@ -45,116 +89,43 @@ namespace Munip
         return qMakePair(note, octave);
     }
 
-    uint qHash(const QPair<char, int> &noteOctavePair)
-    {
-        return int(noteOctavePair.first) * 100 + (noteOctavePair.second);
-    }
-
-    static QString noteTypeFromDenominator(int denominator)
+    StaffParams StaffParams::fromPageContext(const PageContext *context)
     {
-        switch (denominator) {
-            case 1: return "whole";
-            case 2: return "half";
-            case 4: return "quarter";
-            case 8: return "eighth";
-            case 16: return "16th";
-            case 32: return "32th";
-            case 64: return "64th";
-        }
-        return QString();
+        StaffParams params;
+        params.staffSpaceHeight = context->staffSpaceHeight();
+        params.staffLineHeight = context->staffLineHeight();
+        params.imageWithRemovedStaffLinesOnly = context->imageWithRemovedStaffLinesOnly();
+        return params;
     }
 
-    QList<NoteInfo> NoteSegment::chordInfo(const QImage &lineImage) const
+    StaffParams StaffParams::fromDataWarehouse()
     {
-        const QRgb WhiteColor = QColor(Qt::white).rgb();
-        int denominator = 1;
-        if (isNoteHeadFilled) {
-            denominator <<= 2;
-            if (stemSegment) {
-                denominator <<= stemSegment->totalFlagCount();
-            }
-
-        } else {
-            if (stemSegment) {
-                denominator *= 2;
-            }
-        }
-
-        QList<NoteInfo> retval;
-
-        const QString type = noteTypeFromDenominator(denominator);
-
-        QHash<QPair<char, int>, int> frequencyTable;
-
-        foreach (const QRect &rect, noteRects) {
-            for (int x = rect.left(); x <= rect.right(); ++x) {
-                int startY = rect.center().y();
-
-                int aboveY = startY - 1;
-                int belowY = startY + 1;
-
-                while (aboveY >= 0 &&
-                        lineImage.pixel(x, aboveY) == WhiteColor) {
-                    --aboveY;
-                }
-
-                while (belowY < lineImage.height() &&
-                        lineImage.pixel(x, belowY) == WhiteColor) {
-                    ++belowY;
-                }
-
-                QPair<char, int> noteOctave;
-                if (qAbs(aboveY - startY) < qAbs(belowY - startY)) {
-                    noteOctave = colorToNoteOctave(QColor(lineImage.pixel(x, aboveY)));
-                } else {
-                    noteOctave = colorToNoteOctave(QColor(lineImage.pixel(x, belowY)));
-                }
-
-                frequencyTable[noteOctave]++;
-            }
-
-            // Now find the entry with max frequency.
-            QHash<QPair<char, int>, int>::iterator it = frequencyTable.begin();
-
-            int maxFreq = -1;
-            QPair<char, int> maxNoteOctaveValue;
-            while (it != frequencyTable.end()) {
-               if (it.value() > maxFreq) {
-                   maxFreq = it.value();
-                   maxNoteOctaveValue = it.key();
-                }
-                ++it;
-            }
-
-            Q_ASSERT(maxFreq != -1);
-
-            NoteInfo noteInfo;
-
-            noteInfo.octave = QString::number(maxNoteOctaveValue.second);
-            noteInfo.step.append(maxNoteOctaveValue.first);
-            noteInfo.type = type;
-
-            retval << noteInfo;
-        }
-
-
-        return retval;
+        return fromPageContext(DataWarehouse::instance());
     }
 
     StaffData::StaffData(const QImage& img, const Staff& stf) :
+        params(StaffParams::fromDataWarehouse()),
         staff(stf),
         image(img)
     {
         // SlidingWindowSize should atleast be 4 pixels wide,
         // else it results in lots of false positives.
-        SlidingWindowSize = qMax(4, DataWarehouse::instance()->staffLineHeight().max);
+        SlidingWindowSize = qMax(4, params.staffLineHeight.max);
+        workImage = staffImage();
+    }
+
+    StaffData::StaffData(const QImage& img, const Staff& stf, const StaffParams& prms) :
+        params(prms),
+        staff(stf),
+        image(img)
+    {
+        SlidingWindowSize = qMax(4, params.staffLineHeight.max);
         workImage = staffImage();
     }
 
     StaffData::~StaffData()
     {
-        qDeleteAll(noteSegments);
-        noteSegments.clear();
+        // The arena frees all symbol objects.
     }
 
     /**
@@ -193,6 +164,8 @@ namespace Munip
         extractHollowNoteStemSegments();
 
         extractHollowNotes();
+
+        buildSymbolGraph();
     }
 
     void StaffData::findSymbolRegions()
@@ -232,11 +205,14 @@ namespace Munip
         QRect r = workImage.rect();
         const QRgb BlackColor = QColor(Qt::black).rgb();
 
+        maxProjections = ProjectionProfile(r.left(), r.width());
+        QVector<int> projectionHelper;
+
         foreach (const QRect &sr, symbolRects) {
             if (sr.width() < SlidingWindowSize) continue;
 
             for (int x = sr.left(); x <= sr.right() - SlidingWindowSize; ++x) {
-                QList<int> projectionHelper;
+                projectionHelper.resize(0);
 
                 for (int y = sr.top(); y <= sr.bottom(); ++y) {
                     int count = 0;
@@ -255,13 +231,13 @@ namespace Munip
 
                 int peakHValue = determinePeakHValueFrom(projectionHelper);
                 for (int i = 0; i < SlidingWindowSize && (x+i) <= sr.right(); ++i) {
-                    maxProjections[x+i] = qMax(maxProjections[x+i], peakHValue);
+                    maxProjections.raiseTo(x+i, peakHValue);
                 }
             }
         }
     }
 
-    int StaffData::determinePeakHValueFrom(const QList<int>& horProjValues)
+    int StaffData::determinePeakHValueFrom(const QVector<int>& horProjValues)
     {
         const int peak = SlidingWindowSize - 1;
         int maxRun = 0;
@@ -282,95 +258,44 @@ namespace Munip
 
     void StaffData::extractNoteSegments()
     {
-        DataWarehouse *dw = DataWarehouse::instance();
-        int n1_2 = 2 * (dw->staffLineHeight().max);
+        int n1_2 = 2 * (params.staffLineHeight.max);
         noteProjections = filter(Range(1, 100),
-                Range(n1_2, n1_2 + dw->staffSpaceHeight().max),
+                Range(n1_2, n1_2 + params.staffSpaceHeight.max),
                 maxProjections);
 
         noteProjections = filter(Range(1, 100),
-                Range(n1_2 + dw->staffSpaceHeight().min - dw->staffLineHeight().min, 100),
+                Range(n1_2 + params.staffSpaceHeight.min - params.staffLineHeight.min, 100),
                 noteProjections);
 
         // temp is just for debugging purpose.
         temp = noteProjections;
 
         // Removal of false positives.
-        QList<int> keys = noteProjections.keys();
-        qSort(keys);
-
-
         // Fill up very thin gaps. (aka the bald note head region ;) )
-        const int ThinGapLimit = (dw->staffLineHeight().min >> 1);
-
-        for (int i = keys.first(); i <= keys.last(); ++i) {
-            if (noteProjections.value(i, 0) > 0) continue;
-
-            int runlength = 0;
-            for (; (i + runlength) <= keys.last(); ++runlength) {
-                if (noteProjections.value(i+runlength, 0) > 0) break;
-            }
-
-            if (runlength <= ThinGapLimit) {
-                // valueToInsert will be min of the values surrounding '0' run.
-                int valueToInsert = qMin(noteProjections.value(i-1, 0),
-                        noteProjections.value(i+runlength, 0));
-                for (int j = i; j < (i+runlength); ++j) {
-                    noteProjections[j] = valueToInsert;
-                }
-            }
-
-            i += runlength - 1;
-        }
-
-        // Update the keys variable as we inserted few in above loop.
-        keys = noteProjections.keys();
-        qSort(keys);
+        const int ThinGapLimit = (params.staffLineHeight.min >> 1);
+        noteProjections.fillGaps(ThinGapLimit);
 
         // Remove peak region which are very thin or very thick.
         // IMPT: 80% the staffSpaceHeight min is really good choice since the regions are now thick,
         // thanks to filter method cutting the taller ones to the limit rather than previous value.
-        const int ThinRegionLimit = int(qRound(.8 * dw->staffSpaceHeight().min));
-        const int ThickRegionLimit = dw->staffSpaceHeight().max << 1;
-
-        for (int i = keys.first(); i <= keys.last(); ++i) {
-            if (noteProjections.value(i, 0) == 0) continue;
-
-            int runlength = 0;
-            for (; (i+runlength) <= keys.last(); ++runlength) {
-                if (noteProjections.value(i+runlength, 0) == 0) break;
-            }
+        const int ThinRegionLimit = int(qRound(.8 * params.staffSpaceHeight.min));
+        const int ThickRegionLimit = params.staffSpaceHeight.max << 1;
 
-            if (runlength <= ThinRegionLimit || runlength >= ThickRegionLimit) {
-                for (int j = i; j < (i+runlength); ++j) {
-                    noteProjections[j] = 0;
-                }
+        foreach (const Run& run, noteProjections.runs()) {
+            if (run.length <= ThinRegionLimit || run.length >= ThickRegionLimit) {
+                noteProjections.fill(run, 0);
             }
-
-            i += runlength - 1;
         }
 
-        // Update the keys as we added some new keys
-        keys = noteProjections.keys();
-        qSort(keys);
-
         // Now fill up noteSegments list (datastructure construction)
         const QRect r = workImage.rect();
         const int top = r.top();
         const int height = r.height();
-        const int noteWidth = 2 * DataWarehouse::instance()->staffSpaceHeight().min;
-
-        for (int i = keys.first(); i <= keys.last(); ++i) {
-            if (noteProjections.value(i, 0) == 0) continue;
+        const int noteWidth = 2 * params.staffSpaceHeight.min;
 
-            int runlength = 0;
-            for (; (i+runlength) <= keys.last(); ++runlength) {
-                if (noteProjections.value(i+runlength, 0) == 0) break;
-            }
-
-
-            int xCenter = i + (runlength >> 1);
-            NoteSegment *n = NoteSegment::create();
+        foreach (const Run& run, noteProjections.runs()) {
+            int xCenter = run.pos + (run.length >> 1);
+            NoteSegment *n = NoteSegment::create(arena);
             n->isNoteHeadFilled = true;
             // n->boundingRect = QRect(xCenter - noteWidth, top, noteWidth * 2, height);
             n->boundingRect = QRect(xCenter - (noteWidth >> 1), top, noteWidth, height);
@@ -378,8 +303,6 @@ namespace Munip
             //n->boundingRect = QRect(key, top, runlength, height);
 
             noteSegments << n;
-
-            i += runlength - 1;
         }
 
         qSort(noteSegments.begin(), noteSegments.end(),
@@ -394,35 +317,17 @@ namespace Munip
 #endif
     }
 
-    QHash<int, int> StaffData::filter(Range , Range height,
-            const QHash<int, int> &hash)
+    ProjectionProfile StaffData::filter(Range , Range height,
+            const ProjectionProfile &profile)
     {
-        QList<int> allKeys = hash.keys();
-        qSort(allKeys);
-
-        QHash<int, int> retval;
-
-        for (int i = 0; i < allKeys.size(); ++i) {
-            if (hash[allKeys[i]] < height.min) continue;
-            if (hash[allKeys[i]] > height.max) {
-                // Setting it height.max destroyes the curve, but emboldens the note head region in
-                // a better fashion.
-                retval[allKeys[i]] = height.max;
-                //retval[allKeys[i]-1];
-            } else {
-                retval[allKeys[i]] = hash[allKeys[i]];
-            }
-        }
-
-        return retval;
+        return profile.filtered(height);
     }
 
     void StaffData::extractStemSegments()
     {
         const QRgb BlackColor = QColor(Qt::black).rgb();
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int lineHeight = dw->staffLineHeight().min * 2;
+        const int lineHeight = params.staffLineHeight.min * 2;
 
         foreach (NoteSegment* seg, noteSegments) {
             QRect rect = seg->boundingRect;
@@ -481,28 +386,29 @@ namespace Munip
                 }
             }
 
-            StemSegment *stemSeg = StemSegment::create();
+            StemSegment *stemSeg = StemSegment::create(arena);
             stemSeg->boundingRect = stemRect;
             stemSeg->noteSegment = seg;
             seg->stemSegment = stemSeg;
         }
+
+        // Beams end a little left of, above or below the stem they reach.
+        stemIndex.build(noteSegments, QMargins(2, 1, 0, 2));
     }
 
     void StaffData::eraseStems()
     {
-        QPainter p(&workImage);
-        p.setBrush(QColor(Qt::white));
-        p.setPen(Qt::NoPen);
+        EraseList erase;
 
         // Erase all stems first
         foreach (NoteSegment *noteSegment, noteSegments) {
             StemSegment *stemSegment = noteSegment->stemSegment;
             if (!stemSegment) continue;
 
-            p.drawRect(stemSegment->boundingRect.adjusted(-1, 0, +1, 0));
+            erase.addRect(stemSegment->boundingRect.adjusted(-1, 0, +1, 0));
         }
 
-        p.end();
+        erase.apply(workImage);
     }
 
     void StaffData::extractBeams()
@@ -510,39 +416,41 @@ namespace Munip
         beamsRunCoords.clear();
         VerticalRunlengthImage vRunImage(workImage);
 
-        QSet<RunCoord> visited;
-        QHash<RunCoord, RunCoord> prevCoord;
+        // Runs stay visited across stems, so that a beam is only found
+        // from its left stem.
+        RunSearch search(vRunImage);
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int MinimumBeamRunlengthLimit = dw->staffLineHeight().min << 1;
+        const int MinimumBeamRunlengthLimit = params.staffLineHeight.min << 1;
 
         foreach (NoteSegment *noteSegment, noteSegments) {
             StemSegment *stemSegment = noteSegment->stemSegment;
             if (!stemSegment) continue;
 
             const QRect rect = stemSegment->boundingRect;
-            const RunCoord stemRunCoord(rect.right() + 1, Run(rect.top(), rect.height()));
+            search.start = RunCoord(rect.right() + 1, Run(rect.top(), rect.height()));
+            if (!search.start.isValid()) continue;
 
-            QStack<RunCoord> stack; // For DFS
-            stack.push(stemRunCoord);
+            search.stack.resize(0); // For DFS
+            search.stack.append(RunSearch::StartId);
 
-            while (!stack.isEmpty()) {
-                RunCoord runCoord = stack.pop();
-                visited << runCoord;
-
-                if (!runCoord.isValid()) continue;
+            while (!search.stack.isEmpty()) {
+                const int id = search.stack.last();
+                search.stack.pop_back();
+                if (id != RunSearch::StartId) {
+                    search.visited[id] = true;
+                }
 
-                QList<Run> adjRuns = vRunImage.adjacentRunsInNextColumn(runCoord);
+                const RunCoord runCoord = search.coord(id);
+                int first, last;
+                vRunImage.adjacentRunIds(runCoord.pos + 1, runCoord.run, &first, &last);
 
                 bool pushed = false;
-                foreach (const Run& adjRun, adjRuns) {
-                    RunCoord adjRunCoord(runCoord.pos + 1, adjRun);
-                    if (adjRunCoord.isValid() &&
-                            adjRunCoord.run.length >= MinimumBeamRunlengthLimit &&
-                            !visited.contains(adjRunCoord))
+                for (int adjId = first; adjId < last; ++adjId) {
+                    if (!search.visited[adjId] &&
+                            vRunImage.runCoord(adjId).run.length >= MinimumBeamRunlengthLimit)
                     {
-                        prevCoord[adjRunCoord] = runCoord;
-                        stack.push(adjRunCoord);
+                        search.previous[adjId] = id;
+                        search.stack.append(adjId);
                         pushed = true;
                     }
                 }
@@ -555,18 +463,7 @@ namespace Munip
                         right->leftFlagCount += 1;
                         stemSegment->rightFlagCount += 1;
 
-                        RunCoord cur = runCoord;
-                        // This loop takes care not to push stemRunCoord as that
-                        // is the artifact we created for convenience.
-                        while (1) {
-                            RunCoord prev = prevCoord.value(cur, RunCoord());
-                            if (!prev.isValid()) break;
-
-                            beamCoords << cur;
-
-                            cur = prev;
-                        }
-
+                        search.appendPath(id, beamCoords);
                         beamsRunCoords << beamCoords;
                     }
                 }
@@ -577,45 +474,85 @@ namespace Munip
     StemSegment* StaffData::stemSegmentForRunCoord(const RunCoord& runCoord)
     {
         const QRect runRect(runCoord.pos, runCoord.run.pos, 1, runCoord.run.length);
+        return stemIndex.stemAt(runRect);
+    }
+
+    void StemIndex::build(const QList<NoteSegment*>& noteSegments, const QMargins& margins)
+    {
+        clear();
+        m_entries.reserve(noteSegments.size());
         foreach (NoteSegment *noteSegment, noteSegments) {
             StemSegment *stemSegment = noteSegment->stemSegment;
             if (!stemSegment) continue;
 
-            QRect rect = stemSegment->boundingRect;
-            rect.setLeft(rect.left() - 2);
-            rect.setTop(rect.top() - 1);
-            rect.setBottom(rect.bottom() + 2);
-            if (rect.intersects(runRect)) {
-                return stemSegment;
+            Entry entry;
+            entry.rect = stemSegment->boundingRect.adjusted(-margins.left(), -margins.top(),
+                    margins.right(), margins.bottom());
+            entry.order = m_entries.size();
+            entry.stem = stemSegment;
+            m_entries << entry;
+        }
+        qStableSort(m_entries.begin(), m_entries.end());
+
+        m_maxRight.resize(m_entries.size());
+        for (int i = 0; i < m_entries.size(); ++i) {
+            m_maxRight[i] = m_entries[i].rect.right();
+            if (i > 0) {
+                m_maxRight[i] = qMax(m_maxRight[i], m_maxRight[i - 1]);
             }
         }
-        return 0;
     }
 
-    void StaffData::eraseBeams()
+    void StemIndex::clear()
     {
-        QPainter p(&workImage);
+        m_entries.clear();
+        m_maxRight.clear();
+    }
+
+    StemSegment* StemIndex::stemAt(const QRect& rect) const
+    {
+        // Entries starting right of rect can not intersect it.
+        int l = 0, h = m_entries.size();
+        while (l < h) {
+            const int mid = (l + h) / 2;
+            if (m_entries[mid].rect.left() <= rect.right()) {
+                l = mid + 1;
+            } else {
+                h = mid;
+            }
+        }
 
-        p.setBrush(Qt::NoBrush);
-        p.setPen(QColor(Qt::white));
+        // Walk left while some entry may still reach rect.
+        const Entry *found = 0;
+        for (int i = l - 1; i >= 0 && m_maxRight[i] >= rect.left(); --i) {
+            const Entry& entry = m_entries[i];
+            if (entry.rect.intersects(rect) && (!found || entry.order < found->order)) {
+                found = &entry;
+            }
+        }
+        return found ? found->stem : 0;
+    }
+
+    void StaffData::eraseBeams()
+    {
+        EraseList erase;
 
         foreach (const QList<RunCoord>& oneBeamCoords, beamsRunCoords) {
             foreach (const RunCoord& runCoord, oneBeamCoords) {
-                p.drawLine(runCoord.pos, runCoord.run.pos,
-                        runCoord.pos, runCoord.run.endPos());
+                erase.addVerticalRun(runCoord);
             }
         }
-        p.end();
+
+        erase.apply(workImage);
     }
 
     void StaffData::extractNotes()
     {
         const QRgb BlackColor = QColor(Qt::black).rgb();
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int extensionLimit = dw->staffSpaceHeight().min;
-        const int NoteWidthLimit = dw->staffSpaceHeight().min;
-        const int NoteHeightLimit = dw->staffSpaceHeight().min;// - dw->staffLineHeight().min;
+        const int extensionLimit = params.staffSpaceHeight.min;
+        const int NoteWidthLimit = params.staffSpaceHeight.min;
+        const int NoteHeightLimit = params.staffSpaceHeight.min;// - params.staffLineHeight.min;
 
         foreach (NoteSegment *seg, noteSegments) {
             if (!seg->stemSegment) continue;
@@ -637,46 +574,29 @@ namespace Munip
                 areaToProject.setRight(stemRect.left() - 1);
             }
 
-            QHash<int, int> projHelper;
+            ProjectionProfile projHelper(areaToProject.top(), areaToProject.height());
             for (int y = areaToProject.top(); y <= areaToProject.bottom(); ++y) {
                 int count = 0;
                 for (int x = areaToProject.left(); x <= areaToProject.right(); ++x) {
                     count += (workImage.pixel(x, y) == BlackColor);
                 }
 
-                projHelper.insert(y, count >= NoteWidthLimit ? count : 0);
+                projHelper.setValue(y, count >= NoteWidthLimit ? count : 0);
             }
 
             // Now filter based on Height of H projection
-            QList<int> keys = projHelper.keys();
-            qSort(keys);
-
-            for (int i = keys.first(); i <= keys.last(); ++i) {
-                if (projHelper.value(i, 0) == 0) continue;
-
-                int runlength = 0;
-                for (; (i + runlength) <= keys.last(); ++runlength) {
-                    if (projHelper.value(i + runlength, 0) == 0) {
-                        break;
-                    }
-                }
-
+            foreach (const Run& run, projHelper.runs()) {
                 // Nullify if not notehead
-                if (runlength < NoteHeightLimit) {
-                    for (int j = 0; j < runlength; ++j) {
-                        projHelper[i + j] = 0;
-                    }
-
+                if (run.length < NoteHeightLimit) {
+                    projHelper.fill(run, 0);
                 } else {
-                    int midY = i + (runlength >> 1);
+                    int midY = run.pos + (run.length >> 1);
                     QRect rect(areaToProject.left(), midY - NoteHeightLimit, areaToProject.width(),
                             NoteHeightLimit * 2);
                     //QRect rect(areaToProject.left(), midY - NoteHeightLimit, areaToProject.width(),
                     //        NoteHeightLimit * 2);
                     seg->noteRects << rect;
                 }
-
-                i += runlength - 1;
             }
 
             seg->horizontalProjection = projHelper;
@@ -686,75 +606,71 @@ namespace Munip
 
     void StaffData::eraseNotes()
     {
-        QPainter p(&workImage);
-        p.setBrush(QBrush(QColor(Qt::white)));
-        p.setPen(Qt::NoPen);
+        EraseList erase;
 
         foreach (const NoteSegment* nSeg, noteSegments) {
             foreach (const QRect &noteRect, nSeg->noteRects) {
-                p.drawRect(noteRect);
+                erase.addRect(noteRect);
             }
         }
+
+        erase.apply(workImage);
     }
 
     void StaffData::extractFlags()
     {
         VerticalRunlengthImage vRunImage(workImage);
 
-        QHash<RunCoord, RunCoord> prevCoord;
+        RunSearch search(vRunImage);
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int MinimumFlagRunlengthLimit = dw->staffLineHeight().min << 1;
-        const int FlagDistanceLimit = int(qRound(.8 * dw->staffSpaceHeight().max));
+        const int MinimumFlagRunlengthLimit = params.staffLineHeight.min << 1;
+        const int FlagDistanceLimit = int(qRound(.8 * params.staffSpaceHeight.max));
 
         foreach (NoteSegment *noteSegment, noteSegments) {
             StemSegment *stemSegment = noteSegment->stemSegment;
             if (!stemSegment) continue;
 
             const QRect rect = stemSegment->boundingRect;
-            const RunCoord stemRunCoord(rect.right() + 1, Run(rect.top(), rect.height()));
+            search.start = RunCoord(rect.right() + 1, Run(rect.top(), rect.height()));
+            if (!search.start.isValid()) continue;
 
             QRect flagBoundRect;
 
-            QStack<RunCoord> stack; // For DFS
-            stack.push(stemRunCoord);
-
-            while (!stack.isEmpty()) {
-                RunCoord runCoord = stack.pop();
+            search.stack.resize(0); // For DFS
+            search.stack.append(RunSearch::StartId);
 
-                if (!runCoord.isValid()) continue;
+            while (!search.stack.isEmpty()) {
+                const int id = search.stack.last();
+                search.stack.pop_back();
 
-                QList<Run> adjRuns = vRunImage.adjacentRunsInNextColumn(runCoord);
+                const RunCoord runCoord = search.coord(id);
+                int first, last;
+                vRunImage.adjacentRunIds(runCoord.pos + 1, runCoord.run, &first, &last);
 
                 bool pushed = false;
-                foreach (const Run& adjRun, adjRuns) {
-                    RunCoord adjRunCoord(runCoord.pos + 1, adjRun);
-                    if (adjRunCoord.isValid() &&
-                            adjRunCoord.run.length >= MinimumFlagRunlengthLimit)
-                    {
-                        prevCoord[adjRunCoord] = runCoord;
-                        stack.push(adjRunCoord);
+                for (int adjId = first; adjId < last; ++adjId) {
+                    if (vRunImage.runCoord(adjId).run.length >= MinimumFlagRunlengthLimit) {
+                        search.previous[adjId] = id;
+                        search.stack.append(adjId);
                         pushed = true;
                     }
                 }
 
                 if (!pushed) {
-                    if ((runCoord.pos - stemRunCoord.pos) >= FlagDistanceLimit) {
-                        // This loop takes care not to push stemRunCoord as that
-                        // is the artifact we created for convenience.
-                        RunCoord cur = runCoord;
-                        while (1) {
-                            const RunCoord prev = prevCoord.value(cur, RunCoord());
-                            if (!prev.isValid()) break;
-
-                            stemSegment->flagRunCoords << cur;
+                    if ((runCoord.pos - search.start.pos) >= FlagDistanceLimit) {
+                        // The start itself is not part of the flag, but
+                        // bounds it on the left.
+                        for (int cur = id; cur != RunSearch::StartId; ) {
+                            stemSegment->flagRunCoords << vRunImage.runCoord(cur);
+                            cur = search.previous[cur];
+
+                            const RunCoord prev = search.coord(cur);
                             const QRect curRect(prev.pos, prev.run.pos, 1, prev.run.length);
                             if (flagBoundRect.isNull()) {
                                 flagBoundRect = curRect;
                             } else {
                                 flagBoundRect |= curRect;
                             }
-                            cur = prev;
                         }
                     }
                 }
@@ -800,72 +716,60 @@ namespace Munip
 
     void StaffData::eraseFlags()
     {
-        QPainter p(&workImage);
-
-        p.setPen(QColor(Qt::white));
-        p.setBrush(Qt::NoBrush);
+        EraseList erase;
 
         foreach (NoteSegment *noteSegment, noteSegments) {
             StemSegment *stemSegment = noteSegment->stemSegment;
             if (!stemSegment) continue;
 
             foreach (const RunCoord &runCoord, stemSegment->flagRunCoords) {
-                p.drawLine(runCoord.pos, runCoord.run.pos, runCoord.pos, runCoord.run.endPos());
+                erase.addVerticalRun(runCoord);
             }
         }
+
+        erase.apply(workImage);
     }
 
     void StaffData::extractPartialBeams()
     {
         VerticalRunlengthImage vRunImage(workImage);
 
-        QHash<RunCoord, RunCoord> prevCoord;
+        RunSearch search(vRunImage);
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int MinimumPartialBeamRunlengthLimit = dw->staffLineHeight().min << 1;
-        const int PartialBeamDistanceLimit = int(qRound(.33 * dw->staffSpaceHeight().max));
+        const int MinimumPartialBeamRunlengthLimit = params.staffLineHeight.min << 1;
+        const int PartialBeamDistanceLimit = int(qRound(.33 * params.staffSpaceHeight.max));
 
         foreach (NoteSegment *noteSegment, noteSegments) {
             StemSegment *stemSegment = noteSegment->stemSegment;
             if (!stemSegment) continue;
 
             const QRect rect = stemSegment->boundingRect;
-            const RunCoord stemRunCoord(rect.right() + 1, Run(rect.top(), rect.height()));
+            search.start = RunCoord(rect.right() + 1, Run(rect.top(), rect.height()));
+            if (!search.start.isValid()) continue;
 
-            QStack<RunCoord> stack; // For DFS
-            stack.push(stemRunCoord);
+            search.stack.resize(0); // For DFS
+            search.stack.append(RunSearch::StartId);
 
-            while (!stack.isEmpty()) {
-                const RunCoord runCoord = stack.pop();
+            while (!search.stack.isEmpty()) {
+                const int id = search.stack.last();
+                search.stack.pop_back();
 
-                if (!runCoord.isValid()) continue;
-
-                QList<Run> adjRuns = vRunImage.adjacentRunsInNextColumn(runCoord);
+                const RunCoord runCoord = search.coord(id);
+                int first, last;
+                vRunImage.adjacentRunIds(runCoord.pos + 1, runCoord.run, &first, &last);
 
                 bool pushed = false;
-                foreach (const Run& adjRun, adjRuns) {
-                    RunCoord adjRunCoord(runCoord.pos + 1, adjRun);
-                    if (adjRunCoord.isValid() &&
-                            adjRunCoord.run.length >= MinimumPartialBeamRunlengthLimit)
-                    {
-                        prevCoord[adjRunCoord] = runCoord;
-                        stack.push(adjRunCoord);
+                for (int adjId = first; adjId < last; ++adjId) {
+                    if (vRunImage.runCoord(adjId).run.length >= MinimumPartialBeamRunlengthLimit) {
+                        search.previous[adjId] = id;
+                        search.stack.append(adjId);
                         pushed = true;
                     }
                 }
 
                 if (!pushed) {
-                    if ((runCoord.pos - stemRunCoord.pos) >= PartialBeamDistanceLimit) {
-                        // This loop takes care not to push stemRunCoord as that
-                        // is the artifact we created for convenience.
-                        RunCoord cur = runCoord;
-                        while (1) {
-                            const RunCoord prev = prevCoord.value(cur, RunCoord());
-                            if (!prev.isValid()) break;
-
-                            stemSegment->partialBeamRunCoords << cur;
-                            cur = prev;
-                        }
+                    if ((runCoord.pos - search.start.pos) >= PartialBeamDistanceLimit) {
+                        search.appendPath(id, stemSegment->partialBeamRunCoords);
                         stemSegment->rightFlagCount++;
                     }
                 }
@@ -878,42 +782,32 @@ namespace Munip
             if (!stemSegment) continue;
 
             const QRect rect = stemSegment->boundingRect;
-            const RunCoord stemRunCoord(rect.left() - 1, Run(rect.top(), rect.height()));
-
-            QStack<RunCoord> stack; // For DFS
-            stack.push(stemRunCoord);
+            search.start = RunCoord(rect.left() - 1, Run(rect.top(), rect.height()));
+            if (!search.start.isValid()) continue;
 
-            while (!stack.isEmpty()) {
-                const RunCoord runCoord = stack.pop();
+            search.stack.resize(0); // For DFS
+            search.stack.append(RunSearch::StartId);
 
-                if (!runCoord.isValid()) continue;
+            while (!search.stack.isEmpty()) {
+                const int id = search.stack.last();
+                search.stack.pop_back();
 
-                QList<Run> adjRuns = vRunImage.adjacentRunsInPreviousColumn(runCoord);
+                const RunCoord runCoord = search.coord(id);
+                int first, last;
+                vRunImage.adjacentRunIds(runCoord.pos - 1, runCoord.run, &first, &last);
 
                 bool pushed = false;
-                foreach (const Run& adjRun, adjRuns) {
-                    RunCoord adjRunCoord(runCoord.pos - 1, adjRun);
-                    if (adjRunCoord.isValid() &&
-                            adjRunCoord.run.length >= MinimumPartialBeamRunlengthLimit)
-                    {
-                        prevCoord[adjRunCoord] = runCoord;
-                        stack.push(adjRunCoord);
+                for (int adjId = first; adjId < last; ++adjId) {
+                    if (vRunImage.runCoord(adjId).run.length >= MinimumPartialBeamRunlengthLimit) {
+                        search.previous[adjId] = id;
+                        search.stack.append(adjId);
                         pushed = true;
                     }
                 }
 
                 if (!pushed) {
-                    if (qAbs(runCoord.pos - stemRunCoord.pos) >= PartialBeamDistanceLimit) {
-                        // This loop takes care not to push stemRunCoord as that
-                        // is the artifact we created for convenience.
-                        RunCoord cur = runCoord;
-                        while (1) {
-                            const RunCoord prev = prevCoord.value(cur, RunCoord());
-                            if (!prev.isValid()) break;
-
-                            stemSegment->partialBeamRunCoords << cur;
-                            cur = prev;
-                        }
+                    if (qAbs(runCoord.pos - search.start.pos) >= PartialBeamDistanceLimit) {
+                        search.appendPath(id, stemSegment->partialBeamRunCoords);
                         stemSegment->leftFlagCount++;
                     }
                 }
@@ -924,26 +818,23 @@ namespace Munip
 
     void StaffData::erasePartialBeams()
     {
-        QPainter p(&workImage);
-
-        p.setPen(QColor(Qt::white));
-        p.setBrush(Qt::NoBrush);
+        EraseList erase;
 
         foreach (NoteSegment *noteSegment, noteSegments) {
             StemSegment *stemSegment = noteSegment->stemSegment;
             if (!stemSegment) continue;
 
             foreach (const RunCoord &runCoord, stemSegment->partialBeamRunCoords) {
-                p.drawLine(runCoord.pos, runCoord.run.pos, runCoord.pos, runCoord.run.endPos());
+                erase.addVerticalRun(runCoord);
             }
         }
+
+        erase.apply(workImage);
     }
 
     void StaffData::enhanceConnectivity()
     {
         // First fix 2 pixel disconnectivity
-        const QRgb BlackColor = QColor(Qt::black).rgb();
-
         const QPoint connectorMatrix[4][4] =
         {
             { QPoint(0, 0), QPoint(1, 1), QPoint(1, 2), QPoint(1, 2) },
@@ -951,42 +842,49 @@ namespace Munip
             { QPoint(1, 1), QPoint(1, 1), QPoint(2, 2), QPoint(2, 3) },
             { QPoint(2, 1), QPoint(2, 1), QPoint(2, 2), QPoint(3, 3) }
         };
-        QImage a(workImage.size(), QImage::Format_ARGB32_Premultiplied);
-        a.fill(0xffffffff);
-
-        for (int x = 0; x < workImage.width() - 4; ++x) {
-            for (int y = 0; y < workImage.height() - 4; ++y) {
-
-                for (int i = 0; i < 3; ++i) {
-                    for (int j = 0; j < 3; ++j) {
-                        if (workImage.pixel(x, y + i) == BlackColor &&
-                                workImage.pixel(x + 3, y + j) == BlackColor) {
-                            a.setPixel(x + 1, y + connectorMatrix[i][j].x(), BlackColor);
-                            a.setPixel(x + 2, y + connectorMatrix[i][j].y(), BlackColor);
-                        }
-                    }
-                }
+
+        const BitPlane work = BitPlane::fromImage(workImage);
+        BitPlane a(work.size());
+
+        // Only gaps starting in this region are bridged.
+        BitPlane scanRegion(work.size());
+        scanRegion.fillRect(QRect(0, 0, work.width() - 4, work.height() - 4), true);
+
+        // Horizontal gaps: (x, y+i) and (x+3, y+j) black.
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                StructuringElement ends;
+                ends.add(0, i);
+                ends.add(3, j);
+                BitPlane matches = erode(work, ends);
+                matches &= scanRegion;
+
+                StructuringElement connector;
+                connector.add(1, connectorMatrix[i][j].x());
+                connector.add(2, connectorMatrix[i][j].y());
+                a |= dilate(matches, connector);
             }
         }
-        for (int x = 0; x < workImage.width() - 4; ++x) {
-            for (int y = 0; y < workImage.height() - 4; ++y) {
-
-                for (int i = 0; i < 3; ++i) {
-                    for (int j = 0; j < 3; ++j) {
-                        if (workImage.pixel(x + i, y) == BlackColor &&
-                                workImage.pixel(x + i, y + 3) == BlackColor) {
-                            a.setPixel(x + connectorMatrix[i][j].x(), y + 1, BlackColor);
-                            a.setPixel(x + connectorMatrix[i][j].y(), y + 2, BlackColor);
-                        }
-                    }
-                }
+
+        // Vertical gaps: (x+i, y) and (x+i, y+3) black.
+        for (int i = 0; i < 3; ++i) {
+            StructuringElement ends;
+            ends.add(i, 0);
+            ends.add(i, 3);
+            BitPlane matches = erode(work, ends);
+            matches &= scanRegion;
+
+            StructuringElement connector;
+            for (int j = 0; j < 3; ++j) {
+                connector.add(connectorMatrix[i][j].x(), 1);
+                connector.add(connectorMatrix[i][j].y(), 2);
             }
+            a |= dilate(matches, connector);
         }
-        QPainter p(&workImage);
-        p.setCompositionMode(QPainter::CompositionMode_Multiply);
-        p.drawImage(QPoint(0, 0), staffImageWithRemovedStaffLinesOnly());
-        p.drawImage(QPoint(0, 0), a);
-        p.end();
+
+        a |= work;
+        a |= BitPlane::fromImage(staffImageWithRemovedStaffLinesOnly());
+        workImage = a.toArgbImage();
     }
 
     void StaffData::extractRegions()
@@ -1018,7 +916,7 @@ namespace Munip
 
                 if (visitedArray[y * w + x]) continue;
 
-                Region *region = new Region;
+                Region *region = arena.createRegion();
                 region->id = id;
                 regions << region;
 
@@ -1058,8 +956,7 @@ namespace Munip
             }
         }
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int MaxRadiusLimit = int(0.5 * dw->staffSpaceHeight().min);
+        const int MaxRadiusLimit = int(0.5 * params.staffSpaceHeight.min);
         const int MinArea = 1;
         const int MaxArea = M_PI * MaxRadiusLimit * MaxRadiusLimit;
 
@@ -1122,9 +1019,12 @@ namespace Munip
             }
         }
 
+        hollowNoteMaxProjections = ProjectionProfile(r.left(), r.width());
+        QVector<int> projectionHelper;
+
         foreach (const QRect& sr, rectsToProcess) {
             for (int x = sr.left(); x <= sr.right() - SlidingWindowSize; ++x) {
-                QList<int> projectionHelper;
+                projectionHelper.resize(0);
 
                 for (int y = sr.top(); y <= sr.bottom(); ++y) {
                     int count = 0;
@@ -1143,7 +1043,7 @@ namespace Munip
 
                 int peakHValue = determinePeakHValueFrom(projectionHelper);
                 for (int i = 0; i < SlidingWindowSize && (x+i) <= sr.right(); ++i) {
-                    hollowNoteMaxProjections[x+i] = qMax(hollowNoteMaxProjections[x+i], peakHValue);
+                    hollowNoteMaxProjections.raiseTo(x+i, peakHValue);
                 }
             }
         }
@@ -1151,110 +1051,50 @@ namespace Munip
 
     void StaffData::extractHollowNoteSegments()
     {
-        DataWarehouse *dw = DataWarehouse::instance();
-        int n1_2 = 2 * (dw->staffLineHeight().max);
+        int n1_2 = 2 * (params.staffLineHeight.max);
         hollowNoteProjections = filter(Range(1, 100),
-                Range(n1_2, n1_2 + dw->staffSpaceHeight().max),
+                Range(n1_2, n1_2 + params.staffSpaceHeight.max),
                 hollowNoteMaxProjections);
 
         hollowNoteProjections = filter(Range(1, 100),
-                Range(n1_2 + dw->staffSpaceHeight().min - dw->staffLineHeight().min - 1, 100),
+                Range(n1_2 + params.staffSpaceHeight.min - params.staffLineHeight.min - 1, 100),
                 hollowNoteProjections);
 
         // temp is just for debugging purpose.
         temp = hollowNoteProjections;
 
-
         // Removal of false positives.
-        QList<int> keys = hollowNoteProjections.keys();
-        qSort(keys);
-
         // Fill up very thin gaps. (aka the bald note head region ;) )
-        const int ThinGapLimit = (dw->staffLineHeight().min >> 1);
-
-        int start = (keys.isEmpty() ? -1 : keys.first());
-        int end = (keys.isEmpty() ? -2 : keys.last());
-
-        for (int i = start; i <= end; ++i) {
-            if (hollowNoteProjections.value(i, 0) > 0) continue;
-
-            int runlength = 0;
-            for (; (i + runlength) <= keys.last(); ++runlength) {
-                if (hollowNoteProjections.value(i+runlength, 0) > 0) break;
-            }
-
-            if (runlength <= ThinGapLimit) {
-                // valueToInsert will be min of the values surrounding '0' run.
-                int valueToInsert = qMin(hollowNoteProjections.value(i-1, 0),
-                        hollowNoteProjections.value(i+runlength, 0));
-                for (int j = i; j < (i+runlength); ++j) {
-                    hollowNoteProjections[j] = valueToInsert;
-                }
-            }
-
-            i += runlength - 1;
-        }
-
-        // Update the keys variable as we inserted few in above loop.
-        keys = hollowNoteProjections.keys();
-        qSort(keys);
+        const int ThinGapLimit = (params.staffLineHeight.min >> 1);
+        hollowNoteProjections.fillGaps(ThinGapLimit);
 
         // Remove peak region which are very thin or very thick.
         // IMPT: 110% the staffSpaceHeight max is really good choice for HOLLOW NOTES
         //       found through experimentation.
-        const int ThinRegionLimit = int(qRound(1.1 * dw->staffSpaceHeight().max));
-        const int ThickRegionLimit = dw->staffSpaceHeight().max << 1;
-
-        start = (keys.isEmpty() ? -1 : keys.first());
-        end = (keys.isEmpty() ? -2 : keys.last());
-        for (int i = start; i <= end; ++i) {
-            if (hollowNoteProjections.value(i, 0) == 0) continue;
-
-            int runlength = 0;
-            for (; (i+runlength) <= keys.last(); ++runlength) {
-                if (hollowNoteProjections.value(i+runlength, 0) == 0) break;
-            }
+        const int ThinRegionLimit = int(qRound(1.1 * params.staffSpaceHeight.max));
+        const int ThickRegionLimit = params.staffSpaceHeight.max << 1;
 
-            if (runlength <= ThinRegionLimit || runlength >= ThickRegionLimit) {
-                for (int j = i; j < (i+runlength); ++j) {
-                    hollowNoteProjections[j] = 0;
-                }
+        foreach (const Run& run, hollowNoteProjections.runs()) {
+            if (run.length <= ThinRegionLimit || run.length >= ThickRegionLimit) {
+                hollowNoteProjections.fill(run, 0);
             }
-
-            i += runlength - 1;
         }
 
-        // Update the keys as we added some new keys
-        keys = hollowNoteProjections.keys();
-        qSort(keys);
-
         // Now fill up noteSegments list (datastructure construction)
         const QRect r = workImage.rect();
         const int top = r.top();
         const int height = r.height();
-        const int noteWidth = 2 * DataWarehouse::instance()->staffSpaceHeight().min;
-
-        start = (keys.isEmpty() ? -1 : keys.first());
-        end = (keys.isEmpty() ? -2 : keys.last());
-        for (int i = start; i <= end; ++i) {
-            if (hollowNoteProjections.value(i, 0) == 0) continue;
+        const int noteWidth = 2 * params.staffSpaceHeight.min;
 
-            int runlength = 0;
-            for (; (i+runlength) <= keys.last(); ++runlength) {
-                if (hollowNoteProjections.value(i+runlength, 0) == 0) break;
-            }
-
-
-            int xCenter = i + (runlength >> 1);
-            NoteSegment *n = NoteSegment::create();
+        foreach (const Run& run, hollowNoteProjections.runs()) {
+            int xCenter = run.pos + (run.length >> 1);
+            NoteSegment *n = NoteSegment::create(arena);
             n->isNoteHeadFilled = false;
             // n->boundingRect = QRect(xCenter - noteWidth, top, noteWidth * 2, height);
             n->boundingRect = QRect(xCenter - (noteWidth >> 1), top, noteWidth, height);
             //n->boundingRect = QRect(key, top, runlength, height);
 
             hollowNoteSegments << n;
-
-            i += runlength - 1;
         }
 
         qSort(hollowNoteSegments.begin(), hollowNoteSegments.end(),
@@ -1269,45 +1109,73 @@ namespace Munip
 #endif
     }
 
-    QString StaffData::generateMusicXML(int tempo, int num, int denom)
+    QList<NoteInfo> StaffData::transcribedNotes(const PageContext *context)
     {
-        XmlConverter converter("play.xml", tempo, num, denom);
+        if (!context) {
+            context = DataWarehouse::instance();
+        }
 
-        QList<StaffData*> staffDatas = DataWarehouse::instance()->staffDatas();
+        QList<NoteInfo> retval;
+        QList<StaffData*> staffDatas = context->staffDatas();
         foreach (const StaffData *sd, staffDatas) {
-            QList<NoteSegment*> allSegments = sd->noteSegments + sd->hollowNoteSegments;
-            qSort(allSegments.begin(), allSegments.end(),
-                    lessThanNoteSegmentPointers);
-
-            QImage img = sd->imageWithStaffLines();
-            foreach (NoteSegment *segment, allSegments) {
-                QList<NoteInfo> infoList = segment->chordInfo(img);
+            const SymbolGraph& graph = sd->graph;
+            const StaffPitchModel pitchModel(sd->staff, sd->params.staffSpaceHeight,
+                    sd->params.staffLineHeight);
+            foreach (int note, graph.readingOrder()) {
+                QList<NoteInfo> infoList = graph.chordInfo(note, pitchModel);
                 if (infoList.isEmpty()) continue;
 
-                NoteInfo info = infoList.first();
-
-                converter.addPlainNote(info.step, info.octave, info.type);
+                retval << infoList.first();
             }
         }
+        return retval;
+    }
+
+    bool StaffData::generateMusicXML(int tempo, int num, int denom,
+            const PageContext *context, const QString& outputFile)
+    {
+        return writeMusicXML(transcribedNotes(context), tempo, num, denom, outputFile);
+    }
+
+    bool StaffData::generateMidi(int tempo, int num, int denom,
+            const PageContext *context, const QString& outputFile)
+    {
+        return writeMidi(transcribedNotes(context), tempo, num, denom, outputFile);
+    }
+
+    bool StaffData::writeMusicXML(const QList<NoteInfo>& notes, int tempo, int num, int denom,
+            const QString& outputFile)
+    {
+        XmlConverter converter(outputFile, tempo, num, denom);
+
+        foreach (const NoteInfo& info, notes) {
+            converter.addPlainNote(info.step, info.octave, info.type);
+        }
 
-        converter.domTreeToXmlFile();
+        const bool ok = converter.finish();
         qDebug() << Q_FUNC_INFO << "Error code:" << converter.getErrorCode();
 
-        QString string;
-        converter.domTreeToXmlString(string);
+        return ok;
+    }
 
-        return string;
+    bool StaffData::writeMidi(const QList<NoteInfo>& notes, int tempo, int num, int denom,
+            const QString& outputFile)
+    {
+        MidiWriter writer(tempo, num, denom);
+        foreach (const NoteInfo& info, notes) {
+            writer.addNote(info.step, info.octave, info.type);
+        }
+        return writer.write(outputFile);
     }
 
     void StaffData::extractHollowNoteStemSegments()
     {
         const QRgb BlackColor = QColor(Qt::black).rgb();
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int lineHeight = dw->staffLineHeight().min * 2;
+        const int lineHeight = params.staffLineHeight.min * 2;
 
-        const int StemHeightLimit = dw->staffSpaceHeight().max +
-            2 * dw->staffLineHeight().max;
+        const int StemHeightLimit = params.staffSpaceHeight.max +
+            2 * params.staffLineHeight.max;
 
         foreach (NoteSegment* seg, hollowNoteSegments) {
             QRect rect = seg->boundingRect;
@@ -1368,7 +1236,7 @@ namespace Munip
                 }
             }
 
-            StemSegment *stemSeg = StemSegment::create();
+            StemSegment *stemSeg = StemSegment::create(arena);
             stemSeg->boundingRect = stemRect;
             stemSeg->noteSegment = seg;
             seg->stemSegment = stemSeg;
@@ -1379,10 +1247,9 @@ namespace Munip
     {
         const QRgb BlackColor = QColor(Qt::black).rgb();
 
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int extensionLimit = dw->staffSpaceHeight().min;
-        const int NoteWidthLimit = dw->staffSpaceHeight().min;
-        const int NoteHeightLimit = dw->staffSpaceHeight().min;// - dw->staffLineHeight().min;
+        const int extensionLimit = params.staffSpaceHeight.min;
+        const int NoteWidthLimit = params.staffSpaceHeight.min;
+        const int NoteHeightLimit = params.staffSpaceHeight.min;// - params.staffLineHeight.min;
 
         // First extract half notes (with stem segments)
         foreach (NoteSegment *seg, hollowNoteSegments) {
@@ -1405,58 +1272,42 @@ namespace Munip
                 areaToProject.setRight(stemRect.left() - 1);
             }
 
-            QHash<int, int> projHelper;
+            ProjectionProfile projHelper(areaToProject.top(), areaToProject.height());
             for (int y = areaToProject.top(); y <= areaToProject.bottom(); ++y) {
                 int count = 0;
                 for (int x = areaToProject.left(); x <= areaToProject.right(); ++x) {
                     count += (workImage.pixel(x, y) == BlackColor);
                 }
 
-                projHelper.insert(y, count >= NoteWidthLimit ? count : 0);
+                projHelper.setValue(y, count >= NoteWidthLimit ? count : 0);
             }
 
             // Now filter based on Height of H projection
-            QList<int> keys = projHelper.keys();
-            qSort(keys);
-
-            for (int i = keys.first(); i <= keys.last(); ++i) {
-                if (projHelper.value(i, 0) == 0) continue;
-
-                int runlength = 0;
-                for (; (i + runlength) <= keys.last(); ++runlength) {
-                    if (projHelper.value(i + runlength, 0) == 0) {
-                        break;
-                    }
-                }
-
+            foreach (const Run& run, projHelper.runs()) {
                 // Nullify if not notehead
-                if (runlength < NoteHeightLimit) {
-                    for (int j = 0; j < runlength; ++j) {
-                        projHelper[i + j] = 0;
-                    }
-
+                if (run.length < NoteHeightLimit) {
+                    projHelper.fill(run, 0);
                 } else {
-                    int midY = i + (runlength >> 1);
+                    int midY = run.pos + (run.length >> 1);
                     QRect rect(areaToProject.left(), midY - NoteHeightLimit, areaToProject.width(),
                             NoteHeightLimit * 2);
                     //QRect rect(areaToProject.left(), midY - NoteHeightLimit, areaToProject.width(),
                     //        NoteHeightLimit * 2);
                     seg->noteRects << rect;
                 }
-
-                i += runlength - 1;
             }
 
             seg->horizontalProjection = projHelper;
         }
 
-        const int WholeNoteWidthLimit = dw->staffSpaceHeight().min;
-        const int WholeNoteHeightLimit = dw->staffSpaceHeight().min;
+        const int WholeNoteWidthLimit = params.staffSpaceHeight.min;
+        const int WholeNoteHeightLimit = params.staffSpaceHeight.min;
 
         foreach (NoteSegment *seg, hollowNoteSegments) {
             if (seg->stemSegment) continue;
 
             QRect segRect = seg->boundingRect;
+            seg->horizontalProjection = ProjectionProfile(segRect.top(), segRect.height());
 
             for (int y = segRect.top(); y <= segRect.bottom(); ++y) {
                 int maxRun = -1;
@@ -1477,43 +1328,61 @@ namespace Munip
                     maxRun = 0;
                 }
 
-                seg->horizontalProjection.insert(y, maxRun);
+                seg->horizontalProjection.setValue(y, maxRun);
             }
 
             // Now filter based on Height of H projection
-            QList<int> keys = seg->horizontalProjection.keys();
-            qSort(keys);
-
-            for (int i = keys.first(); i <= keys.last(); ++i) {
-                if (seg->horizontalProjection.value(i, 0) == 0) continue;
-
-                int runlength = 0;
-                for (; (i + runlength) <= keys.last(); ++runlength) {
-                    if (seg->horizontalProjection.value(i + runlength, 0) == 0) {
-                        break;
-                    }
-                }
-
+            foreach (const Run& run, seg->horizontalProjection.runs()) {
                 // Nullify if not notehead
-                if (runlength < WholeNoteHeightLimit) {
-                    for (int j = 0; j < runlength; ++j) {
-                        seg->horizontalProjection[i + j] = 0;
-                    }
-
+                if (run.length < WholeNoteHeightLimit) {
+                    seg->horizontalProjection.fill(run, 0);
                 } else {
-                    int midY = i + (runlength >> 1);
+                    int midY = run.pos + (run.length >> 1);
                     QRect rect(segRect.left(), midY - WholeNoteHeightLimit, segRect.width(),
                             WholeNoteHeightLimit * 2);
                     //QRect rect(areaToProject.left(), midY - NoteHeightLimit, areaToProject.width(),
                     //        NoteHeightLimit * 2);
                     seg->noteRects << rect;
                 }
-
-                i += runlength - 1;
             }
         }
     }
 
+    void StaffData::buildSymbolGraph()
+    {
+        graph = SymbolGraph::fromSegments(noteSegments, hollowNoteSegments, beamsRunCoords);
+    }
+
+    BitPlane StaffData::skeleton() const
+    {
+        return thinned(BitPlane::fromImage(workImage));
+    }
+
+    DistanceMap StaffData::strokeThickness() const
+    {
+        return distanceTransform(BitPlane::fromImage(workImage));
+    }
+
+    QList<QPoint> StaffData::noteHeadCentres() const
+    {
+        // A filled note head spans about a staff space vertically, whereas
+        // beams are around half a staff space thick.
+        const qreal MinRadius = .35 * params.staffSpaceHeight.min;
+        return strokeThickness().localMaxima(MinRadius);
+    }
+
+    QList<BinaryTemplate> StaffData::templates() const
+    {
+        return BinaryTemplate::standardTemplates(params.staffSpaceHeight.min,
+                params.staffLineHeight.min);
+    }
+
+    QList<TemplateMatch> StaffData::matchTemplates() const
+    {
+        const TemplateMatcher matcher(BitPlane::fromImage(workImage));
+        return matcher.match(templates(), symbolRects);
+    }
+
     QImage StaffData::staffImage() const
     {
         const QRect r = staff.boundingRect();
@@ -1533,7 +1402,7 @@ namespace Munip
         QImage img(r.size(), QImage::Format_ARGB32_Premultiplied);
         QPainter p(&img);
         p.drawImage(QRect(0, 0, r.width(), r.height()),
-                DataWarehouse::instance()->imageRefWithRemovedStaffLinesOnly(),
+                params.imageWithRemovedStaffLinesOnly,
                 r);
         p.end();
 
@@ -1553,63 +1422,14 @@ namespace Munip
         QPainter p(&img);
         const QList<StaffLine> staffLines = staff.staffLines();
 
-        QList<QPair<char, int> > noteOctaveList;
-        noteOctaveList << qMakePair('C', 7);
-        noteOctaveList << qMakePair('B', 6);
-
-        noteOctaveList << qMakePair('A', 6);
-        noteOctaveList << qMakePair('G', 6);
-
-        noteOctaveList << qMakePair('F', 6);
-        noteOctaveList << qMakePair('E', 6);
-
-        noteOctaveList << qMakePair('D', 6);
-        noteOctaveList << qMakePair('C', 6);
-
-        noteOctaveList << qMakePair('B', 5);
-        noteOctaveList << qMakePair('A', 5);
-
-        noteOctaveList << qMakePair('G', 5);
-        // Staff line starts
-        noteOctaveList << qMakePair('F', 5);
-        noteOctaveList << qMakePair('E', 5);
-
-        noteOctaveList << qMakePair('D', 5);
-        noteOctaveList << qMakePair('C', 5);
-
-        noteOctaveList << qMakePair('B', 4);
-        noteOctaveList << qMakePair('A', 4);
-
-        noteOctaveList << qMakePair('G', 4);
-        noteOctaveList << qMakePair('F', 4);
-
-        noteOctaveList << qMakePair('E', 4);
-        // Staff line ends
-
-        noteOctaveList << qMakePair('D', 4);
-
-        noteOctaveList << qMakePair('C', 4);
-        noteOctaveList << qMakePair('B', 3);
-
-        noteOctaveList << qMakePair('A', 3);
-        noteOctaveList << qMakePair('G', 3);
-
-        noteOctaveList << qMakePair('F', 3);
-        noteOctaveList << qMakePair('E', 3);
-
-        noteOctaveList << qMakePair('D', 3);
-        noteOctaveList << qMakePair('C', 3);
-
-        noteOctaveList << qMakePair('B', 2);
-        noteOctaveList << qMakePair('A', 2);
+        const Pitch *noteOctaveList = StaffPositions[TrebleClef];
 
-        int i = 11;
-        DataWarehouse *dw = DataWarehouse::instance();
-        const int Shift = (dw->staffSpaceHeight().dominantValue() >> 1) +
-            (dw->staffLineHeight().dominantValue() >> 1);
+        int i = TopLinePosition;
+        const int Shift = (params.staffSpaceHeight.dominantValue() >> 1) +
+            (params.staffLineHeight.dominantValue() >> 1);
 
         foreach (const StaffLine& staffLine, staffLines) {
-            p.setPen(noteOctaveToColor(noteOctaveList[i].first, noteOctaveList[i].second));
+            p.setPen(noteOctaveToColor(noteOctaveList[i].step, noteOctaveList[i].octave));
             ++i;
             const QList<Segment> segments = staffLine.segments();
             foreach (const Segment& seg, segments) {
@@ -1617,7 +1437,7 @@ namespace Munip
             }
 
             if (1 || ((i % 2) != 0)) {
-                p.setPen(noteOctaveToColor(noteOctaveList[i].first, noteOctaveList[i].second));
+                p.setPen(noteOctaveToColor(noteOctaveList[i].step, noteOctaveList[i].octave));
                 foreach (const Segment& seg, segments) {
                     p.drawLine(seg.startPos() + delta + QPoint(0, Shift),
                             seg.endPos() + delta + QPoint(0, Shift));
@@ -1629,9 +1449,9 @@ namespace Munip
         QList<Segment> segments = staffLines.last().segments();
         int yDelta = (delta + (QPoint(0, Shift) * 2)).y();
 
-        for (; i < noteOctaveList.size(); ++i) {
+        for (; i < StaffPositionCount; ++i) {
             bool toBreak = false;
-            p.setPen(noteOctaveToColor(noteOctaveList[i].first, noteOctaveList[i].second));
+            p.setPen(noteOctaveToColor(noteOctaveList[i].step, noteOctaveList[i].octave));
             foreach (const Segment& seg, segments) {
                 if ((seg.startPos() + QPoint(0, yDelta)).y() >= workImage.height()) {
                     toBreak = true;
@@ -1648,9 +1468,9 @@ namespace Munip
 
         segments = staffLines.first().segments();
         yDelta = (delta - QPoint(0, Shift)).y();
-        for (i = 10; i >= 0; --i) {
+        for (i = TopLinePosition - 1; i >= 0; --i) {
             bool toBreak = false;
-            p.setPen(noteOctaveToColor(noteOctaveList[i].first, noteOctaveList[i].second));
+            p.setPen(noteOctaveToColor(noteOctaveList[i].step, noteOctaveList[i].octave));
             foreach (const Segment& seg, segments) {
                 if ((seg.startPos() + QPoint(0, yDelta)).y() < 0) {
                     toBreak = true;
@@ -1670,7 +1490,7 @@ namespace Munip
         return img;
     }
 
-    QImage StaffData::projectionImage(const QHash<int, int> &hash) const
+    QImage StaffData::projectionImage(const ProjectionProfile &profile) const
     {
         const QRect r = workImage.rect();
 
@@ -1680,7 +1500,7 @@ namespace Munip
         QPainter p(&img);
         p.setPen(Qt::blue);
         for (int x = r.left(); x <= r.right(); ++x) {
-            QLineF line(x, r.bottom(), x, r.bottom() - hash[x]);
+            QLineF line(x, r.bottom(), x, r.bottom() - profile.value(x));
             p.drawLine(line);
         }
         p.end();
@@ -1699,11 +1519,10 @@ namespace Munip
             p.setPen(QColor(Qt::blue));
             QRect segRect = seg->boundingRect;
 
-            QHash<int, int>::const_iterator it = seg->horizontalProjection.constBegin();
-            while (it != seg->horizontalProjection.constEnd()) {
-                p.drawLine(segRect.left(), it.key(),
-                        segRect.left() + it.value(), it.key());
-                ++it;
+            const ProjectionProfile &profile = seg->horizontalProjection;
+            for (int y = profile.first(); y <= profile.last(); ++y) {
+                p.drawLine(segRect.left(), y,
+                        segRect.left() + profile.value(y), y);
             }
             p.setPen(QColor(Qt::blue));
             p.drawRect(segRect);
@@ -1724,11 +1543,10 @@ namespace Munip
             p.setPen(QColor(Qt::blue));
             QRect segRect = seg->boundingRect;
 
-            QHash<int, int>::const_iterator it = seg->horizontalProjection.constBegin();
-            while (it != seg->horizontalProjection.constEnd()) {
-                p.drawLine(segRect.left(), it.key(),
-                        segRect.left() + it.value(), it.key());
-                ++it;
+            const ProjectionProfile &profile = seg->horizontalProjection;
+            for (int y = profile.first(); y <= profile.last(); ++y) {
+                p.drawLine(segRect.left(), y,
+                        segRect.left() + profile.value(y), y);
             }
             p.setPen(QColor(Qt::blue));
             p.drawRect(segRect);
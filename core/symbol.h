@@ -1,10 +1,16 @@
 #ifndef SYMBOL_H
 #define SYMBOL_H
 
+#include "bitplane.h"
+#include "distancetransform.h"
 #include "staff.h"
+#include "symbolarena.h"
+#include "symbolgraph.h"
+#include "templatematcher.h"
 #include "tools.h"
 
 #include <QList>
+#include <QMargins>
 #include <QRect>
 #include <QImage>
 
@@ -12,28 +18,20 @@ class QImage;
 
 namespace Munip
 {
+    class PageContext;
     class Range;
     class StemSegment;
 
-    struct NoteInfo
-    {
-        QString step;
-        QString octave;
-        QString type;
-    };
-
     struct NoteSegment
     {
-        static NoteSegment* create() { return new NoteSegment; }
+        static NoteSegment* create(SymbolArena& arena) { return arena.createNoteSegment(); }
 
         QRect boundingRect;
         QList<QRect> noteRects;
         StemSegment *stemSegment;
         bool isNoteHeadFilled;
 
-        QHash<int, int> horizontalProjection;
-
-        QList<NoteInfo> chordInfo(const QImage &lineImage) const;
+        ProjectionProfile horizontalProjection;
 
 
         /// Its enough to compare bounding rectangles as two note segments
@@ -43,13 +41,13 @@ namespace Munip
         }
 
     private:
+        friend class ArenaPool<NoteSegment>;
         NoteSegment() { stemSegment = 0; isNoteHeadFilled = false; }
-        //~NoteSegment() { delete stemSegment; }
     };
 
     struct StemSegment
     {
-        static StemSegment* create() { return new StemSegment; }
+        static StemSegment* create(SymbolArena& arena) { return arena.createStemSegment(); }
 
         QRect boundingRect;
         NoteSegment *noteSegment;
@@ -69,12 +67,46 @@ namespace Munip
         }
 
     private:
+        friend class ArenaPool<StemSegment>;
         StemSegment() {
             noteSegment = 0;
             leftFlagCount = rightFlagCount = 0;
         }
     };
 
+    /**
+     * The stems of a staff sorted by their left edge, along with the
+     * running maximum of right edges, so that the stems around a column
+     * are found by binary search instead of testing every stem.
+     */
+    class StemIndex
+    {
+    public:
+        // Indexes the stems of noteSegments, with their boxes grown by
+        // margins as given.
+        void build(const QList<NoteSegment*>& noteSegments, const QMargins& margins);
+        void clear();
+
+        // The first stem, in the order of noteSegments, whose grown box
+        // intersects rect. 0 if there is none.
+        StemSegment* stemAt(const QRect& rect) const;
+
+    private:
+        struct Entry
+        {
+            QRect rect;
+            int order;
+            StemSegment *stem;
+
+            bool operator<(const Entry& other) const {
+                return rect.left() < other.rect.left();
+            }
+        };
+
+        QVector<Entry> m_entries;
+        QVector<int> m_maxRight;
+    };
+
     struct Region
     {
         int id;
@@ -84,9 +116,25 @@ namespace Munip
         Region() { id = -1; }
     };
 
+    /**
+     * Page level values StaffData depends on. They are copied in when the
+     * StaffData is created, so that processing never reads the mutable
+     * page context and staves can be processed concurrently.
+     */
+    struct StaffParams
+    {
+        static StaffParams fromPageContext(const PageContext *context);
+        static StaffParams fromDataWarehouse();
+
+        Range staffSpaceHeight;
+        Range staffLineHeight;
+        QImage imageWithRemovedStaffLinesOnly;
+    };
+
     struct StaffData
     {
         StaffData(const QImage& img, const Staff& staff);
+        StaffData(const QImage& img, const Staff& staff, const StaffParams& params);
         ~StaffData();
 
         void process();
@@ -94,10 +142,10 @@ namespace Munip
         void findSymbolRegions();
 
         void findMaxProjections();
-        int determinePeakHValueFrom(const QList<int> &horProjValues);
+        int determinePeakHValueFrom(const QVector<int> &horProjValues);
 
         void extractNoteSegments();
-        QHash<int, int> filter(Range width, Range height, const QHash<int, int> &hash);
+        ProjectionProfile filter(Range width, Range height, const ProjectionProfile &profile);
 
         void extractStemSegments();
         void eraseStems();
@@ -123,26 +171,69 @@ namespace Munip
         void extractHollowNoteStemSegments();
         void extractHollowNotes();
 
-        static QString generateMusicXML(int tempo = 120, int num = 4, int deonm = 4);
+        // Flattens the detected segments into graph.
+        void buildSymbolGraph();
+
+        // Pitch and type of the notes of the StaffData objects of context,
+        // or of DataWarehouse if 0, in reading order. Chords are reduced to
+        // their first note.
+        static QList<NoteInfo> transcribedNotes(const PageContext *context = 0);
+
+        // Uses the StaffData objects of context, or of DataWarehouse if 0,
+        // and streams the score to outputFile. Returns false if it could
+        // not be written.
+        static bool generateMusicXML(int tempo = 120, int num = 4, int deonm = 4,
+                const PageContext *context = 0,
+                const QString& outputFile = QString("play.xml"));
+        // The same notes as a Standard MIDI File, for playback.
+        static bool generateMidi(int tempo = 120, int num = 4, int denom = 4,
+                const PageContext *context = 0,
+                const QString& outputFile = QString("play.mid"));
+
+        // Write notes already transcribed, so that several outputs can
+        // share one transcription.
+        static bool writeMusicXML(const QList<NoteInfo>& notes, int tempo, int num, int denom,
+                const QString& outputFile);
+        static bool writeMidi(const QList<NoteInfo>& notes, int tempo, int num, int denom,
+                const QString& outputFile);
 
         QImage staffImage() const;
         QImage staffImageWithRemovedStaffLinesOnly() const;
         QImage imageWithStaffLines() const;
-        QImage projectionImage(const QHash<int, int> &hash) const;
+        QImage projectionImage(const ProjectionProfile &profile) const;
         QImage noteHeadHorizontalProjectionImage() const;
         QImage hollowNoteHeadHorizontalProjectionImage() const;
 
+        // One pixel wide skeleton of the current workImage, used for
+        // tracing thin symbols like ties, slurs and flags.
+        BitPlane skeleton() const;
+        // Distance of every black pixel of workImage to the nearest white
+        // one, i.e. half the local stroke thickness.
+        DistanceMap strokeThickness() const;
+        // Centres of blobs thicker than beams, stems and ledger lines.
+        // These are the filled note head candidates.
+        QList<QPoint> noteHeadCentres() const;
+        // Matches of the standard note head and accidental templates
+        // within symbolRects. templateIndex refers to templates().
+        QList<TemplateMatch> matchTemplates() const;
+        QList<BinaryTemplate> templates() const;
+
         int SlidingWindowSize;
 
+        StaffParams params;
         Staff staff;
         QList<QRect> symbolRects;
-        QHash<int, int> maxProjections;
-        QHash<int, int> noteProjections;
+        ProjectionProfile maxProjections;
+        ProjectionProfile noteProjections;
+
+        ProjectionProfile temp;
 
-        QHash<int, int> temp;
+        ProjectionProfile hollowNoteMaxProjections;
+        ProjectionProfile hollowNoteProjections;
 
-        QHash<int, int> hollowNoteMaxProjections;
-        QHash<int, int> hollowNoteProjections;
+        // Owns the segments and regions listed below, they are freed
+        // together with the StaffData.
+        SymbolArena arena;
 
         QList<NoteSegment*> noteSegments;
         QList<QList<RunCoord> > beamsRunCoords;
@@ -150,6 +241,12 @@ namespace Munip
 
         QList<NoteSegment*> hollowNoteSegments;
 
+        // The stems of noteSegments, built by extractStemSegments().
+        StemIndex stemIndex;
+
+        // The result of process().
+        SymbolGraph graph;
+
         const QImage& image;
         QImage workImage;
     };
@@ -0,0 +1,65 @@
+#include "symbolarena.h"
+#include "symbol.h"
+
+namespace Munip
+{
+    SymbolArena::SymbolArena()
+    {
+    }
+
+    SymbolArena::~SymbolArena()
+    {
+    }
+
+    NoteSegment* SymbolArena::createNoteSegment()
+    {
+        return m_noteSegments.create();
+    }
+
+    StemSegment* SymbolArena::createStemSegment()
+    {
+        return m_stemSegments.create();
+    }
+
+    Region* SymbolArena::createRegion()
+    {
+        return m_regions.create();
+    }
+
+    NoteSegment* SymbolArena::noteSegment(int index) const
+    {
+        return m_noteSegments.at(index);
+    }
+
+    StemSegment* SymbolArena::stemSegment(int index) const
+    {
+        return m_stemSegments.at(index);
+    }
+
+    Region* SymbolArena::region(int index) const
+    {
+        return m_regions.at(index);
+    }
+
+    int SymbolArena::noteSegmentCount() const
+    {
+        return m_noteSegments.size();
+    }
+
+    int SymbolArena::stemSegmentCount() const
+    {
+        return m_stemSegments.size();
+    }
+
+    int SymbolArena::regionCount() const
+    {
+        return m_regions.size();
+    }
+
+    void SymbolArena::clear()
+    {
+        m_noteSegments.clear();
+        m_stemSegments.clear();
+        m_regions.clear();
+    }
+}
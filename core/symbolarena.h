@@ -0,0 +1,102 @@
+#ifndef SYMBOLARENA_H
+#define SYMBOLARENA_H
+
+#include <QVector>
+
+#include <new>
+
+namespace Munip
+{
+    struct NoteSegment;
+    struct StemSegment;
+    struct Region;
+
+    /**
+     * Objects of one type, constructed in place in blocks of BlockSize.
+     * Blocks never move, so pointers stay valid and every object also has
+     * a stable index in creation order. Objects are only destroyed all at
+     * once, by clear() or the destructor.
+     */
+    template <typename T>
+    class ArenaPool
+    {
+    public:
+        enum { BlockSize = 64 };
+
+        ArenaPool() : m_size(0) {}
+        ~ArenaPool() {
+            clear();
+            for (int i = 0; i < m_blocks.size(); ++i) {
+                ::operator delete(m_blocks[i]);
+            }
+        }
+
+        T* create() {
+            const int block = m_size / BlockSize;
+            if (block == m_blocks.size()) {
+                m_blocks.append(static_cast<char*>(::operator new(BlockSize * sizeof(T))));
+            }
+            T *object = new (m_blocks[block] + (m_size % BlockSize) * sizeof(T)) T;
+            ++m_size;
+            return object;
+        }
+
+        T* at(int index) const {
+            return reinterpret_cast<T*>(m_blocks[index / BlockSize]) + index % BlockSize;
+        }
+
+        int size() const { return m_size; }
+
+        // Destroys all objects. The blocks are kept for reuse.
+        void clear() {
+            while (m_size > 0) {
+                at(--m_size)->~T();
+            }
+        }
+
+    private:
+        ArenaPool(const ArenaPool&);
+        ArenaPool& operator=(const ArenaPool&);
+
+        QVector<char*> m_blocks;
+        int m_size;
+    };
+
+    /**
+     * Owns the symbol objects detected on a staff. Each StaffData has its
+     * own, so staves processed in parallel never share an allocator, and
+     * everything is released together with the StaffData.
+     *
+     * Not thread safe, one staff is processed by one thread.
+     */
+    class SymbolArena
+    {
+    public:
+        SymbolArena();
+        ~SymbolArena();
+
+        NoteSegment* createNoteSegment();
+        StemSegment* createStemSegment();
+        Region* createRegion();
+
+        NoteSegment* noteSegment(int index) const;
+        StemSegment* stemSegment(int index) const;
+        Region* region(int index) const;
+
+        int noteSegmentCount() const;
+        int stemSegmentCount() const;
+        int regionCount() const;
+
+        void clear();
+
+    private:
+        SymbolArena(const SymbolArena&);
+        SymbolArena& operator=(const SymbolArena&);
+
+        ArenaPool<NoteSegment> m_noteSegments;
+        ArenaPool<StemSegment> m_stemSegments;
+        ArenaPool<Region> m_regions;
+    };
+}
+
+#endif // SYMBOLARENA_H
@@ -0,0 +1,169 @@
+#include "symbolgraph.h"
+#include "notetables.h"
+#include "staffpitchmodel.h"
+#include "symbol.h"
+
+#include <QHash>
+#include <QtAlgorithms>
+
+namespace Munip
+{
+    template <typename Container>
+    static void appendRuns(QVector<RunCoord>& runs, const Container& runCoords,
+            int *first, int *count)
+    {
+        *first = runs.size();
+        *count = runCoords.size();
+        foreach (const RunCoord& rc, runCoords) {
+            runs << rc;
+        }
+    }
+
+    struct LessThanNoteLeft
+    {
+        explicit LessThanNoteLeft(const QVector<SymbolGraph::Note>& n) : notes(n) {}
+
+        bool operator()(int l, int r) const {
+            return notes[l].boundingRect.left() < notes[r].boundingRect.left();
+        }
+
+        const QVector<SymbolGraph::Note>& notes;
+    };
+
+    SymbolGraph::SymbolGraph() :
+        filledNoteCount(0)
+    {
+    }
+
+    SymbolGraph SymbolGraph::fromSegments(const QList<NoteSegment*>& filledNotes,
+            const QList<NoteSegment*>& hollowNotes,
+            const QList<QList<RunCoord> >& beamsRunCoords)
+    {
+        SymbolGraph retval;
+
+        // Only needed while linking, the graph itself has no pointers.
+        QHash<const NoteSegment*, int> noteIndices;
+        QHash<const StemSegment*, int> stemIndices;
+        QList<const StemSegment*> stemSegments;
+
+        const QList<NoteSegment*> segments = filledNotes + hollowNotes;
+        retval.filledNoteCount = filledNotes.size();
+        retval.notes.reserve(segments.size());
+        foreach (const NoteSegment *segment, segments) {
+            Note note;
+            note.boundingRect = segment->boundingRect;
+            note.firstHead = retval.heads.size();
+            note.headCount = segment->noteRects.size();
+            foreach (const QRect& rect, segment->noteRects) {
+                retval.heads << rect;
+            }
+            note.isNoteHeadFilled = segment->isNoteHeadFilled;
+
+            // Stems are shared by the notes of a chord.
+            note.stem = -1;
+            if (segment->stemSegment) {
+                if (!stemIndices.contains(segment->stemSegment)) {
+                    stemIndices.insert(segment->stemSegment, stemSegments.size());
+                    stemSegments << segment->stemSegment;
+                }
+                note.stem = stemIndices.value(segment->stemSegment);
+            }
+
+            noteIndices.insert(segment, retval.notes.size());
+            retval.notes << note;
+        }
+
+        retval.stems.reserve(stemSegments.size());
+        foreach (const StemSegment *segment, stemSegments) {
+            Stem stem;
+            stem.boundingRect = segment->boundingRect;
+            stem.note = noteIndices.value(segment->noteSegment, -1);
+            stem.leftFlagCount = segment->leftFlagCount;
+            stem.rightFlagCount = segment->rightFlagCount;
+            appendRuns(retval.flagRuns, segment->flagRunCoords,
+                    &stem.firstFlagRun, &stem.flagRunCount);
+            appendRuns(retval.flagRuns, segment->partialBeamRunCoords,
+                    &stem.firstPartialBeamRun, &stem.partialBeamRunCount);
+            retval.stems << stem;
+        }
+
+        retval.beams.reserve(beamsRunCoords.size());
+        foreach (const QList<RunCoord>& runCoords, beamsRunCoords) {
+            Beam beam;
+            appendRuns(retval.beamRuns, runCoords, &beam.firstRun, &beam.runCount);
+            retval.beams << beam;
+        }
+
+        return retval;
+    }
+
+    void SymbolGraph::clear()
+    {
+        *this = SymbolGraph();
+    }
+
+    QVector<int> SymbolGraph::readingOrder() const
+    {
+        QVector<int> retval(notes.size());
+        for (int i = 0; i < retval.size(); ++i) {
+            retval[i] = i;
+        }
+        qStableSort(retval.begin(), retval.end(), LessThanNoteLeft(notes));
+        return retval;
+    }
+
+    int SymbolGraph::denominator(int note) const
+    {
+        const Note& n = notes[note];
+        int retval = 1;
+        if (n.isNoteHeadFilled) {
+            retval <<= 2;
+            if (n.stem >= 0) {
+                retval <<= qMax(stems[n.stem].leftFlagCount, stems[n.stem].rightFlagCount);
+            }
+        } else if (n.stem >= 0) {
+            retval *= 2;
+        }
+        return retval;
+    }
+
+    QList<NoteInfo> SymbolGraph::chordInfo(int note, const StaffPitchModel& pitchModel) const
+    {
+        QList<NoteInfo> retval;
+
+        const int typeIndex = noteTypeIndex(denominator(note));
+        const QString type = typeIndex < 0 ? QString() :
+            QString::fromLatin1(NoteTypes[typeIndex].name);
+
+        const Note& n = notes[note];
+        for (int h = n.firstHead; h < n.firstHead + n.headCount; ++h) {
+            const QRect& rect = heads[h];
+
+            // Every column of the note head votes for the line or space
+            // nearest to its centre.
+            int votes[StaffPositionCount];
+            qFill(votes, votes + StaffPositionCount, 0);
+            const int centerY = rect.center().y();
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                ++votes[pitchModel.positionAt(x, centerY)];
+            }
+
+            int position = 0;
+            for (int i = 1; i < StaffPositionCount; ++i) {
+                if (votes[i] > votes[position]) {
+                    position = i;
+                }
+            }
+            const Pitch pitch = pitchModel.pitch(position);
+
+            NoteInfo noteInfo;
+            noteInfo.octave = QString::number(pitch.octave);
+            noteInfo.step.append(QChar(pitch.step));
+            noteInfo.type = type;
+
+            retval << noteInfo;
+        }
+
+        return retval;
+    }
+}
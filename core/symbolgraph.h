@@ -0,0 +1,85 @@
+#ifndef SYMBOLGRAPH_H
+#define SYMBOLGRAPH_H
+
+#include "tools.h"
+
+#include <QList>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+namespace Munip
+{
+    struct NoteSegment;
+    class StaffPitchModel;
+
+    struct NoteInfo
+    {
+        QString step;
+        QString octave;
+        QString type;
+    };
+
+    /**
+     * The symbols detected on a staff, as one table per kind of symbol.
+     * Entries refer to each other by index instead of pointer, -1 meaning
+     * none, and variable length parts are ranges into shared tables.
+     *
+     * Detection works on linked NoteSegment and StemSegment objects; once
+     * a staff is processed they are flattened into a SymbolGraph, and
+     * everything downstream (transcription, export, snapshots) walks these
+     * tables front to back. A SymbolGraph is a plain value, copies can be
+     * handed to other threads.
+     */
+    struct SymbolGraph
+    {
+        struct Note
+        {
+            QRect boundingRect;
+            int firstHead, headCount;   // into heads, one per chord note
+            int stem;
+            bool isNoteHeadFilled;
+        };
+
+        struct Stem
+        {
+            QRect boundingRect;
+            int note;
+            int leftFlagCount, rightFlagCount;
+            int firstFlagRun, flagRunCount;                 // into flagRuns
+            int firstPartialBeamRun, partialBeamRunCount;   // into flagRuns
+        };
+
+        struct Beam
+        {
+            int firstRun, runCount;     // into beamRuns
+        };
+
+        SymbolGraph();
+
+        // Filled notes first, in the order given, then hollow ones.
+        static SymbolGraph fromSegments(const QList<NoteSegment*>& filledNotes,
+                const QList<NoteSegment*>& hollowNotes,
+                const QList<QList<RunCoord> >& beamsRunCoords);
+
+        void clear();
+
+        // Indices of all notes ordered by their left edge.
+        QVector<int> readingOrder() const;
+        // 1 for a whole note, 4 for a quarter...
+        int denominator(int note) const;
+        // Pitch and type of every head of the note, top to bottom as
+        // detected.
+        QList<NoteInfo> chordInfo(int note, const StaffPitchModel& pitchModel) const;
+
+        QVector<Note> notes;
+        int filledNoteCount;
+        QVector<QRect> heads;
+        QVector<Stem> stems;
+        QVector<Beam> beams;
+        QVector<RunCoord> beamRuns;
+        QVector<RunCoord> flagRuns;
+    };
+}
+
+#endif // SYMBOLGRAPH_H
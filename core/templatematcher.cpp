@@ -0,0 +1,261 @@
+#include "templatematcher.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QPolygonF>
+
+#include <cmath>
+
+namespace Munip
+{
+    typedef BitPlane::Word Word;
+
+    BinaryTemplate::BinaryTemplate() :
+        m_threshold(1.0)
+    {
+    }
+
+    BinaryTemplate::BinaryTemplate(const QString& name, const BitPlane& shape, qreal threshold) :
+        m_name(name),
+        m_shape(shape),
+        m_threshold(threshold)
+    {
+    }
+
+    static BitPlane renderShape(const QSize& size,
+            void (*draw)(QPainter&, qreal, qreal, qreal), qreal s)
+    {
+        QImage img(size, QImage::Format_ARGB32_Premultiplied);
+        img.fill(0xffffffff);
+
+        QPainter p(&img);
+        p.setRenderHint(QPainter::Antialiasing, false);
+        p.setPen(Qt::NoPen);
+        p.setBrush(Qt::black);
+        draw(p, size.width(), size.height(), s);
+        p.end();
+
+        return BitPlane::fromImage(img);
+    }
+
+    static void drawFilledNoteHead(QPainter& p, qreal w, qreal h, qreal s)
+    {
+        p.translate(w / 2, h / 2);
+        p.rotate(-20);
+        p.drawEllipse(QPointF(0, 0), .62 * s, .45 * s);
+    }
+
+    static void drawHollowNoteHead(QPainter& p, qreal w, qreal h, qreal s)
+    {
+        drawFilledNoteHead(p, w, h, s);
+        p.rotate(-20);
+        p.setBrush(Qt::white);
+        p.drawEllipse(QPointF(0, 0), .45 * s, .2 * s);
+    }
+
+    static void drawSharp(QPainter& p, qreal w, qreal h, qreal s)
+    {
+        const qreal stem = qMax(1.0, .12 * s);
+        const qreal bar = .35 * s;
+        const qreal rise = .3 * s;
+
+        p.drawRect(QRectF(.3 * w - stem / 2, .05 * h, stem, .9 * h));
+        p.drawRect(QRectF(.7 * w - stem / 2, 0, stem, .9 * h));
+        for (int i = 0; i < 2; ++i) {
+            const qreal y = (i == 0) ? .35 * h : .65 * h;
+            QPolygonF poly;
+            poly << QPointF(0, y + rise / 2) << QPointF(w, y - rise / 2)
+                << QPointF(w, y - rise / 2 + bar) << QPointF(0, y + rise / 2 + bar);
+            p.drawPolygon(poly);
+        }
+    }
+
+    static void drawNatural(QPainter& p, qreal w, qreal h, qreal s)
+    {
+        const qreal stem = qMax(1.0, .12 * s);
+        const qreal bar = .35 * s;
+        const qreal rise = .2 * s;
+
+        p.drawRect(QRectF(0, 0, stem, .72 * h));
+        p.drawRect(QRectF(w - stem, .28 * h, stem, .72 * h));
+        for (int i = 0; i < 2; ++i) {
+            const qreal y = (i == 0) ? .3 * h : .58 * h;
+            QPolygonF poly;
+            poly << QPointF(0, y + rise / 2) << QPointF(w, y - rise / 2)
+                << QPointF(w, y - rise / 2 + bar) << QPointF(0, y + rise / 2 + bar);
+            p.drawPolygon(poly);
+        }
+    }
+
+    static void drawFlat(QPainter& p, qreal w, qreal h, qreal s)
+    {
+        const qreal stem = qMax(1.0, .12 * s);
+
+        p.drawRect(QRectF(0, 0, stem, h));
+        p.drawEllipse(QRectF(0, h - s, w, s));
+        p.setBrush(Qt::white);
+        p.drawEllipse(QRectF(stem, h - .8 * s, w - 2.5 * stem, .55 * s));
+    }
+
+    QList<BinaryTemplate> BinaryTemplate::standardTemplates(int staffSpaceHeight, int staffLineHeight)
+    {
+        QList<BinaryTemplate> retval;
+        const qreal s = qMax(4, staffSpaceHeight);
+        const qreal l = qMax(1, staffLineHeight);
+
+        const int headWidth = qRound(1.3 * s);
+        const int headHeight = qRound(s + l);
+
+        retval << BinaryTemplate("filledNoteHead",
+                renderShape(QSize(headWidth, headHeight),
+                    drawFilledNoteHead, s), .85);
+        retval << BinaryTemplate("hollowNoteHead",
+                renderShape(QSize(headWidth, headHeight),
+                    drawHollowNoteHead, s), .8);
+        retval << BinaryTemplate("sharp",
+                renderShape(QSize(qRound(s), qRound(2.8 * s)),
+                    drawSharp, s), .8);
+        retval << BinaryTemplate("natural",
+                renderShape(QSize(qRound(.6 * s), qRound(2.8 * s)),
+                    drawNatural, s), .8);
+        retval << BinaryTemplate("flat",
+                renderShape(QSize(qRound(.8 * s), qRound(2.4 * s)),
+                    drawFlat, s), .8);
+
+        return retval;
+    }
+
+    TemplateMatcher::TemplateMatcher(const BitPlane& image) :
+        m_image(image)
+    {
+    }
+
+    // 64 image pixels of line y starting at pixel x, zero outside.
+    Word TemplateMatcher::imageBits(int y, int x) const
+    {
+        if (y < 0 || y >= m_image.height() || x >= m_image.width() || x <= -64) {
+            return 0;
+        }
+
+        const Word *line = m_image.scanLine(y);
+        const int words = m_image.wordsPerLine();
+        if (x < 0) {
+            return line[0] << (-x);
+        }
+
+        const int i = x >> 6;
+        const int bit = x & 63;
+        Word retval = line[i] >> bit;
+        if (bit != 0 && i + 1 < words) {
+            retval |= line[i + 1] << (64 - bit);
+        }
+        return retval;
+    }
+
+    qreal TemplateMatcher::score(const BinaryTemplate& tmpl, const QPoint& topLeft,
+            qreal minScore) const
+    {
+        const BitPlane& shape = tmpl.shape();
+        if (shape.isNull()) {
+            return -1;
+        }
+
+        const int w = shape.width();
+        const int h = shape.height();
+        const int words = shape.wordsPerLine();
+        const Word lastMask = shape.lastWordMask();
+        const int area = w * h;
+        // The epsilon keeps minScore = n / area from rounding up to n + 1.
+        const int required = int(std::ceil(minScore * area - 1e-6));
+
+        // Disagreeing pixels allowed before the position can be dropped.
+        const int allowedMisses = area - required;
+        int misses = 0;
+
+        for (int ty = 0; ty < h; ++ty) {
+            const Word *t = shape.scanLine(ty);
+            const int y = topLeft.y() + ty;
+            for (int i = 0; i < words; ++i) {
+                Word diff = t[i] ^ imageBits(y, topLeft.x() + i * 64);
+                if (i == words - 1) {
+                    diff &= lastMask;
+                }
+                misses += popCount(diff);
+            }
+            if (misses > allowedMisses) {
+                return -1;
+            }
+        }
+
+        return qreal(area - misses) / area;
+    }
+
+    QList<TemplateMatch> TemplateMatcher::match(const BinaryTemplate& tmpl, const QRect& region) const
+    {
+        QList<TemplateMatch> retval;
+        const QRect r = region.intersected(m_image.rect());
+        const QSize size = tmpl.size();
+
+        for (int y = r.top(); y + size.height() - 1 <= r.bottom(); ++y) {
+            for (int x = r.left(); x + size.width() - 1 <= r.right(); ++x) {
+                const qreal s = score(tmpl, QPoint(x, y), tmpl.threshold());
+                if (s < 0) continue;
+
+                TemplateMatch m;
+                m.rect = QRect(QPoint(x, y), size);
+                m.score = s;
+                retval << m;
+            }
+        }
+
+        return suppressOverlaps(retval);
+    }
+
+    QList<TemplateMatch> TemplateMatcher::match(const QList<BinaryTemplate>& templates,
+            const QList<QRect>& regions) const
+    {
+        QList<TemplateMatch> retval;
+        for (int i = 0; i < templates.size(); ++i) {
+            foreach (const QRect& region, regions) {
+                QList<TemplateMatch> matches = match(templates[i], region);
+                for (int j = 0; j < matches.size(); ++j) {
+                    matches[j].templateIndex = i;
+                }
+                retval << matches;
+            }
+        }
+        return suppressOverlaps(retval);
+    }
+
+    static bool higherScore(const TemplateMatch& a, const TemplateMatch& b)
+    {
+        return a.score > b.score;
+    }
+
+    QList<TemplateMatch> TemplateMatcher::suppressOverlaps(QList<TemplateMatch> matches)
+    {
+        qStableSort(matches.begin(), matches.end(), higherScore);
+
+        QList<TemplateMatch> retval;
+        foreach (const TemplateMatch& m, matches) {
+            bool overlaps = false;
+            foreach (const TemplateMatch& kept, retval) {
+                const QRect common = m.rect.intersected(kept.rect);
+                if (common.isEmpty()) continue;
+
+                const int commonArea = common.width() * common.height();
+                const int keptArea = kept.rect.width() * kept.rect.height();
+                if (2 * commonArea > keptArea) {
+                    overlaps = true;
+                    break;
+                }
+            }
+
+            if (!overlaps) {
+                retval << m;
+            }
+        }
+
+        return retval;
+    }
+}
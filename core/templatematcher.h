@@ -0,0 +1,80 @@
+#ifndef TEMPLATEMATCHER_H
+#define TEMPLATEMATCHER_H
+
+#include "bitplane.h"
+
+#include <QList>
+#include <QRect>
+#include <QString>
+
+namespace Munip
+{
+    /**
+     * A small binary symbol shape. Set bits are expected to be black and
+     * clear bits white, both count equally towards the match score.
+     */
+    class BinaryTemplate
+    {
+    public:
+        BinaryTemplate();
+        BinaryTemplate(const QString& name, const BitPlane& shape, qreal threshold);
+
+        QString name() const { return m_name; }
+        const BitPlane& shape() const { return m_shape; }
+        QSize size() const { return m_shape.size(); }
+        // Minimum fraction of agreeing pixels for a match.
+        qreal threshold() const { return m_threshold; }
+
+        bool isNull() const { return m_shape.isNull(); }
+
+        // Note heads and accidentals scaled to the given staff metrics.
+        static QList<BinaryTemplate> standardTemplates(int staffSpaceHeight, int staffLineHeight);
+
+    private:
+        QString m_name;
+        BitPlane m_shape;
+        qreal m_threshold;
+    };
+
+    struct TemplateMatch
+    {
+        TemplateMatch() : templateIndex(-1), score(0) {}
+
+        int templateIndex;
+        QRect rect;
+        qreal score;
+    };
+
+    /**
+     * Correlates binary templates with a bitplane by XOR and popcount of
+     * whole template rows. A position is dropped as soon as the remaining
+     * rows can no longer lift it above the template threshold.
+     */
+    class TemplateMatcher
+    {
+    public:
+        explicit TemplateMatcher(const BitPlane& image);
+
+        // Fraction of agreeing pixels with the template placed at topLeft,
+        // or -1 if it is known to stay below minScore. Pixels outside the
+        // image count as white.
+        qreal score(const BinaryTemplate& tmpl, const QPoint& topLeft, qreal minScore) const;
+
+        // All positions with the template rect inside region scoring at
+        // least the template threshold, overlapping matches suppressed.
+        QList<TemplateMatch> match(const BinaryTemplate& tmpl, const QRect& region) const;
+        QList<TemplateMatch> match(const QList<BinaryTemplate>& templates,
+                const QList<QRect>& regions) const;
+
+        // Greedily keeps the best matches, dropping any match which covers
+        // more than half of the area of an already kept one.
+        static QList<TemplateMatch> suppressOverlaps(QList<TemplateMatch> matches);
+
+    private:
+        BitPlane::Word imageBits(int y, int x) const;
+
+        BitPlane m_image;
+    };
+}
+
+#endif // TEMPLATEMATCHER_H
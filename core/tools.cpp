@@ -56,6 +56,101 @@ namespace Munip
         }
     }
 
+    ProjectionProfile::ProjectionProfile(int offset, int size) :
+        m_offset(offset),
+        m_data(qMax(0, size), 0)
+    {
+    }
+
+    void ProjectionProfile::setValue(int pos, int value)
+    {
+        Q_ASSERT(contains(pos));
+        if (contains(pos)) {
+            m_data[pos - m_offset] = value;
+        }
+    }
+
+    void ProjectionProfile::raiseTo(int pos, int value)
+    {
+        Q_ASSERT(contains(pos));
+        if (contains(pos)) {
+            int &ref = m_data[pos - m_offset];
+            ref = qMax(ref, value);
+        }
+    }
+
+    void ProjectionProfile::fill(const Run& run, int value)
+    {
+        const int start = qMax(run.pos, first());
+        const int end = qMin(run.endPos() - 1, last());
+        int *data = m_data.data();
+        for (int i = start; i <= end; ++i) {
+            data[i - m_offset] = value;
+        }
+    }
+
+    ProjectionProfile ProjectionProfile::filtered(const Range& height) const
+    {
+        ProjectionProfile retval(m_offset, m_data.size());
+
+        const int *src = m_data.constData();
+        int *dst = retval.m_data.data();
+        for (int i = 0; i < m_data.size(); ++i) {
+            if (src[i] < height.min) continue;
+            // Setting it height.max destroyes the curve, but emboldens the note head region in
+            // a better fashion.
+            dst[i] = qMin(src[i], height.max);
+        }
+
+        return retval;
+    }
+
+    void ProjectionProfile::fillGaps(int maxGapLength)
+    {
+        int *data = m_data.data();
+        const int size = m_data.size();
+
+        for (int i = 0; i < size; ++i) {
+            if (data[i] > 0) continue;
+
+            int runlength = 0;
+            for (; (i + runlength) < size; ++runlength) {
+                if (data[i + runlength] > 0) break;
+            }
+
+            const bool isBounded = (i > 0 && (i + runlength) < size);
+            if (isBounded && runlength <= maxGapLength) {
+                const int valueToInsert = qMin(data[i - 1], data[i + runlength]);
+                for (int j = i; j < (i + runlength); ++j) {
+                    data[j] = valueToInsert;
+                }
+            }
+
+            i += runlength - 1;
+        }
+    }
+
+    QList<Run> ProjectionProfile::runs() const
+    {
+        QList<Run> retval;
+        const int *data = m_data.constData();
+        const int size = m_data.size();
+
+        for (int i = 0; i < size; ++i) {
+            if (data[i] == 0) continue;
+
+            int runlength = 0;
+            for (; (i + runlength) < size; ++runlength) {
+                if (data[i + runlength] == 0) break;
+            }
+
+            retval << Run(m_offset + i, runlength);
+            i += runlength - 1;
+        }
+
+        return retval;
+    }
+
     const QList<Run> RunlengthImage::InvalidRuns = QList<Run>();
 
     RunlengthImage::RunlengthImage(const QImage& image,
@@ -68,6 +163,12 @@ namespace Munip
         } else {
             initializeVerticalRunlengthImage(image, color, m_data);
         }
+
+        m_firstRunId.resize(m_data.size() + 1);
+        m_firstRunId[0] = 0;
+        for (int i = 0; i < m_data.size(); ++i) {
+            m_firstRunId[i + 1] = m_firstRunId[i] + m_data[i].size();
+        }
     }
 
     RunlengthImage::~RunlengthImage()
@@ -181,6 +282,47 @@ namespace Munip
         return retval;
     }
 
+    int RunlengthImage::runCount() const
+    {
+        return m_firstRunId.last();
+    }
+
+    RunCoord RunlengthImage::runCoord(int id) const
+    {
+        if (id < 0 || id >= runCount()) return RunCoord();
+
+        const int index = qUpperBound(m_firstRunId.begin(), m_firstRunId.end(), id) -
+            m_firstRunId.begin() - 1;
+        return RunCoord(index, m_data[index][id - m_firstRunId[index]]);
+    }
+
+    void RunlengthImage::adjacentRunIds(int index, const Run& run, int *first, int *last) const
+    {
+        *first = *last = 0;
+        if (index < 0 || index >= m_data.size()) return;
+
+        // Runs of a line are disjoint and sorted, so the touching ones are
+        // consecutive. The same bounds as run(), endPos() included.
+        const QList<Run>& line = m_data[index];
+        int l = 0, h = line.size();
+        while (l < h) {
+            const int mid = (l + h) / 2;
+            if (line[mid].endPos() < run.pos) {
+                l = mid + 1;
+            } else {
+                h = mid;
+            }
+        }
+
+        int end = l;
+        while (end < line.size() && line[end].pos < run.endPos()) {
+            ++end;
+        }
+
+        *first = m_firstRunId[index] + l;
+        *last = m_firstRunId[index] + end;
+    }
+
     VerticalRunlengthImage::VerticalRunlengthImage(const QImage& image,
             const QColor& color) : RunlengthImage(image, Qt::Vertical, color)
     {
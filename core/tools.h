@@ -7,6 +7,7 @@
 #include <QColor>
 #include <QDebug>
 #include <QImage>
+#include <QVector>
 
 extern bool EnableMDebugOutput;
 
@@ -99,6 +100,50 @@ namespace Munip
         }
     };
 
+    /**
+     * Dense projection profile over a contiguous coordinate range
+     * [first(), last()]. Coordinates outside the range read as 0, so
+     * this behaves like a QHash<int, int> with missing keys treated as
+     * zero, but without hashing, sorting or per entry allocation.
+     */
+    class ProjectionProfile
+    {
+    public:
+        explicit ProjectionProfile(int offset = 0, int size = 0);
+
+        bool isEmpty() const { return m_data.isEmpty(); }
+        int size() const { return m_data.size(); }
+        int first() const { return m_offset; }
+        int last() const { return m_offset + m_data.size() - 1; }
+
+        bool contains(int pos) const {
+            return pos >= m_offset && pos < m_offset + m_data.size();
+        }
+
+        int value(int pos) const {
+            return contains(pos) ? m_data.at(pos - m_offset) : 0;
+        }
+
+        void setValue(int pos, int value);
+        void raiseTo(int pos, int value);
+        void fill(const Run& run, int value);
+
+        // Values below height.min become 0 and values above height.max
+        // are clamped to height.max.
+        ProjectionProfile filtered(const Range& height) const;
+
+        // Fills zero runs not longer than maxGapLength, which are bounded
+        // on both sides by non zero values, with min of those values.
+        void fillGaps(int maxGapLength);
+
+        // Runs of non zero values, in increasing order of position.
+        QList<Run> runs() const;
+
+    private:
+        int m_offset;
+        QVector<int> m_data;
+    };
+
     class RunlengthImage
     {
     public:
@@ -117,11 +162,21 @@ namespace Munip
         QList<Run> adjacentRunsInNextLine(const RunCoord& runCoord) const;
         QList<Run> adjacentRunsInPreviousLine(const RunCoord& runCoord) const;
 
+        // Runs are also numbered densely, line by line in the order of
+        // runs(), so that per run state can be kept in flat arrays.
+        int runCount() const;
+        RunCoord runCoord(int id) const;
+        // Ids [*first, *last) of the runs of line index that touch run,
+        // the ones adjacentRunsInNextLine() and
+        // adjacentRunsInPreviousLine() return for the neighbouring line.
+        void adjacentRunIds(int index, const Run& run, int *first, int *last) const;
+
     private:
         static const QList<Run> InvalidRuns;
 
         Qt::Orientation m_orientation;
         QList<QList<Run> >  m_data;
+        QVector<int> m_firstRunId;
         QSize m_size;
     };
 
@@ -183,16 +238,24 @@ inline uint qHash(const QPoint& p)
 }
 
 namespace Munip {
+    // Mixes value into seed, as boost::hash_combine does. Unlike scaling
+    // one field by a constant it does not collide once a coordinate
+    // exceeds that constant.
+    inline uint hashCombine(uint seed, uint value)
+    {
+        return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+    }
+
     inline uint qHash(const Munip::Run& run)
     {
         if (!run.isValid()) return 0;
-        return run.pos * 4000 + run.length + 1;
+        return hashCombine(uint(run.pos) * 2654435761u, uint(run.length));
     }
 
     inline uint qHash(const Munip::RunCoord &runCoord)
     {
         if (!runCoord.isValid()) return 0;
-        return runCoord.pos * 4000 + qHash(runCoord.run) + 1;
+        return hashCombine(uint(runCoord.pos) * 2654435761u, qHash(runCoord.run));
     }
 }
 
@@ -3,17 +3,10 @@
 
 #include "cluster.h"
 #include "datawarehouse.h"
-#include "imagewidget.h"
-#include "mainwindow.h"
-#include "projection.h"
 #include "tools.h"
 
-#include <QAction>
 #include <QDir>
 #include <QFile>
-#include <QInputDialog>
-#include <QLabel>
-#include <QMessageBox>
 #include <QPainter>
 #include <QPen>
 #include <QProcess>
@@ -0,0 +1,456 @@
+#include "zipwriter.h"
+
+#include <QDateTime>
+#include <QIODevice>
+#include <QVector>
+
+namespace Munip
+{
+    static void appendLittleEndian16(QByteArray& data, quint16 value)
+    {
+        data.append(char(value & 0xff));
+        data.append(char(value >> 8));
+    }
+
+    static void appendLittleEndian32(QByteArray& data, quint32 value)
+    {
+        appendLittleEndian16(data, quint16(value & 0xffff));
+        appendLittleEndian16(data, quint16(value >> 16));
+    }
+
+    struct CrcTable
+    {
+        CrcTable() {
+            for (quint32 n = 0; n < 256; ++n) {
+                quint32 c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+                }
+                values[n] = c;
+            }
+        }
+
+        quint32 values[256];
+    };
+    Q_GLOBAL_STATIC(CrcTable, crcTable)
+
+    quint32 ZipWriter::crc32(quint32 crc, const char *data, int length)
+    {
+        const quint32 *table = crcTable()->values;
+        crc = ~crc;
+        for (int i = 0; i < length; ++i) {
+            crc = table[(crc ^ uchar(data[i])) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // RFC 1951 length codes 257..285 and distance codes 0..29.
+    static const int LengthBase[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const int LengthExtraBits[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    static const int DistanceBase[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    static const int DistanceExtraBits[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+
+    /**
+     * Deflates what is written to it into the member of a ZipWriter, as
+     * one long fixed Huffman block which is closed by finish().
+     *
+     * m_data holds at least the last WindowSize bytes before m_pos, which
+     * matches may refer to, followed by input not encoded yet. Positions
+     * are counted from the start of the member.
+     */
+    class DeflateDevice : public QIODevice
+    {
+    public:
+        explicit DeflateDevice(ZipWriter *zip);
+
+        // Ends the deflate stream and writes out what is left.
+        bool finish(quint32 *crc, quint32 *compressedSize, quint32 *size);
+
+    protected:
+        virtual qint64 readData(char *data, qint64 maxSize);
+        virtual qint64 writeData(const char *data, qint64 length);
+
+    private:
+        enum {
+            WindowSize = 32768,
+            WindowMask = WindowSize - 1,
+            HashBits = 15,
+            HashMask = (1 << HashBits) - 1,
+            MinMatch = 3,
+            MaxMatch = 258,
+            // Longer chains compress a little better and a lot slower.
+            MaxChainLength = 64,
+            OutputChunkSize = 16384
+        };
+
+        static int hash(const uchar *p) {
+            return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & HashMask;
+        }
+
+        void insertHash(int pos);
+        void compress(bool flush);
+        void putBits(quint32 value, int count);
+        void putCode(quint32 code, int length);
+        void putLiteral(int symbol);
+        void putMatch(int length, int distance);
+        bool flushOutput();
+
+        ZipWriter *m_zip;
+        QByteArray m_data;
+        int m_base;
+        int m_pos;
+        QVector<int> m_head;
+        QVector<int> m_prev;
+
+        quint32 m_bitBuffer;
+        int m_bitCount;
+        QByteArray m_out;
+
+        quint32 m_crc;
+        quint32 m_size;
+        quint32 m_compressedSize;
+    };
+
+    DeflateDevice::DeflateDevice(ZipWriter *zip) :
+        m_zip(zip),
+        m_base(0),
+        m_pos(0),
+        m_head(HashMask + 1, -1),
+        m_prev(WindowSize, -1),
+        m_bitBuffer(0),
+        m_bitCount(0),
+        m_crc(0),
+        m_size(0),
+        m_compressedSize(0)
+    {
+        // Not the final block, fixed Huffman codes.
+        putBits(0, 1);
+        putBits(1, 2);
+    }
+
+    qint64 DeflateDevice::readData(char *data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+    qint64 DeflateDevice::writeData(const char *data, qint64 length)
+    {
+        m_crc = ZipWriter::crc32(m_crc, data, int(length));
+        m_size += quint32(length);
+        m_data.append(data, int(length));
+        compress(false);
+        return flushOutput() ? length : -1;
+    }
+
+    void DeflateDevice::insertHash(int pos)
+    {
+        const int h = hash(reinterpret_cast<const uchar*>(m_data.constData()) + (pos - m_base));
+        m_prev[pos & WindowMask] = m_head[h];
+        m_head[h] = pos;
+    }
+
+    void DeflateDevice::compress(bool flush)
+    {
+        const uchar *data = reinterpret_cast<const uchar*>(m_data.constData());
+        const int end = m_base + m_data.size();
+        // Without flushing, keep enough input back for a match of
+        // maximum length.
+        const int limit = flush ? end : end - MaxMatch;
+
+        while (m_pos < limit) {
+            const uchar *p = data + (m_pos - m_base);
+            const int available = end - m_pos;
+            int bestLength = 0;
+            int bestDistance = 0;
+
+            if (available >= MinMatch) {
+                const int maxLength = qMin(int(MaxMatch), available);
+                int candidate = m_head[hash(p)];
+                for (int chain = 0; candidate >= 0 && m_pos - candidate <= WindowSize &&
+                        chain < MaxChainLength; ++chain) {
+                    const uchar *q = data + (candidate - m_base);
+                    if (q[bestLength] == p[bestLength]) {
+                        int length = 0;
+                        while (length < maxLength && q[length] == p[length]) {
+                            ++length;
+                        }
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDistance = m_pos - candidate;
+                            if (length == maxLength) break;
+                        }
+                    }
+                    // Slots of the chain array are reused every window,
+                    // a link which does not go back is a stale one.
+                    const int next = m_prev[candidate & WindowMask];
+                    if (next >= candidate) break;
+                    candidate = next;
+                }
+                insertHash(m_pos);
+            }
+
+            if (bestLength >= MinMatch) {
+                putMatch(bestLength, bestDistance);
+                for (int i = 1; i < bestLength; ++i) {
+                    if (end - (m_pos + i) >= MinMatch) {
+                        insertHash(m_pos + i);
+                    }
+                }
+                m_pos += bestLength;
+            } else {
+                putLiteral(*p);
+                ++m_pos;
+            }
+        }
+
+        // Drop input which has left the window, in large steps.
+        const int keep = m_pos - WindowSize;
+        if (keep - m_base >= 2 * WindowSize) {
+            m_data.remove(0, keep - m_base);
+            m_base = keep;
+        }
+    }
+
+    void DeflateDevice::putBits(quint32 value, int count)
+    {
+        m_bitBuffer |= value << m_bitCount;
+        m_bitCount += count;
+        while (m_bitCount >= 8) {
+            m_out.append(char(m_bitBuffer & 0xff));
+            m_bitBuffer >>= 8;
+            m_bitCount -= 8;
+        }
+    }
+
+    // Huffman codes go out most significant bit first.
+    void DeflateDevice::putCode(quint32 code, int length)
+    {
+        quint32 reversed = 0;
+        for (int i = 0; i < length; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        putBits(reversed, length);
+    }
+
+    void DeflateDevice::putLiteral(int symbol)
+    {
+        if (symbol < 144) {
+            putCode(0x30 + symbol, 8);
+        } else if (symbol < 256) {
+            putCode(0x190 + symbol - 144, 9);
+        } else if (symbol < 280) {
+            putCode(symbol - 256, 7);
+        } else {
+            putCode(0xc0 + symbol - 280, 8);
+        }
+    }
+
+    void DeflateDevice::putMatch(int length, int distance)
+    {
+        int code = 28;
+        while (LengthBase[code] > length) --code;
+        putLiteral(257 + code);
+        putBits(length - LengthBase[code], LengthExtraBits[code]);
+
+        code = 29;
+        while (DistanceBase[code] > distance) --code;
+        putCode(code, 5);
+        putBits(distance - DistanceBase[code], DistanceExtraBits[code]);
+    }
+
+    bool DeflateDevice::flushOutput()
+    {
+        if (m_out.size() < OutputChunkSize) {
+            return true;
+        }
+        m_compressedSize += m_out.size();
+        const bool ok = m_zip->write(m_out);
+        m_out.clear();
+        return ok;
+    }
+
+    bool DeflateDevice::finish(quint32 *crc, quint32 *compressedSize, quint32 *size)
+    {
+        compress(true);
+
+        // End of block, then an empty final block.
+        putLiteral(256);
+        putBits(1, 1);
+        putBits(1, 2);
+        putLiteral(256);
+        if (m_bitCount > 0) {
+            putBits(0, 8 - m_bitCount);
+        }
+
+        m_compressedSize += m_out.size();
+        const bool ok = m_zip->write(m_out);
+        m_out.clear();
+
+        *crc = m_crc;
+        *compressedSize = m_compressedSize;
+        *size = m_size;
+        return ok;
+    }
+
+    ZipWriter::ZipWriter(QIODevice *device) :
+        m_device(device),
+        m_offset(0),
+        m_openFile(0),
+        m_failed(false)
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+        m_dosTime = (now.time().hour() << 11) | (now.time().minute() << 5) |
+            (now.time().second() / 2);
+        m_dosDate = ((qMax(1980, now.date().year()) - 1980) << 9) |
+            (now.date().month() << 5) | now.date().day();
+    }
+
+    ZipWriter::~ZipWriter()
+    {
+        delete m_openFile;
+    }
+
+    bool ZipWriter::write(const QByteArray& data)
+    {
+        if (m_failed) {
+            return false;
+        }
+        if (m_device->write(data) != data.size()) {
+            m_failed = true;
+            return false;
+        }
+        m_offset += data.size();
+        return true;
+    }
+
+    bool ZipWriter::writeLocalHeader(const Entry& entry)
+    {
+        QByteArray header;
+        appendLittleEndian32(header, 0x04034b50);
+        appendLittleEndian16(header, 20); // version needed, 2.0 for deflate
+        appendLittleEndian16(header, entry.flags);
+        appendLittleEndian16(header, entry.method);
+        appendLittleEndian16(header, m_dosTime);
+        appendLittleEndian16(header, m_dosDate);
+        appendLittleEndian32(header, entry.crc);
+        appendLittleEndian32(header, entry.compressedSize);
+        appendLittleEndian32(header, entry.size);
+        appendLittleEndian16(header, entry.name.size());
+        appendLittleEndian16(header, 0); // extra field length
+        header.append(entry.name);
+        return write(header);
+    }
+
+    bool ZipWriter::addStoredFile(const QString& name, const QByteArray& data)
+    {
+        if (m_openFile) {
+            return false;
+        }
+
+        Entry entry;
+        entry.name = name.toUtf8();
+        entry.flags = 0x0800; // UTF-8 name
+        entry.method = 0;
+        entry.crc = crc32(0, data.constData(), data.size());
+        entry.compressedSize = entry.size = data.size();
+        entry.offset = m_offset;
+        m_entries << entry;
+
+        return writeLocalHeader(entry) && write(data);
+    }
+
+    QIODevice* ZipWriter::openFile(const QString& name)
+    {
+        if (m_openFile) {
+            return 0;
+        }
+
+        Entry entry;
+        entry.name = name.toUtf8();
+        entry.flags = 0x0808; // CRC and sizes follow the data, UTF-8 name
+        entry.method = 8;
+        entry.crc = entry.compressedSize = entry.size = 0;
+        entry.offset = m_offset;
+        m_entries << entry;
+
+        if (!writeLocalHeader(entry)) {
+            return 0;
+        }
+        m_openFile = new DeflateDevice(this);
+        m_openFile->open(QIODevice::WriteOnly);
+        return m_openFile;
+    }
+
+    bool ZipWriter::closeFile()
+    {
+        if (!m_openFile) {
+            return false;
+        }
+
+        Entry &entry = m_entries.last();
+        bool ok = m_openFile->finish(&entry.crc, &entry.compressedSize, &entry.size);
+        delete m_openFile;
+        m_openFile = 0;
+
+        QByteArray descriptor;
+        appendLittleEndian32(descriptor, 0x08074b50);
+        appendLittleEndian32(descriptor, entry.crc);
+        appendLittleEndian32(descriptor, entry.compressedSize);
+        appendLittleEndian32(descriptor, entry.size);
+        return write(descriptor) && ok;
+    }
+
+    bool ZipWriter::close()
+    {
+        if (m_openFile && !closeFile()) {
+            return false;
+        }
+
+        QByteArray directory;
+        foreach (const Entry& entry, m_entries) {
+            appendLittleEndian32(directory, 0x02014b50);
+            appendLittleEndian16(directory, 20); // made by
+            appendLittleEndian16(directory, 20); // needed
+            appendLittleEndian16(directory, entry.flags);
+            appendLittleEndian16(directory, entry.method);
+            appendLittleEndian16(directory, m_dosTime);
+            appendLittleEndian16(directory, m_dosDate);
+            appendLittleEndian32(directory, entry.crc);
+            appendLittleEndian32(directory, entry.compressedSize);
+            appendLittleEndian32(directory, entry.size);
+            appendLittleEndian16(directory, entry.name.size());
+            appendLittleEndian16(directory, 0); // extra field length
+            appendLittleEndian16(directory, 0); // comment length
+            appendLittleEndian16(directory, 0); // disk number
+            appendLittleEndian16(directory, 0); // internal attributes
+            appendLittleEndian32(directory, 0); // external attributes
+            appendLittleEndian32(directory, entry.offset);
+            directory.append(entry.name);
+        }
+
+        const quint32 directorySize = directory.size();
+        appendLittleEndian32(directory, 0x06054b50);
+        appendLittleEndian16(directory, 0); // this disk
+        appendLittleEndian16(directory, 0); // disk with the directory
+        appendLittleEndian16(directory, m_entries.size());
+        appendLittleEndian16(directory, m_entries.size());
+        appendLittleEndian32(directory, directorySize);
+        appendLittleEndian32(directory, m_offset);
+        appendLittleEndian16(directory, 0); // comment length
+        return write(directory);
+    }
+}
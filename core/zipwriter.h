@@ -0,0 +1,72 @@
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class QIODevice;
+
+namespace Munip
+{
+    class DeflateDevice;
+
+    /**
+     * Writes a ZIP archive to a device, front to back, the way .mxl files
+     * are put together: a few small stored members and the score, which is
+     * deflated while it is being written.
+     *
+     * Deflating is done here, with LZ77 matching over a 32k window and the
+     * fixed Huffman codes of RFC 1951, so no more than the window and a
+     * small output buffer is held in memory. Members written through
+     * openFile() carry their CRC and sizes in a data descriptor following
+     * the data. There is no ZIP64 support, members and the archive must
+     * stay below 4 GB.
+     */
+    class ZipWriter
+    {
+    public:
+        explicit ZipWriter(QIODevice *device);
+        ~ZipWriter();
+
+        // Stored uncompressed, for small members like META-INF/container.xml.
+        bool addStoredFile(const QString& name, const QByteArray& data);
+
+        // Everything written to the returned device, which the writer
+        // owns, is deflated into the member name until closeFile().
+        QIODevice* openFile(const QString& name);
+        bool closeFile();
+
+        // Writes the central directory. The device is left open.
+        bool close();
+
+        static quint32 crc32(quint32 crc, const char *data, int length);
+
+    private:
+        struct Entry
+        {
+            QByteArray name;
+            quint16 flags;
+            quint16 method;
+            quint32 crc;
+            quint32 compressedSize;
+            quint32 size;
+            quint32 offset;
+        };
+
+        bool writeLocalHeader(const Entry& entry);
+        bool write(const QByteArray& data);
+
+        friend class DeflateDevice;
+
+        QIODevice *m_device;
+        quint32 m_offset;
+        quint16 m_dosTime;
+        quint16 m_dosDate;
+        QList<Entry> m_entries;
+        DeflateDevice *m_openFile;
+        bool m_failed;
+    };
+}
+
+#endif // ZIPWRITER_H
@@ -0,0 +1,30 @@
+TEMPLATE = lib
+TARGET = gui
+CONFIG += static
+QT += xml webkit
+
+# Input
+HEADERS += imagewidget.h \
+    mainwindow.h \
+    processstepaction.h \
+    projection.h \
+    sidebar.h
+SOURCES += imagewidget.cpp \
+    mainwindow.cpp \
+    processstepaction.cpp \
+    projection.cpp \
+    sidebar.cpp
+
+INCLUDEPATH += ../core
+
+MOC_DIR = .tmp
+UI_DIR = .tmp
+RCC_DIR = .tmp
+OBJECTS_DIR = .tmp
+
+CONFIG += debug
+win32 {
+    CONFIG += console
+}
+
+DESTDIR = ..
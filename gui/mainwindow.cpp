@@ -3,6 +3,7 @@
 #include "imagewidget.h"
 #include "projection.h"
 #include "processstep.h"
+#include "processstepaction.h"
 #include "sidebar.h"
 #include "symbol.h"
 #include "tools.h"
@@ -11,6 +12,7 @@
 #include <QApplication>
 #include <QDebug>
 #include <QDialog>
+#include <QDesktopServices>
 #include <QDialogButtonBox>
 #include <QDir>
 #include <QDockWidget>
@@ -30,6 +32,7 @@
 #include <QTabWidget>
 #include <QTextEdit>
 #include <QToolBar>
+#include <QUrl>
 #include <QVBoxLayout>
 #include <QWebView>
 
@@ -38,6 +41,9 @@ MainWindow* MainWindow::m_instance = 0;
 MainWindow::MainWindow()
 {
     m_showGridAction = 0;
+    m_tempo = 120;
+    m_numerator = 4;
+    m_denominator = 4;
     m_tabWidget = new QTabWidget;
     setCentralWidget(m_tabWidget);
 
@@ -169,7 +175,7 @@ void MainWindow::setupActions()
     toolBar->addAction(m_showGridAction);
     toolBar->addSeparator();
 
-    QList<Munip::ProcessStepAction*> psActions = Munip::ProcessStepFactory::actions(this);
+    QList<Munip::ProcessStepAction*> psActions = Munip::ProcessStepAction::actions(this);
 
     QAction *projectionAction = new QAction(tr("&Projection"), this);
     projectionAction->setShortcut(tr("Ctrl+P"));
@@ -181,6 +187,10 @@ void MainWindow::setupActions()
     playAction->setStatusTip(tr("Plays the result of latest symbol detection"));
     connect(playAction, SIGNAL(triggered()), this, SLOT(slotPlay()));
 
+    QAction *brailleAction = new QAction(tr("&Braille"), this);
+    brailleAction->setStatusTip(tr("Transcribes the result of latest symbol detection to braille"));
+    connect(brailleAction, SIGNAL(triggered()), this, SLOT(slotTranscribeBraille()));
+
     QMenu *processMenu = menuBar->addMenu(tr("&Process"));
     SideBar *processBar = new SideBar();
     int i = 1;
@@ -194,6 +204,8 @@ void MainWindow::setupActions()
             playAction->setShortcut(QString("Ctrl+%1").arg(i));
             processMenu->addAction(playAction);
             processBar->addAction(playAction);
+            processMenu->addAction(brailleAction);
+            processBar->addAction(brailleAction);
        }
 
        ++i;
@@ -333,65 +345,77 @@ void MainWindow::slotProjection()
     sub->show();
 }
 
-void MainWindow::slotPlay()
+void MainWindow::askTimeSettings()
 {
-    int tempo = 120;
-    int numerator = 4;
-    int denominator = 4;
-
-    {
-        QScopedPointer<QDialog> dialog(new QDialog);
-        QString data[3] = { "Tempo", "Numerator", "Denominator" };
-        int defaultValues[3] = { tempo, numerator, denominator };
-        int mins[3] = { 80, 1, 1 };
-        int maxs[3] = { 160, 64, 64 };
-
-        QVBoxLayout *layout = new QVBoxLayout(dialog.data());
-        QGridLayout *grid = new QGridLayout;
-        layout->addLayout(grid);
-        QDialogButtonBox *box = new QDialogButtonBox(dialog.data());
-        box->setOrientation(Qt::Horizontal);
-        box->setStandardButtons(QDialogButtonBox::Ok);
-
-        dialog.data()->connect(box, SIGNAL(accepted()), SLOT(accept()));
-
-        for (int i = 0; i < 3; ++i) {
-            QString caption = data[i];
-            caption.prepend('&');
-            QLabel *label = new QLabel(caption);
-            label->setAlignment(Qt::AlignRight);
-
-            QSpinBox *spinBox = new QSpinBox;
-            spinBox->setObjectName(data[i]);
-            spinBox->setRange(mins[i], maxs[i]);
-            spinBox->setValue(defaultValues[i]);
-            label->setBuddy(spinBox);
+    QScopedPointer<QDialog> dialog(new QDialog);
+    QString data[3] = { "Tempo", "Numerator", "Denominator" };
+    int defaultValues[3] = { m_tempo, m_numerator, m_denominator };
+    int mins[3] = { 80, 1, 1 };
+    int maxs[3] = { 160, 64, 64 };
+
+    QVBoxLayout *layout = new QVBoxLayout(dialog.data());
+    QGridLayout *grid = new QGridLayout;
+    layout->addLayout(grid);
+    QDialogButtonBox *box = new QDialogButtonBox(dialog.data());
+    box->setOrientation(Qt::Horizontal);
+    box->setStandardButtons(QDialogButtonBox::Ok);
+
+    dialog.data()->connect(box, SIGNAL(accepted()), SLOT(accept()));
+
+    for (int i = 0; i < 3; ++i) {
+        QString caption = data[i];
+        caption.prepend('&');
+        QLabel *label = new QLabel(caption);
+        label->setAlignment(Qt::AlignRight);
+
+        QSpinBox *spinBox = new QSpinBox;
+        spinBox->setObjectName(data[i]);
+        spinBox->setRange(mins[i], maxs[i]);
+        spinBox->setValue(defaultValues[i]);
+        label->setBuddy(spinBox);
+
+        grid->addWidget(label, i, 0, Qt::AlignRight);
+        grid->addWidget(spinBox, i, 1, Qt::AlignRight);
+    }
 
-            grid->addWidget(label, i, 0, Qt::AlignRight);
-            grid->addWidget(spinBox, i, 1, Qt::AlignRight);
-        }
 
+    layout->addWidget(box);
 
-        layout->addWidget(box);
+    QSpinBox * temp = qFindChild<QSpinBox*>(dialog.data(), data[1]);
+    if (temp) temp->setFocus();
 
-        QSpinBox * temp = qFindChild<QSpinBox*>(dialog.data(), data[1]);
-        if (temp) temp->setFocus();
+    int code = dialog->exec();
 
-        int code = dialog->exec();
+    if (code == QDialog::Accepted) {
+        temp = qFindChild<QSpinBox*>(dialog.data(), data[0]);
+        if (temp) m_tempo = temp->value();
 
-        if (code == QDialog::Accepted) {
-            temp = qFindChild<QSpinBox*>(dialog.data(), data[0]);
-            if (temp) tempo = temp->value();
+        temp = qFindChild<QSpinBox*>(dialog.data(), data[1]);
+        if (temp) m_numerator = temp->value();
 
-            temp = qFindChild<QSpinBox*>(dialog.data(), data[1]);
-            if (temp) numerator = temp->value();
+        temp = qFindChild<QSpinBox*>(dialog.data(), data[2]);
+        if (temp) m_denominator = temp->value();
+    }
+}
 
-            temp = qFindChild<QSpinBox*>(dialog.data(), data[2]);
-            if (temp) denominator = temp->value();
-        }
+void MainWindow::slotPlay()
+{
+    askTimeSettings();
+
+    // Played straight from the detected notes by the system MIDI player,
+    // which starts in no time. The braille transcription has its own action.
+    const QString midiFile = QDir::current().filePath("play.mid");
+    if (Munip::StaffData::writeMidi(Munip::StaffData::transcribedNotes(),
+                                    m_tempo, m_numerator, m_denominator, midiFile)) {
+        QDesktopServices::openUrl(QUrl::fromLocalFile(midiFile));
     }
+}
 
-    Munip::StaffData::generateMusicXML(tempo, numerator, denominator);
+void MainWindow::slotTranscribeBraille()
+{
+    // Uses the tempo and time signature last chosen for playback.
+    Munip::StaffData::writeMusicXML(Munip::StaffData::transcribedNotes(),
+                                    m_tempo, m_numerator, m_denominator, "play.xml");
 
     QFile file(":/resources/play.html");
     file.open(QIODevice::ReadOnly);
@@ -402,13 +426,8 @@ void MainWindow::slotPlay()
     QDir().setCurrent(currentDir);
 
     QProcessEnvironment sysEnvironment = QProcessEnvironment::systemEnvironment();
-    QString processString = QString("java -jar \"%1\" -nw %2 \"%3/play.xml\"")
+    QString processString = QString("java -jar \"%1\" -nw \"%2/play.xml\"")
                             .arg(sysEnvironment.value("FREEDOTS", "freedots.jar"))
-#if defined(Q_OS_WIN32) || defined(Q_OS_MAC)
-                            .arg("")
-#else
-                            .arg("-p")
-#endif
                             .arg(QDir().currentPath());
     m_brailleTranscriptionProcess->start(processString);
     m_brailleView->setText("Transcription in progress");
@@ -39,6 +39,7 @@ public slots:
 
     void slotProjection();
     void slotPlay();
+    void slotTranscribeBraille();
 
     void slotAboutMunip();
 
@@ -53,6 +54,7 @@ private:
     void setup2ndTab();
     void setupActions();
     void applyStyle();
+    void askTimeSettings();
 
     QAction *m_showGridAction;
     QTabWidget *m_tabWidget;
@@ -61,6 +63,10 @@ private:
     QMdiArea *m_mdiArea;
     QProcess *m_brailleTranscriptionProcess;
 
+    int m_tempo;
+    int m_numerator;
+    int m_denominator;
+
     QLabel *m_coordinateLabel;
     static MainWindow* m_instance;
 };
@@ -0,0 +1,105 @@
+#include "processstepaction.h"
+
+#include "datawarehouse.h"
+#include "imagewidget.h"
+#include "mainwindow.h"
+#include "processstep.h"
+#include "tools.h"
+
+#include <QInputDialog>
+#include <QScopedPointer>
+#include <QTime>
+
+namespace Munip
+{
+    ProcessStepAction::ProcessStepAction(const QByteArray& className, const QIcon& icon, const QString& caption, QObject *parent) :
+        QAction(icon, caption, parent),
+        m_className(className)
+    {
+        if (caption.isEmpty()) {
+            setText(QString(className));
+        }
+        connect(this, SIGNAL(triggered()), this, SLOT(execute()));
+    }
+
+    QList<ProcessStepAction*> ProcessStepAction::actions(QObject *parent)
+    {
+        static QList<ProcessStepAction*> actions;
+        static QByteArray classes[] =
+        {
+            "MonoChromeConversion", "SkewCorrection", "StaffLineDetect",
+            "StaffLineRemoval", "SymbolAreaExtraction",
+            "StaffParamExtraction", "ImageCluster", "ImageRotation",
+            "GrayScaleConversion", "NewSkewCorrection"
+        };
+
+        if (actions.isEmpty()) {
+            int size = (int)((sizeof(classes))/(sizeof(QByteArray)));
+            for (int i = 0; i < size; ++i) {
+                ProcessStepAction *newAction = new ProcessStepAction(classes[i]);
+                newAction->setParent(parent);
+                actions << newAction;
+            }
+        }
+
+        return actions;
+    }
+
+    ProcessStep* ProcessStepAction::createStep(const QImage& image) const
+    {
+        if (m_className == QByteArray("ImageRotation")) {
+            bool ok;
+            qreal angle = QInputDialog::getDouble(0, tr("Angle"), tr("Enter rotation angle in degrees for image rotation"),
+                    5, -45, 45, 1, &ok);
+            if (!ok) {
+                angle = 5;
+            }
+            return new ImageRotation(image, angle);
+        }
+
+        if (m_className == QByteArray("ImageCluster")) {
+            bool ok;
+            int staffSpaceHeight =
+                QInputDialog::getInt(0, tr("Staff space height"),
+                        tr("Enter staff space height in pixels"),
+                        5, 0, 100, 1, &ok);
+            if (!ok) {
+                staffSpaceHeight = 5;
+            }
+            return new ImageCluster(image, staffSpaceHeight);
+        }
+
+        return ProcessStepFactory::create(m_className, image);
+    }
+
+    void ProcessStepAction::execute()
+    {
+        MainWindow *main = MainWindow::instance();
+        if (!main)
+            return;
+        ImageWidget *imgWidget = main->activeImageWidget();
+        if (!imgWidget)
+            return;
+        QScopedPointer<ProcessStep> step(createStep(imgWidget->image()));
+        if (step.isNull()) {
+            return;
+        }
+
+        if (step->failed()) {
+            MainWindow::instance()->slotStatusErrorMessage(step->failMessage());
+            return;
+        }
+
+        DataWarehouse::instance()->setWorkImage(imgWidget->image());
+        QTime timer;
+        timer.start();
+        step->process();
+        mDebug() << m_className << " : Took " << timer.elapsed() << " msecs";
+
+        ImageWidget *processed = new ImageWidget(step->processedImage());
+        processed->setWidgetID(IDGenerator::gen());
+        processed->setProcessorWidget(imgWidget);
+
+        main->addSubWindow(processed);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef PROCESSSTEPACTION_H
+#define PROCESSSTEPACTION_H
+
+#include <QAction>
+#include <QByteArray>
+#include <QList>
+
+class QIcon;
+class QImage;
+
+namespace Munip
+{
+    class ProcessStep;
+
+    /**
+     * Runs a process step, created by name through ProcessStepFactory, on
+     * the image of the active ImageWidget and shows the result in a new
+     * sub window. Parameters which the headless steps cannot figure out
+     * by themselves are asked for here.
+     */
+    class ProcessStepAction : public QAction
+    {
+        Q_OBJECT;
+    public:
+        ProcessStepAction(const QByteArray& className,
+                          const QIcon& icon = QIcon(),
+                          const QString& caption = QString(),
+                          QObject *parent = 0);
+
+        // One action for each process step shown in the GUI.
+        static QList<ProcessStepAction*> actions(QObject *parent = 0);
+
+    public Q_SLOTS:
+        void execute();
+
+    private:
+        ProcessStep* createStep(const QImage& image) const;
+
+        QByteArray m_className;
+    };
+}
+
+#endif // PROCESSSTEPACTION_H
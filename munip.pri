@@ -3,8 +3,7 @@ UI_DIR = .tmp
 RCC_DIR = .tmp
 OBJECTS_DIR = .tmp
 
-CONFIG += debug qtestlib
-QT += xml webkit
+CONFIG += debug
 win32 {
     CONFIG += console
 }
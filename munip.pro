@@ -1,11 +1,17 @@
 TEMPLATE = subdirs
 CONFIG += ordered
-SUBDIRS = sub_core sub_app sub_tests
+SUBDIRS = sub_core sub_gui sub_app sub_batch sub_tests
 
 sub_core.subdir = core
 
+sub_gui.subdir = gui
+sub_gui.depends = sub_core
+
 sub_app.subdir = app
-sub_app.depends = sub_core
+sub_app.depends = sub_core sub_gui
+
+sub_batch.subdir = batch
+sub_batch.depends = sub_core
 
 sub_tests.subdir = tests
 sub_tests.depends = sub_core
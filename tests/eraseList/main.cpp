@@ -0,0 +1,82 @@
+#include <QtTest/QtTest>
+
+#include "eraselist.h"
+
+#include <QPainter>
+
+using namespace Munip;
+
+class tst_EraseList : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void bitPlane();
+    void argbImage();
+
+private:
+    static void fillList(EraseList& erase);
+};
+
+// Overlapping, word crossing and partly outside shapes.
+void tst_EraseList::fillList(EraseList& erase)
+{
+    erase.addRect(QRect(10, 5, 100, 3));
+    erase.addRect(QRect(60, 6, 80, 10));
+    erase.addRect(QRect(-5, 30, 20, 4));
+    erase.addRect(QRect(190, 38, 30, 10));
+    erase.addVerticalRun(RunCoord(63, Run(20, 5)));
+    erase.addVerticalRun(RunCoord(64, Run(20, 5)));
+    erase.addVerticalRun(RunCoord(199, Run(45, 10)));
+}
+
+void tst_EraseList::bitPlane()
+{
+    BitPlane plane(200, 50);
+    plane.fill(true);
+    BitPlane expected = plane;
+
+    EraseList erase;
+    QVERIFY(erase.isEmpty());
+    fillList(erase);
+    erase.apply(plane);
+
+    expected.fillRect(QRect(10, 5, 100, 3), false);
+    expected.fillRect(QRect(60, 6, 80, 10), false);
+    expected.fillRect(QRect(-5, 30, 20, 4), false);
+    expected.fillRect(QRect(190, 38, 30, 10), false);
+    expected.fillRect(QRect(63, 20, 2, 6), false);
+    expected.fillRect(QRect(199, 45, 1, 5), false);
+
+    QVERIFY(plane == expected);
+}
+
+void tst_EraseList::argbImage()
+{
+    QImage image(200, 50, QImage::Format_ARGB32_Premultiplied);
+    image.fill(0xff000000);
+    QImage expected = image;
+
+    EraseList erase;
+    fillList(erase);
+    erase.apply(image);
+
+    // What the erase steps used to paint.
+    QPainter p(&expected);
+    p.setPen(Qt::NoPen);
+    p.setBrush(QColor(Qt::white));
+    p.drawRect(QRect(10, 5, 100, 3));
+    p.drawRect(QRect(60, 6, 80, 10));
+    p.drawRect(QRect(-5, 30, 20, 4));
+    p.drawRect(QRect(190, 38, 30, 10));
+    p.setPen(QColor(Qt::white));
+    p.setBrush(Qt::NoBrush);
+    p.drawLine(63, 20, 63, 25);
+    p.drawLine(64, 20, 64, 25);
+    p.drawLine(199, 45, 199, 55);
+    p.end();
+
+    QCOMPARE(image, expected);
+}
+
+QTEST_MAIN(tst_EraseList)
+#include "main.moc"
@@ -0,0 +1,58 @@
+#include <QtTest/QtTest>
+
+#include "midiwriter.h"
+
+using namespace Munip;
+
+class tst_MidiWriter : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void header();
+    void notes();
+    void invalidNotes();
+};
+
+static QByteArray bytes(const char *hex)
+{
+    return QByteArray::fromHex(hex);
+}
+
+void tst_MidiWriter::header()
+{
+    MidiWriter writer(120, 3, 8);
+    const QByteArray data = writer.data();
+
+    QVERIFY(data.startsWith(bytes("4d546864 00000006 0000 0001 01e0")));
+    QCOMPARE(data.mid(14, 4), QByteArray("MTrk"));
+    // 500000 us per quarter, 3/8, violin, end of track.
+    QCOMPARE(data.mid(22), bytes("00ff510307a120 00ff580403031808 00c028 00ff2f00"));
+    QCOMPARE(data.mid(18, 4), bytes("00000016"));
+}
+
+void tst_MidiWriter::notes()
+{
+    MidiWriter writer;
+    QVERIFY(writer.addNote("C", "4", "quarter"));
+    QVERIFY(writer.addChord(QList<QString>() << "A" << "E", QList<QString>() << "4" << "5", "whole"));
+    const QByteArray track = writer.data().mid(22 + 18);
+
+    // Middle C for 480 ticks, then A4 and E5 together for 1920 ticks,
+    // with variable length delta times.
+    QCOMPARE(track, bytes("00903c50 836080 3c40"
+                "00904550 00904c50 8f0080 4540 00804c40"
+                "00ff2f00"));
+}
+
+void tst_MidiWriter::invalidNotes()
+{
+    MidiWriter writer;
+    const QByteArray empty = writer.data();
+    QVERIFY(!writer.addNote("H", "4", "quarter"));
+    QVERIFY(!writer.addNote("C", "9", "quarter"));
+    QVERIFY(!writer.addNote("C", "4", "breve"));
+    QCOMPARE(writer.data(), empty);
+}
+
+QTEST_MAIN(tst_MidiWriter)
+#include "main.moc"
@@ -0,0 +1,243 @@
+#include <QtTest/QtTest>
+
+#include <climits>
+
+#include "bitplane.h"
+#include "components.h"
+#include "distancetransform.h"
+#include "morphology.h"
+#include "templatematcher.h"
+
+using Munip::BitPlane;
+using Munip::StructuringElement;
+
+Q_DECLARE_METATYPE(Munip::StructuringElement)
+
+class tst_Morphology : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void imageRoundTrip();
+
+    void dilateErode_data();
+    void dilateErode();
+    void hitOrMiss();
+    void thinning();
+    void distanceTransform();
+    void templateMatching();
+    void labelComponents();
+
+    void benchmarkDilate();
+    void benchmarkThinning();
+
+private:
+    static BitPlane randomPlane(int width, int height, int density);
+    static bool pixel(const BitPlane& plane, int x, int y) {
+        if (!plane.rect().contains(x, y)) return false;
+        return plane.testPixel(x, y);
+    }
+};
+
+BitPlane tst_Morphology::randomPlane(int width, int height, int density)
+{
+    BitPlane plane(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            plane.setPixel(x, y, (qrand() % 100) < density);
+        }
+    }
+    return plane;
+}
+
+void tst_Morphology::imageRoundTrip()
+{
+    qsrand(1);
+    const int widths[] = { 1, 63, 64, 65, 130 };
+    for (uint i = 0; i < sizeof(widths)/sizeof(int); ++i) {
+        const BitPlane plane = randomPlane(widths[i], 7, 40);
+        QCOMPARE(BitPlane::fromImage(plane.toImage()), plane);
+        QCOMPARE(BitPlane::fromImage(plane.toArgbImage()), plane);
+    }
+}
+
+void tst_Morphology::dilateErode_data()
+{
+    QTest::addColumn<StructuringElement>("se");
+
+    QTest::newRow("box 3x3") << StructuringElement::box(3, 3);
+    QTest::newRow("cross 2") << StructuringElement::cross(2);
+    QTest::newRow("disk 3") << StructuringElement::disk(3);
+
+    StructuringElement wide;
+    wide.add(-70, 0);
+    wide.add(65, 1);
+    QTest::newRow("wide") << wide;
+}
+
+void tst_Morphology::dilateErode()
+{
+    QFETCH(StructuringElement, se);
+
+    qsrand(2);
+    const BitPlane in = randomPlane(150, 20, 30);
+    const BitPlane dilated = Munip::dilate(in, se);
+    const BitPlane eroded = Munip::erode(in, se);
+
+    for (int y = 0; y < in.height(); ++y) {
+        for (int x = 0; x < in.width(); ++x) {
+            bool d = false, e = true;
+            foreach (const QPoint& b, se.points()) {
+                d = d || pixel(in, x - b.x(), y - b.y());
+                e = e && pixel(in, x + b.x(), y + b.y());
+            }
+            QCOMPARE(dilated.testPixel(x, y), d);
+            QCOMPARE(eroded.testPixel(x, y), e);
+        }
+    }
+}
+
+void tst_Morphology::hitOrMiss()
+{
+    // Isolated pixel detector.
+    const char * const rows[] = { "xxx", "x.x", "xxx" };
+    const StructuringElement misses = StructuringElement::fromPattern(rows, 3, QPoint(1, 1));
+    StructuringElement hits;
+    hits.add(0, 0);
+
+    BitPlane in(10, 10);
+    in.setPixel(0, 0, true);
+    in.setPixel(5, 5, true);
+    in.setPixel(6, 5, true);
+    in.setPixel(2, 8, true);
+
+    const BitPlane out = Munip::hitOrMiss(in, hits, misses);
+    QCOMPARE(out.count(), 2);
+    QVERIFY(out.testPixel(0, 0));
+    QVERIFY(out.testPixel(2, 8));
+}
+
+void tst_Morphology::thinning()
+{
+    BitPlane in(100, 40);
+    in.fillRect(QRect(10, 10, 80, 9), true);
+    in.fillRect(QRect(45, 0, 7, 40), true);
+
+    const BitPlane out = Munip::thinned(in);
+    QVERIFY(out.count() > 0);
+    QVERIFY(out.count() < in.count() / 5);
+
+    // Skeleton is a subset of the input and stays fixed under thinning.
+    BitPlane outside(out);
+    outside.subtract(in);
+    QCOMPARE(outside.count(), 0);
+    QCOMPARE(Munip::thinned(out), out);
+
+    // No 2x2 block of set pixels survives.
+    for (int y = 0; y + 1 < out.height(); ++y) {
+        for (int x = 0; x + 1 < out.width(); ++x) {
+            QVERIFY(!(out.testPixel(x, y) && out.testPixel(x + 1, y) &&
+                        out.testPixel(x, y + 1) && out.testPixel(x + 1, y + 1)));
+        }
+    }
+}
+
+void tst_Morphology::distanceTransform()
+{
+    qsrand(5);
+    const BitPlane in = randomPlane(70, 30, 80);
+    const Munip::DistanceMap map = Munip::distanceTransform(in);
+
+    for (int y = 0; y < in.height(); ++y) {
+        for (int x = 0; x < in.width(); ++x) {
+            // Brute force over all clear pixels including a one pixel
+            // frame outside the plane.
+            int expected = INT_MAX;
+            for (int v = -1; v <= in.height(); ++v) {
+                for (int u = -1; u <= in.width(); ++u) {
+                    if (!pixel(in, u, v)) {
+                        expected = qMin(expected, (u - x) * (u - x) + (v - y) * (v - y));
+                    }
+                }
+            }
+            QCOMPARE(map.squaredDistance(x, y), expected);
+        }
+    }
+
+    BitPlane disk(41, 41);
+    const StructuringElement se = StructuringElement::disk(12);
+    foreach (const QPoint& p, se.points()) {
+        disk.setPixel(20 + p.x(), 20 + p.y(), true);
+    }
+    const QList<QPoint> maxima = Munip::distanceTransform(disk).localMaxima(5);
+    QCOMPARE(maxima.size(), 1);
+    QCOMPARE(maxima.first(), QPoint(20, 20));
+}
+
+void tst_Morphology::templateMatching()
+{
+    qsrand(6);
+    const BitPlane shape = randomPlane(20, 10, 50);
+    BitPlane in = randomPlane(300, 60, 5);
+    for (int y = 0; y < shape.height(); ++y) {
+        for (int x = 0; x < shape.width(); ++x) {
+            in.setPixel(137 + x, 23 + y, shape.testPixel(x, y));
+        }
+    }
+
+    const Munip::TemplateMatcher matcher(in);
+    const Munip::BinaryTemplate tmpl("random", shape, .95);
+    QCOMPARE(matcher.score(tmpl, QPoint(137, 23), 0), qreal(1));
+    QCOMPARE(matcher.score(tmpl, QPoint(-5, -3), .99), qreal(-1));
+
+    const QList<Munip::TemplateMatch> matches = matcher.match(tmpl, in.rect());
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches.first().rect, QRect(137, 23, 20, 10));
+}
+
+void tst_Morphology::labelComponents()
+{
+    const char * const rows[] = {
+        "xx..x..",
+        "x...x.x",
+        ".x....x",
+        "...x...",
+    };
+    BitPlane in(7, 4);
+    foreach (const QPoint& p, StructuringElement::fromPattern(rows, 4, QPoint(0, 0)).points()) {
+        in.setPixel(p.x(), p.y(), true);
+    }
+
+    QVector<int> labels;
+    QCOMPARE(Munip::labelComponents(in, &labels, true), 4);
+    QCOMPARE(labels[2 * 7 + 1], labels[0]);
+    QCOMPARE(labels[1 * 7 + 6], labels[2 * 7 + 6]);
+    QCOMPARE(labels[3 * 7 + 3], 3);
+    QCOMPARE(labels[0 * 7 + 2], -1);
+
+    QCOMPARE(Munip::labelComponents(in, 0, false), 5);
+}
+
+void tst_Morphology::benchmarkDilate()
+{
+    qsrand(3);
+    const BitPlane in = randomPlane(2500, 3500, 10);
+    const StructuringElement se = StructuringElement::box(3, 3);
+    QBENCHMARK {
+        Munip::dilate(in, se);
+    }
+}
+
+void tst_Morphology::benchmarkThinning()
+{
+    qsrand(4);
+    BitPlane in(5000, 7000);
+    for (int i = 0; i < 20000; ++i) {
+        in.fillRect(QRect(qrand() % 5000, qrand() % 7000, 1 + qrand() % 60, 1 + qrand() % 12), true);
+    }
+    QBENCHMARK {
+        Munip::thinned(in);
+    }
+}
+
+QTEST_MAIN(tst_Morphology)
+#include "main.moc"
@@ -0,0 +1,6 @@
+TEMPLATE = app
+CONFIG += qtestlib
+TARGET = morphologyTest
+SOURCES += main.cpp
+LIBS += -lcore
+include(../../munip.pri)
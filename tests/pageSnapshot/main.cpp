@@ -0,0 +1,143 @@
+#include <QtTest/QtTest>
+
+#include "pagecontext.h"
+#include "pagesnapshot.h"
+#include "symbol.h"
+
+#include <QDir>
+
+using namespace Munip;
+
+class tst_PageSnapshot : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void roundTrip();
+    void corruptFile();
+
+private:
+    static QString tempFile();
+};
+
+QString tst_PageSnapshot::tempFile()
+{
+    return QDir::temp().filePath(
+            QString("munip-snapshot-%1.snapshot").arg(QCoreApplication::applicationPid()));
+}
+
+void tst_PageSnapshot::roundTrip()
+{
+    PageContext context;
+    context.setPageSkew(1.5f);
+    context.setPageSkewPrecision(0.25f);
+    context.setStaffSpaceHeight(Range(9, 11));
+    context.setStaffLineHeight(Range(2, 3));
+
+    StaffLine line(QPoint(10, 20), QPoint(190, 21));
+    line.addSegment(Segment(QPoint(10, 20), QPoint(100, 20)));
+    line.addSegment(Segment(QPoint(101, 21), QPoint(190, 21)));
+    Staff staff(QPoint(10, 20), QPoint(10, 60));
+    staff.addStaffLine(line);
+    staff.setBoundingRect(QRect(0, 0, 200, 80));
+    staff.constructStaffBoundingRect();
+    context.appendStaff(staff);
+
+    QImage image(200, 80, QImage::Format_Mono);
+    image.fill(0);
+    StaffData *sd = new StaffData(image, staff, StaffParams::fromPageContext(&context));
+    sd->symbolRects << QRect(30, 10, 12, 40);
+
+    // A chord of two note heads sharing one stem, flagged on the right.
+    NoteSegment *chord = NoteSegment::create(sd->arena);
+    chord->boundingRect = QRect(30, 10, 12, 40);
+    chord->noteRects << QRect(30, 30, 12, 9) << QRect(30, 40, 12, 9);
+    chord->isNoteHeadFilled = true;
+    StemSegment *stem = StemSegment::create(sd->arena);
+    stem->boundingRect = QRect(41, 10, 2, 38);
+    stem->noteSegment = chord;
+    stem->rightFlagCount = 1;
+    stem->flagRunCoords << RunCoord(43, Run(10, 4));
+    chord->stemSegment = stem;
+    sd->noteSegments << chord;
+
+    sd->beamsRunCoords << (QList<RunCoord>() << RunCoord(50, Run(8, 3)) << RunCoord(51, Run(8, 3)));
+    sd->buildSymbolGraph();
+    context.setStaffDatas(QList<StaffData*>() << sd);
+
+    PageSnapshot saved = PageSnapshot::fromPageContext(&context);
+    QVERIFY(saved.save(tempFile()));
+
+    PageSnapshot loaded;
+    QVERIFY(loaded.load(tempFile()));
+    QFile::remove(tempFile());
+
+    QCOMPARE(loaded.pageSkew, 1.5f);
+    QCOMPARE(loaded.pageSkewPrecision, 0.25f);
+    QCOMPARE(loaded.staffSpaceHeight.max, 11);
+    QCOMPARE(loaded.staffLineHeight.min, 2);
+
+    QCOMPARE(loaded.staves.size(), 1);
+    const Staff& s = loaded.staves.first();
+    QCOMPARE(s.boundingRect(), staff.boundingRect());
+    QCOMPARE(s.staffBoundingRect(), staff.staffBoundingRect());
+    QCOMPARE(s.staffLines().size(), 1);
+    const QList<Segment> segments = s.staffLines().first().segments();
+    QCOMPARE(segments.size(), 2);
+    QCOMPARE(segments[1].startPos(), QPoint(101, 21));
+    QCOMPARE(segments[1].endPos(), QPoint(190, 21));
+
+    QCOMPARE(loaded.staffSymbols.size(), 1);
+    QCOMPARE(loaded.staffSymbols[0].symbolRectCount, 1);
+    QCOMPARE(loaded.staffSymbols[0].noteCount, 1);
+    QCOMPARE(loaded.staffSymbols[0].hollowNoteCount, 0);
+    QCOMPARE(loaded.staffSymbols[0].beamCount, 1);
+
+    const PageSnapshot::NoteRecord& note = loaded.notes[loaded.staffSymbols[0].firstNote];
+    QCOMPARE(PageSnapshot::toRect(note.boundingRect), chord->boundingRect);
+    QCOMPARE(note.noteRectCount, 2);
+    QCOMPARE(PageSnapshot::toRect(loaded.noteRects[note.firstNoteRect + 1]), QRect(30, 40, 12, 9));
+    QCOMPARE(note.isNoteHeadFilled, 1);
+
+    QVERIFY(note.stem >= 0);
+    const PageSnapshot::StemRecord& s2 = loaded.stems[note.stem];
+    QCOMPARE(PageSnapshot::toRect(s2.boundingRect), stem->boundingRect);
+    QCOMPARE(s2.rightFlagCount, 1);
+    QCOMPARE(s2.flagRunCount, 1);
+    QVERIFY(PageSnapshot::toRunCoord(loaded.runs[s2.firstFlagRun]) == RunCoord(43, Run(10, 4)));
+
+    const PageSnapshot::BeamRecord& beam = loaded.beams[loaded.staffSymbols[0].firstBeam];
+    QCOMPARE(beam.runCount, 2);
+    QVERIFY(PageSnapshot::toRunCoord(loaded.runs[beam.firstRun + 1]) == RunCoord(51, Run(8, 3)));
+
+    PageContext restored;
+    loaded.restore(&restored);
+    QCOMPARE(restored.pageSkew(), 1.5f);
+    QCOMPARE(restored.staffList().size(), 1);
+}
+
+void tst_PageSnapshot::corruptFile()
+{
+    PageContext context;
+    PageSnapshot snapshot = PageSnapshot::fromPageContext(&context);
+    QVERIFY(snapshot.save(tempFile()));
+
+    QFile file(tempFile());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray data = file.readAll();
+    file.close();
+
+    // Cut off in the middle of the section table.
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(data.left(40));
+    file.close();
+
+    PageSnapshot loaded;
+    QVERIFY(!loaded.load(tempFile()));
+    QVERIFY(!loaded.errorMessage().isEmpty());
+
+    QVERIFY(!loaded.load(QDir::temp().filePath("munip-no-such.snapshot")));
+    QFile::remove(tempFile());
+}
+
+QTEST_MAIN(tst_PageSnapshot)
+#include "main.moc"
@@ -0,0 +1,6 @@
+TEMPLATE = app
+CONFIG += qtestlib
+TARGET = pageSnapshotTest
+SOURCES += main.cpp
+LIBS += -lcore
+include(../../munip.pri)
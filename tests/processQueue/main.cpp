@@ -0,0 +1,250 @@
+#include <QtTest/QtTest>
+
+#include "processstep.h"
+
+#include <QDir>
+
+// Flips its input upside down, unless told otherwise, and counts how
+// often it ran.
+class CountingStep : public Munip::ProcessStep
+{
+Q_OBJECT
+Q_PROPERTY(bool flip READ flip WRITE setFlip)
+public:
+    CountingStep(const QImage& image) : Munip::ProcessStep(image), m_flip(true) {}
+
+    virtual void process() {
+        emit started();
+        ++runs;
+        m_processedImage = m_flip ? m_originalImage.mirrored() : m_originalImage;
+        emit ended();
+    }
+
+    bool flip() const { return m_flip; }
+    void setFlip(bool flip) { m_flip = flip; }
+
+    static int runs;
+
+private:
+    bool m_flip;
+};
+
+int CountingStep::runs = 0;
+
+static Munip::ProcessStep* createCountingStep(const QImage& image)
+{
+    return new CountingStep(image);
+}
+
+class tst_ProcessQueue : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void init();
+
+    void dependencyOrder();
+    void cachedResults();
+    void releasedResults();
+    void parameterChange();
+    void diskCache();
+    void invalidGraph();
+
+private:
+    static QImage testImage();
+};
+
+void tst_ProcessQueue::init()
+{
+    CountingStep::runs = 0;
+}
+
+QImage tst_ProcessQueue::testImage()
+{
+    QImage img(4, 3, QImage::Format_ARGB32);
+    for (int y = 0; y < img.height(); ++y) {
+        for (int x = 0; x < img.width(); ++x) {
+            img.setPixel(x, y, qRgb(x * 60, y * 100, 0));
+        }
+    }
+    return img;
+}
+
+void tst_ProcessQueue::dependencyOrder()
+{
+    Munip::ProcessQueue queue;
+    queue.setResult("page", testImage());
+    // Added in reverse, b is shared by c and d.
+    queue.addStage("d", createCountingStep, "b");
+    queue.addStage("c", createCountingStep, "b");
+    queue.addStage("b", createCountingStep, "page");
+    queue.keepResult("c");
+    queue.keepResult("d");
+
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 3);
+
+    const QList<QPair<QString, int> > times = queue.stageTimes();
+    QCOMPARE(times.size(), 3);
+    QCOMPARE(times[0].first, QString("b"));
+    QCOMPARE(times[1].first, QString("d"));
+    QCOMPARE(times[2].first, QString("c"));
+
+    QVERIFY(queue.result("c") == testImage());
+    QVERIFY(queue.result("d") == testImage());
+}
+
+void tst_ProcessQueue::cachedResults()
+{
+    Munip::ProcessQueue queue;
+    queue.setResult("page", testImage());
+    queue.addStage("b", createCountingStep, "page");
+    queue.addStage("c", createCountingStep, "b");
+    queue.keepResult("b");
+    queue.keepResult("c");
+
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 2);
+
+    // Nothing left to do.
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 2);
+    QVERIFY(queue.stageTimes().isEmpty());
+
+    // A new branch reuses b.
+    queue.addStage("e", createCountingStep, "b");
+    queue.keepResult("e");
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 3);
+    QVERIFY(queue.result("e") == testImage());
+
+    // A new input reruns everything depending on it.
+    queue.setResult("page", testImage().mirrored(true, false));
+    QVERIFY(!queue.hasResult("c"));
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 6);
+    QVERIFY(queue.result("c") == testImage().mirrored(true, false));
+}
+
+void tst_ProcessQueue::releasedResults()
+{
+    Munip::ProcessQueue queue;
+    queue.setResult("page", testImage());
+    queue.addStage("b", createCountingStep, "page");
+    queue.addStage("c", createCountingStep, "b");
+    queue.keepResult("c");
+
+    QVERIFY(queue.execute());
+    QVERIFY(queue.hasResult("page"));
+    QVERIFY(!queue.hasResult("b"));
+    QVERIFY(queue.hasResult("c"));
+
+    // b has to be recomputed for a new stage reading it.
+    queue.addStage("e", createCountingStep, "b", QStringList() << "c");
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 4);
+    QVERIFY(!queue.hasResult("e"));
+}
+
+void tst_ProcessQueue::parameterChange()
+{
+    Munip::ProcessQueue queue;
+    queue.setResult("page", testImage());
+    queue.addStage("b", createCountingStep, "page");
+    queue.addStage("c", createCountingStep, "b");
+    queue.addStage("d", createCountingStep, "c");
+    queue.keepResult("d");
+    QVERIFY(queue.setParameter("c", "flip", true));
+    QVERIFY(!queue.setParameter("x", "flip", true));
+
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 3);
+    // b is the input of a stage with parameters and stays cached.
+    QVERIFY(queue.hasResult("b"));
+    QVERIFY(queue.result("d") == testImage().mirrored());
+
+    // Same value, nothing to do.
+    QVERIFY(queue.setParameter("c", "flip", true));
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 3);
+
+    // Only c and d run again.
+    QVERIFY(queue.setParameter("c", "flip", false));
+    QVERIFY(!queue.hasResult("d"));
+    QVERIFY(queue.execute());
+    QCOMPARE(CountingStep::runs, 5);
+    QCOMPARE(queue.stageTimes().size(), 2);
+    QCOMPARE(queue.stageTimes().first().first, QString("c"));
+    QVERIFY(queue.result("d") == testImage());
+    QCOMPARE(queue.parameter("c", "flip").toBool(), false);
+
+    QVERIFY(queue.setParameter("d", "noSuchParameter", 1));
+    QVERIFY(!queue.execute());
+}
+
+void tst_ProcessQueue::diskCache()
+{
+    const QString dirName = QDir::temp().filePath(
+            QString("munip-stagecache-%1").arg(QCoreApplication::applicationPid()));
+    const QImage mono = testImage().convertToFormat(QImage::Format_Mono);
+
+    for (int run = 0; run < 2; ++run) {
+        CountingStep::runs = 0;
+        Munip::ProcessQueue queue;
+        queue.setCacheDirectory(dirName);
+        queue.setResult("page", testImage());
+        queue.setResult("monoPage", mono);
+        queue.addStage("b", createCountingStep, "page", QStringList(), "CountingStep");
+        queue.addStage("c", createCountingStep, "b", QStringList(), "CountingStep");
+        queue.addStage("m", createCountingStep, "monoPage", QStringList(), "CountingStep");
+        // Without a cache id, a creator stage is never cached.
+        queue.addStage("u", createCountingStep, "page");
+        queue.keepResult("c");
+        queue.keepResult("m");
+        queue.keepResult("u");
+
+        // The second queue finds everything else on disk.
+        QVERIFY(queue.execute());
+        QCOMPARE(CountingStep::runs, run ? 1 : 4);
+        QCOMPARE(queue.cacheHits().size(), run ? 3 : 0);
+        QVERIFY(!queue.cacheHits().contains("u"));
+        QVERIFY(queue.result("c") == testImage());
+        QVERIFY(queue.result("m").convertToFormat(QImage::Format_RGB32) ==
+                mono.mirrored().convertToFormat(QImage::Format_RGB32));
+
+        // A parameter is part of the key.
+        QVERIFY(queue.setParameter("c", "flip", false));
+        QVERIFY(queue.execute());
+        QCOMPARE(CountingStep::runs, run ? 1 : 5);
+        QCOMPARE(queue.cacheHits(), run ? QStringList("c") : QStringList());
+        QVERIFY(queue.result("c") == testImage().mirrored());
+    }
+
+    QDir dir(dirName);
+    foreach (const QString& file, dir.entryList(QDir::Files)) {
+        dir.remove(file);
+    }
+    QDir::temp().rmdir(dirName);
+}
+
+void tst_ProcessQueue::invalidGraph()
+{
+    Munip::ProcessQueue missing;
+    missing.addStage("b", createCountingStep, "page");
+    QVERIFY(!missing.execute());
+    QVERIFY(!missing.errorMessage().isEmpty());
+
+    Munip::ProcessQueue cycle;
+    cycle.setResult("page", testImage());
+    cycle.addStage("b", createCountingStep, "page", QStringList() << "c");
+    cycle.addStage("c", createCountingStep, "b");
+    QVERIFY(!cycle.execute());
+
+    Munip::ProcessQueue unknown;
+    unknown.setResult("page", testImage());
+    unknown.addStage("b", QByteArray("NoSuchStep"), "page");
+    QVERIFY(!unknown.execute());
+    QCOMPARE(CountingStep::runs, 0);
+}
+
+QTEST_MAIN(tst_ProcessQueue)
+#include "main.moc"
@@ -0,0 +1,83 @@
+#include <QtTest/QtTest>
+
+#include "tools.h"
+
+using namespace Munip;
+
+class tst_RunlengthImage : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void runIds();
+    void adjacentRunIds();
+    void runCoordHash();
+
+private:
+    static QImage randomImage(int width, int height);
+};
+
+QImage tst_RunlengthImage::randomImage(int width, int height)
+{
+    QImage image(width, height, QImage::Format_ARGB32);
+    image.fill(0xffffffff);
+    qsrand(7);
+    for (int x = 0; x < width; ++x) {
+        for (int y = 0; y < height; ++y) {
+            if (qrand() % 2) {
+                image.setPixel(x, y, 0xff000000);
+            }
+        }
+    }
+    return image;
+}
+
+void tst_RunlengthImage::runIds()
+{
+    const VerticalRunlengthImage image(randomImage(20, 30));
+
+    int id = 0;
+    for (int x = 0; x < 20; ++x) {
+        foreach (const Run& run, image.runsForColumn(x)) {
+            QVERIFY(image.runCoord(id) == RunCoord(x, run));
+            ++id;
+        }
+    }
+    QCOMPARE(image.runCount(), id);
+    QVERIFY(!image.runCoord(id).isValid());
+    QVERIFY(!image.runCoord(-1).isValid());
+}
+
+void tst_RunlengthImage::adjacentRunIds()
+{
+    const VerticalRunlengthImage image(randomImage(20, 30));
+
+    for (int id = 0; id < image.runCount(); ++id) {
+        const RunCoord runCoord = image.runCoord(id);
+
+        const QList<Run> next = image.adjacentRunsInNextColumn(runCoord);
+        int first, last;
+        image.adjacentRunIds(runCoord.pos + 1, runCoord.run, &first, &last);
+        QCOMPARE(last - first, next.size());
+        for (int i = 0; i < next.size(); ++i) {
+            QVERIFY(image.runCoord(first + i) == RunCoord(runCoord.pos + 1, next[i]));
+        }
+
+        const QList<Run> previous = image.adjacentRunsInPreviousColumn(runCoord);
+        image.adjacentRunIds(runCoord.pos - 1, runCoord.run, &first, &last);
+        QCOMPARE(last - first, previous.size());
+        for (int i = 0; i < previous.size(); ++i) {
+            QVERIFY(image.runCoord(first + i) == RunCoord(runCoord.pos - 1, previous[i]));
+        }
+    }
+}
+
+void tst_RunlengthImage::runCoordHash()
+{
+    // These all collided, as did any two coordinates apart by 4000.
+    QVERIFY(qHash(RunCoord(1, Run(0, 1))) != qHash(RunCoord(0, Run(1, 1))));
+    QVERIFY(qHash(RunCoord(2, Run(1, 5))) != qHash(RunCoord(1, Run(2, 5))));
+    QVERIFY(qHash(RunCoord(0, Run(1, 3))) != qHash(RunCoord(0, Run(0, 4003))));
+}
+
+QTEST_MAIN(tst_RunlengthImage)
+#include "main.moc"
@@ -1,4 +1,5 @@
 TEMPLATE = app
+CONFIG += qtestlib
 TARGET = skewDetectionTest
 SOURCES += main.cpp
 LIBS += -lcore
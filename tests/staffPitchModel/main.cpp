@@ -0,0 +1,102 @@
+#include <QtTest/QtTest>
+
+#include "staffpitchmodel.h"
+
+using namespace Munip;
+
+class tst_StaffPitchModel : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void straightStaff();
+    void slantedStaff();
+    void bassClef();
+    void brokenLine();
+
+private:
+    // Five lines ten pixels apart, rising by slope pixels over the width.
+    static Staff makeStaff(int slope);
+};
+
+Staff tst_StaffPitchModel::makeStaff(int slope)
+{
+    Staff staff(QPoint(0, 20), QPoint(0, 60 + slope));
+    for (int i = 0; i < 5; ++i) {
+        const QPoint start(0, 20 + 10 * i);
+        const QPoint end(199, 20 + 10 * i + slope);
+        StaffLine line(start, end);
+        line.addSegment(Segment(start, end));
+        staff.addStaffLine(line);
+    }
+    staff.setBoundingRect(QRect(0, 0, 200, 100));
+    return staff;
+}
+
+static QString noteOctave(const StaffPitchModel& model, int x, int y)
+{
+    const QPair<char, int> p = model.noteOctaveAt(x, y);
+    return QString(QChar(p.first)) + QString::number(p.second);
+}
+
+void tst_StaffPitchModel::straightStaff()
+{
+    // Half a space plus half a line: 4 + 1.
+    const StaffPitchModel model(makeStaff(0), Range(8, 8), Range(2, 2));
+
+    QCOMPARE(noteOctave(model, 50, 20), QString("F5"));
+    QCOMPARE(noteOctave(model, 50, 25), QString("E5"));
+    QCOMPARE(noteOctave(model, 50, 40), QString("B4"));
+    QCOMPARE(noteOctave(model, 50, 60), QString("E4"));
+    QCOMPARE(noteOctave(model, 50, 65), QString("D4"));
+    QCOMPARE(noteOctave(model, 50, 70), QString("C4"));
+    QCOMPARE(noteOctave(model, 50, 15), QString("G5"));
+    QCOMPARE(noteOctave(model, 50, 10), QString("A5"));
+
+    // In between, the nearer position wins.
+    QCOMPARE(noteOctave(model, 50, 22), QString("F5"));
+    QCOMPARE(noteOctave(model, 50, 23), QString("E5"));
+
+    // Far outside the staff the outermost positions are returned.
+    QCOMPARE(noteOctave(model, 50, -200), QString("C7"));
+    QCOMPARE(noteOctave(model, 50, 400), QString("A2"));
+}
+
+void tst_StaffPitchModel::slantedStaff()
+{
+    const StaffPitchModel model(makeStaff(10), Range(8, 8), Range(2, 2));
+
+    QCOMPARE(noteOctave(model, 0, 30), QString("D5"));
+    QCOMPARE(noteOctave(model, 199, 30), QString("F5"));
+    QCOMPARE(noteOctave(model, 400, 30), QString("F5"));
+}
+
+void tst_StaffPitchModel::bassClef()
+{
+    const StaffPitchModel model(makeStaff(0), Range(8, 8), Range(2, 2), BassClef);
+
+    QCOMPARE(noteOctave(model, 50, 20), QString("A3"));
+    QCOMPARE(noteOctave(model, 50, 40), QString("D3"));
+    QCOMPARE(noteOctave(model, 50, 60), QString("G2"));
+    QCOMPARE(noteOctave(model, 50, 10), QString("C4"));
+    QCOMPARE(noteOctave(model, 50, -200), QString("E5"));
+}
+
+void tst_StaffPitchModel::brokenLine()
+{
+    // The top line is only found in two pieces, the gap is bridged.
+    Staff staff(QPoint(0, 20), QPoint(0, 60));
+    StaffLine top(QPoint(0, 20), QPoint(199, 30));
+    top.addSegment(Segment(QPoint(0, 20), QPoint(49, 20)));
+    top.addSegment(Segment(QPoint(150, 30), QPoint(199, 30)));
+    staff.addStaffLine(top);
+    staff.setBoundingRect(QRect(0, 0, 200, 100));
+
+    const StaffPitchModel model(staff, Range(8, 8), Range(2, 2));
+    QCOMPARE(noteOctave(model, 10, 20), QString("F5"));
+    QCOMPARE(noteOctave(model, 100, 25), QString("F5"));
+    QCOMPARE(noteOctave(model, 190, 30), QString("F5"));
+    QCOMPARE(noteOctave(model, 190, 35), QString("E5"));
+}
+
+QTEST_MAIN(tst_StaffPitchModel)
+#include "main.moc"
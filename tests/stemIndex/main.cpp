@@ -0,0 +1,60 @@
+#include <QtTest/QtTest>
+
+#include "symbol.h"
+
+using namespace Munip;
+
+class tst_StemIndex : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void empty();
+    void matchesLinearScan();
+};
+
+void tst_StemIndex::empty()
+{
+    StemIndex index;
+    index.build(QList<NoteSegment*>(), QMargins());
+    QVERIFY(index.stemAt(QRect(0, 0, 10, 10)) == 0);
+}
+
+void tst_StemIndex::matchesLinearScan()
+{
+    SymbolArena arena;
+    QList<NoteSegment*> notes;
+    qsrand(3);
+    for (int i = 0; i < 200; ++i) {
+        NoteSegment *note = NoteSegment::create(arena);
+        // Some notes have no stem, and some stems overlap.
+        if (i % 5) {
+            StemSegment *stem = StemSegment::create(arena);
+            stem->boundingRect = QRect(qrand() % 2000, qrand() % 80, 1 + qrand() % 4, 10 + qrand() % 40);
+            stem->noteSegment = note;
+            note->stemSegment = stem;
+        }
+        notes << note;
+    }
+
+    const QMargins margins(2, 1, 0, 2);
+    StemIndex index;
+    index.build(notes, margins);
+
+    for (int x = -5; x < 2010; ++x) {
+        const QRect runRect(x, qrand() % 100, 1, 1 + qrand() % 10);
+
+        StemSegment *expected = 0;
+        foreach (NoteSegment *note, notes) {
+            if (note->stemSegment && note->stemSegment->boundingRect.adjusted(
+                        -margins.left(), -margins.top(), margins.right(), margins.bottom())
+                    .intersects(runRect)) {
+                expected = note->stemSegment;
+                break;
+            }
+        }
+        QVERIFY(index.stemAt(runRect) == expected);
+    }
+}
+
+QTEST_MAIN(tst_StemIndex)
+#include "main.moc"
@@ -1,4 +1,5 @@
 TEMPLATE = app
+CONFIG += qtestlib
 TARGET = symbolDetectionTest
 SOURCES += main.cpp
 LIBS += -lcore
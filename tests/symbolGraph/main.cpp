@@ -0,0 +1,103 @@
+#include <QtTest/QtTest>
+
+#include "staffpitchmodel.h"
+#include "symbol.h"
+
+using namespace Munip;
+
+class tst_SymbolGraph : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void links();
+    void transcription();
+
+private:
+    // A chord of two heads with a flagged stem, a hollow whole note left
+    // of it, and one beam.
+    static SymbolGraph makeGraph(SymbolArena& arena);
+};
+
+SymbolGraph tst_SymbolGraph::makeGraph(SymbolArena& arena)
+{
+    NoteSegment *chord = NoteSegment::create(arena);
+    chord->boundingRect = QRect(60, 0, 20, 100);
+    chord->noteRects << QRect(60, 15, 20, 10) << QRect(60, 35, 20, 10);
+    chord->isNoteHeadFilled = true;
+    StemSegment *stem = StemSegment::create(arena);
+    stem->boundingRect = QRect(79, 0, 2, 40);
+    stem->noteSegment = chord;
+    stem->rightFlagCount = 1;
+    stem->flagRunCoords << RunCoord(81, Run(2, 4));
+    chord->stemSegment = stem;
+
+    NoteSegment *whole = NoteSegment::create(arena);
+    whole->boundingRect = QRect(10, 0, 20, 100);
+    whole->noteRects << QRect(10, 55, 20, 10);
+
+    QList<QList<RunCoord> > beams;
+    beams << (QList<RunCoord>() << RunCoord(90, Run(5, 3)) << RunCoord(91, Run(5, 3)));
+
+    return SymbolGraph::fromSegments(QList<NoteSegment*>() << chord,
+            QList<NoteSegment*>() << whole, beams);
+}
+
+void tst_SymbolGraph::links()
+{
+    SymbolArena arena;
+    const SymbolGraph graph = makeGraph(arena);
+
+    QCOMPARE(graph.notes.size(), 2);
+    QCOMPARE(graph.filledNoteCount, 1);
+    QCOMPARE(graph.heads.size(), 3);
+
+    const SymbolGraph::Note& chord = graph.notes[0];
+    QCOMPARE(chord.headCount, 2);
+    QCOMPARE(graph.heads[chord.firstHead + 1], QRect(60, 35, 20, 10));
+    QCOMPARE(chord.stem, 0);
+    QCOMPARE(graph.stems.size(), 1);
+    QCOMPARE(graph.stems[0].note, 0);
+    QCOMPARE(graph.stems[0].flagRunCount, 1);
+    QVERIFY(graph.flagRuns[graph.stems[0].firstFlagRun] == RunCoord(81, Run(2, 4)));
+    QCOMPARE(graph.stems[0].partialBeamRunCount, 0);
+
+    QCOMPARE(graph.notes[1].stem, -1);
+    QVERIFY(!graph.notes[1].isNoteHeadFilled);
+
+    QCOMPARE(graph.beams.size(), 1);
+    QCOMPARE(graph.beams[0].runCount, 2);
+    QVERIFY(graph.beamRuns[graph.beams[0].firstRun + 1] == RunCoord(91, Run(5, 3)));
+
+    QCOMPARE(graph.denominator(0), 8);
+    QCOMPARE(graph.denominator(1), 1);
+    QCOMPARE(graph.readingOrder(), QVector<int>() << 1 << 0);
+}
+
+void tst_SymbolGraph::transcription()
+{
+    SymbolArena arena;
+    const SymbolGraph graph = makeGraph(arena);
+
+    Staff staff(QPoint(0, 20), QPoint(0, 60));
+    for (int i = 0; i < 5; ++i) {
+        StaffLine line(QPoint(0, 20 + 10 * i), QPoint(199, 20 + 10 * i));
+        line.addSegment(Segment(line.startPos(), line.endPos()));
+        staff.addStaffLine(line);
+    }
+    staff.setBoundingRect(QRect(0, 0, 200, 100));
+    const StaffPitchModel model(staff, Range(8, 8), Range(2, 2));
+
+    const QList<NoteInfo> chord = graph.chordInfo(0, model);
+    QCOMPARE(chord.size(), 2);
+    QCOMPARE(chord[0].step + chord[0].octave, QString("F5"));
+    QCOMPARE(chord[1].step + chord[1].octave, QString("B4"));
+    QCOMPARE(chord[0].type, QString("eighth"));
+
+    const QList<NoteInfo> whole = graph.chordInfo(1, model);
+    QCOMPARE(whole.size(), 1);
+    QCOMPARE(whole[0].step + whole[0].octave, QString("E4"));
+    QCOMPARE(whole[0].type, QString("whole"));
+}
+
+QTEST_MAIN(tst_SymbolGraph)
+#include "main.moc"
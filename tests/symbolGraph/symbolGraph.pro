@@ -0,0 +1,6 @@
+TEMPLATE = app
+CONFIG += qtestlib
+TARGET = symbolGraphTest
+SOURCES += main.cpp
+LIBS += -lcore
+include(../../munip.pri)
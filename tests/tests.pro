@@ -3,3 +3,13 @@ TEMPLATE = subdirs
 # Directories
 SUBDIRS += skewDetection
 SUBDIRS += symbolDetection
+SUBDIRS += morphology
+SUBDIRS += processQueue
+SUBDIRS += pageSnapshot
+SUBDIRS += zipWriter
+SUBDIRS += midiWriter
+SUBDIRS += staffPitchModel
+SUBDIRS += symbolGraph
+SUBDIRS += runlengthImage
+SUBDIRS += stemIndex
+SUBDIRS += eraseList
@@ -0,0 +1,171 @@
+#include <QtTest/QtTest>
+
+#include "zipwriter.h"
+
+#include <QBuffer>
+
+using namespace Munip;
+
+struct Member
+{
+    QByteArray name;
+    int method;
+    quint32 crc;
+    QByteArray data; // as stored in the archive
+};
+
+class tst_ZipWriter : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void crc();
+    void deflate_data();
+    void deflate();
+    void storedMembers();
+
+private:
+    static QList<Member> readArchive(const QByteArray& archive);
+    static QByteArray zlibStream(const QByteArray& deflated, const QByteArray& expected);
+};
+
+static quint32 read16(const QByteArray& data, int pos)
+{
+    return uchar(data[pos]) | (uchar(data[pos + 1]) << 8);
+}
+
+static quint32 read32(const QByteArray& data, int pos)
+{
+    return read16(data, pos) | (read16(data, pos + 2) << 16);
+}
+
+// Walks the central directory, which follows the last member.
+QList<Member> tst_ZipWriter::readArchive(const QByteArray& archive)
+{
+    QList<Member> retval;
+    const int end = archive.size() - 22;
+    if (end < 0 || read32(archive, end) != 0x06054b50) {
+        return retval;
+    }
+
+    int pos = read32(archive, end + 16);
+    const int count = read16(archive, end + 10);
+    for (int i = 0; i < count; ++i) {
+        Member member;
+        member.method = read16(archive, pos + 10);
+        member.crc = read32(archive, pos + 16);
+        const int compressedSize = read32(archive, pos + 20);
+        const int nameLength = read16(archive, pos + 28);
+        const int offset = read32(archive, pos + 42);
+        member.name = archive.mid(pos + 46, nameLength);
+
+        const int dataStart = offset + 30 + read16(archive, offset + 26) + read16(archive, offset + 28);
+        member.data = archive.mid(dataStart, compressedSize);
+        retval << member;
+
+        pos += 46 + nameLength;
+    }
+    return retval;
+}
+
+// Wraps raw deflate data the way qUncompress expects it: the size, a
+// zlib header, the data and the Adler-32 of what it inflates to.
+QByteArray tst_ZipWriter::zlibStream(const QByteArray& deflated, const QByteArray& expected)
+{
+    quint32 a = 1, b = 0;
+    for (int i = 0; i < expected.size(); ++i) {
+        a = (a + uchar(expected[i])) % 65521;
+        b = (b + a) % 65521;
+    }
+    const quint32 adler = (b << 16) | a;
+    const int size = expected.size();
+
+    QByteArray retval;
+    retval.append(char(size >> 24)).append(char(size >> 16)).append(char(size >> 8)).append(char(size));
+    retval.append(char(0x78)).append(char(0x01));
+    retval.append(deflated);
+    retval.append(char(adler >> 24)).append(char(adler >> 16)).append(char(adler >> 8)).append(char(adler));
+    return retval;
+}
+
+void tst_ZipWriter::crc()
+{
+    QCOMPARE(ZipWriter::crc32(0, "", 0), quint32(0));
+    QCOMPARE(ZipWriter::crc32(0, "123456789", 9), quint32(0xcbf43926));
+    // Incremental updates give the same result.
+    QCOMPARE(ZipWriter::crc32(ZipWriter::crc32(0, "1234", 4), "56789", 5), quint32(0xcbf43926));
+}
+
+void tst_ZipWriter::deflate_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("short") << QByteArray("<note/>");
+
+    QByteArray repetitive;
+    for (int i = 0; i < 20000; ++i) {
+        repetitive += "<note><pitch><step>C</step><octave>" + QByteArray::number(i % 7 + 1) +
+            "</octave></pitch><duration>16</duration></note>\n";
+    }
+    QTest::newRow("repetitive") << repetitive;
+
+    QByteArray noise;
+    qsrand(1);
+    for (int i = 0; i < 100000; ++i) {
+        noise += char(qrand() & 0xff);
+    }
+    QTest::newRow("noise") << noise;
+}
+
+void tst_ZipWriter::deflate()
+{
+    QFETCH(QByteArray, data);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    ZipWriter zip(&buffer);
+    QIODevice *device = zip.openFile("score.xml");
+    QVERIFY(device);
+    // Odd sized pieces, as QXmlStreamWriter would write them.
+    for (int pos = 0; pos < data.size(); pos += 777) {
+        QVERIFY(device->write(data.mid(pos, 777)) >= 0);
+    }
+    QVERIFY(zip.closeFile());
+    QVERIFY(zip.close());
+
+    const QList<Member> members = readArchive(buffer.data());
+    QCOMPARE(members.size(), 1);
+    QCOMPARE(members[0].name, QByteArray("score.xml"));
+    QCOMPARE(members[0].method, 8);
+    QCOMPARE(members[0].crc, ZipWriter::crc32(0, data.constData(), data.size()));
+
+    QVERIFY(qUncompress(zlibStream(members[0].data, data)) == data);
+
+    // MusicXML like input shrinks by an order of magnitude.
+    if (QTest::currentDataTag() == QString("repetitive")) {
+        QVERIFY(members[0].data.size() * 10 < data.size());
+    }
+}
+
+void tst_ZipWriter::storedMembers()
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    ZipWriter zip(&buffer);
+    QVERIFY(zip.addStoredFile("mimetype", "application/vnd.recordare.musicxml"));
+    QVERIFY(zip.openFile("a.xml"));
+    // Nothing else while a member is open.
+    QVERIFY(!zip.addStoredFile("b", "b"));
+    QVERIFY(!zip.openFile("c.xml"));
+    QVERIFY(zip.close());
+
+    const QList<Member> members = readArchive(buffer.data());
+    QCOMPARE(members.size(), 2);
+    QCOMPARE(members[0].method, 0);
+    QCOMPARE(members[0].data, QByteArray("application/vnd.recordare.musicxml"));
+    // The first member starts the file, as the .mxl format wants it.
+    QCOMPARE(buffer.data().mid(30, 8), QByteArray("mimetype"));
+}
+
+QTEST_MAIN(tst_ZipWriter)
+#include "main.moc"